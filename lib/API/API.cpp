@@ -8,97 +8,123 @@ API::API() {
     this->manager = new Manager();
 }
 
-void API::createWaterSource(char* name, short pin) {
+unsigned int API::createWaterSource(char* name, short pin) {
     if (this->manager->isWaterSourceRegistered(name)) {
-        return Exception::throwException(&WATER_SOURCE_ALREADY_REGISTERED);
+        Exception::throwException(&WATER_SOURCE_ALREADY_REGISTERED);
+        return NO_HANDLE;
     }
-    IOInterface* io = this->getOrCreateIO(pin, DIGITAL, READ_ONLY);
-    WaterSource* waterSource = new WaterSource(io);
-    this->manager->registerWaterSource(name, waterSource);
+    return this->addWaterSource(name, pin, NULL);
 }
 
-void API::createWaterSource(char* name, short pin, char* waterTankName) {
+unsigned int API::createWaterSource(char* name, short pin, WaterTank* waterTank) {
     if (this->manager->isWaterSourceRegistered(name)) {
-        return Exception::throwException(&WATER_SOURCE_ALREADY_REGISTERED);
-    } else if (!this->manager->isWaterTankRegistered(waterTankName)) {
-        return Exception::throwException(&WATER_TANK_NOT_FOUND);
+        Exception::throwException(&WATER_SOURCE_ALREADY_REGISTERED);
+        return NO_HANDLE;
+    } else if (waterTank == NULL) {
+        Exception::throwException(&WATER_TANK_NOT_FOUND);
+        return NO_HANDLE;
     }
-    IOInterface* io = this->getOrCreateIO(pin, DIGITAL, READ_ONLY);
-    WaterTank* waterTank = this->manager->getWaterTank(waterTankName);
-    WaterSource* waterSource = new WaterSource(io, waterTank);
-    this->manager->registerWaterSource(name, waterSource);
+    return this->addWaterSource(name, pin, waterTank);
 }
 
-void API::createWaterTank(char* name, short pressureSensorPin, float volumeFactor, float pressureFactor, float pressureChangingValue) {
+unsigned int API::createWaterTank(char* name, short pressureSensorPin, float volumeFactor, float pressureFactor, float pressureChangingValue) {
     if (this->manager->isWaterTankRegistered(name)) {
-        return Exception::throwException(&WATER_TANK_ALREADY_REGISTERED);
+        Exception::throwException(&WATER_TANK_ALREADY_REGISTERED);
+        return NO_HANDLE;
     }
-    IOInterface* pressureSensor = this->getOrCreateIO(pressureSensorPin, ANALOGIC, READ_ONLY);
-    WaterTank* waterTank = new WaterTank(pressureSensor, volumeFactor, pressureFactor);
-    waterTank->pressureChangingValue = pressureChangingValue;
-    this->manager->registerWaterTank(name, waterTank);
+    return this->addWaterTank(name, pressureSensorPin, volumeFactor, pressureFactor, pressureChangingValue, NULL);
 }
 
-void API::createWaterTank(char* name, short pressureSensorPin, float volumeFactor, float pressureFactor, float pressureChangingValue, char* waterSourceName) {
+unsigned int API::createWaterTank(char* name, short pressureSensorPin, float volumeFactor, float pressureFactor, float pressureChangingValue, WaterSource* waterSource) {
     if (this->manager->isWaterTankRegistered(name)) {
-        return Exception::throwException(&WATER_TANK_ALREADY_REGISTERED);
-    } else if (!this->manager->isWaterSourceRegistered(waterSourceName)) {
-        return Exception::throwException(&WATER_SOURCE_NOT_FOUND);
+        Exception::throwException(&WATER_TANK_ALREADY_REGISTERED);
+        return NO_HANDLE;
+    } else if (waterSource == NULL) {
+        Exception::throwException(&WATER_SOURCE_NOT_FOUND);
+        return NO_HANDLE;
     }
-    IOInterface* pressureSensor = this->getOrCreateIO(pressureSensorPin, ANALOGIC, READ_ONLY);
-    WaterSource* waterSource = this->getWaterSource(waterSourceName);
-
-    WaterTank* waterTank = new WaterTank(pressureSensor, volumeFactor, pressureFactor, waterSource);
-    waterTank->pressureChangingValue = pressureChangingValue;
-    this->manager->registerWaterTank(name, waterTank);
+    return this->addWaterTank(name, pressureSensorPin, volumeFactor, pressureFactor, pressureChangingValue, waterSource);
 }
 
-void API::setWaterTankMinimumVolume(char* name, float minimum) {
-    WaterTank* waterTank = this->manager->getWaterTank(name);
+void API::setWaterTankMinimumVolume(WaterTank* waterTank, float minimum) {
     if (waterTank != NULL) {
-        waterTank->minimumVolume = minimum;
+        waterTank->setMinimumVolume(minimum);
     }
 }
 
-void API::setWaterTankMaxVolume(char* name, float max) {
-    WaterTank* waterTank = this->manager->getWaterTank(name);
+void API::setWaterTankMaxVolume(WaterTank* waterTank, float max) {
     if (waterTank != NULL) {
-        waterTank->maxVolume = max;
+        waterTank->setMaxVolume(max);
     }
 }
 
-void API::setWaterZeroVolume(char* name, float pressure) {
-    WaterTank* waterTank = this->manager->getWaterTank(name);
+void API::setWaterZeroVolume(WaterTank* waterTank, float pressure) {
     if (waterTank != NULL) {
-        waterTank->zeroVolumePressure = pressure;
+        waterTank->setZeroVolumePressure(pressure);
     }
 }
 
-void API::setWaterTankVolumeFactor(char* name, float volumeFactor) {
-    WaterTank* waterTank = this->manager->getWaterTank(name);
+void API::setWaterTankVolumeFactor(WaterTank* waterTank, float volumeFactor) {
     if (waterTank != NULL) {
-        waterTank->volumeFactor = volumeFactor;
+        waterTank->setVolumeFactor(volumeFactor);
     }
 }
 
-void API::setWaterTankPressureFactor(char* name, float pressureFactor) {
-    WaterTank* waterTank = this->manager->getWaterTank(name);
+void API::setWaterTankPressureFactor(WaterTank* waterTank, float pressureFactor) {
     if (waterTank != NULL) {
-        waterTank->pressureFactor = pressureFactor;
+        waterTank->setPressureFactor(pressureFactor);
     }
 }
 
-void API::setWaterTankPressureChangingValue(char* name, float pressureChangingValue) {
-    WaterTank* waterTank = this->manager->getWaterTank(name);
+void API::setWaterTankPressureChangingValue(WaterTank* waterTank, float pressureChangingValue) {
     if (waterTank != NULL) {
-        waterTank->pressureChangingValue = pressureChangingValue;
+        waterTank->setPressureChangingValue(pressureChangingValue);
     }
 }
 
-void API::setWaterTankActive(char* name, bool active) {
-    WaterTank* waterTank = this->manager->getWaterTank(name);
+void API::setWaterTankActive(WaterTank* waterTank, bool active) {
     if (waterTank != NULL) {
         waterTank->setActive(active);
+        //In manual mode the water source is turned off with the water tank, even when it was turned on by its state
+        if (!active && this->manager->getOperationMode() == MANUAL) {
+            waterTank->stopFilling();
+        }
+    }
+}
+
+void API::setWaterTankFilter(WaterTank* waterTank, byte type, byte window, byte oversampling) {
+    if (waterTank != NULL) {
+        if (type > EMA_FILTER || window < 1 || window > MAX_FILTER_WINDOW || oversampling < 1 || oversampling > MAX_OVERSAMPLING) {
+            return Exception::throwException(&INVALID_FILTER);
+        }
+        waterTank->setFilter((FilterType) type, window, oversampling);
+    }
+}
+
+void API::setWaterTankCalibration(WaterTank* waterTank, const unsigned int* rawValues, const float* volumes, byte totalPoints) {
+    if (waterTank != NULL) {
+        if (totalPoints != 0 && !CalibrationTable::isValid(rawValues, volumes, totalPoints)) {
+            return Exception::throwException(&INVALID_CALIBRATION);
+        }
+        waterTank->setCalibration(rawValues, volumes, totalPoints);
+    }
+}
+
+void API::setWaterTankControl(WaterTank* waterTank, byte mode, float lowerBand, float upperBand) {
+    if (waterTank != NULL) {
+        if (mode > PREDICTIVE_CONTROL || lowerBand < 0 || upperBand < 0) {
+            return Exception::throwException(&INVALID_CONTROL);
+        }
+        waterTank->setControl((ControlMode) mode, lowerBand, upperBand);
+    }
+}
+
+void API::setWaterTankPriority(WaterTank* waterTank, byte weight) {
+    if (waterTank != NULL) {
+        if (weight == 0) {
+            return Exception::throwException(&INVALID_PRIORITY);
+        }
+        waterTank->setPriorityWeight(weight);
     }
 }
 
@@ -116,49 +142,40 @@ byte API::getOperationMode() {
     return (byte) this->manager->getOperationMode();
 }
 
-void API::setWaterSourceState(char* name, bool enabled, bool force) {
-    this->manager->setWaterSourceState(name, enabled, force);
+void API::setWaterSourceState(WaterSource* waterSource, bool enabled, bool force) {
+    this->manager->setWaterSourceState(waterSource, enabled, force);
 }
 
-void API::setWaterSourceActive(char* name, bool active) {
-    WaterSource* waterSource = this->manager->getWaterSource(name);
+void API::setWaterSourceActive(WaterSource* waterSource, bool active) {
     if (waterSource != NULL) {
         waterSource->setActive(active);
     }
 }
 
-char** API::getWaterSourceList() {
-    return this->manager->getWaterSourceNames();
+void API::getWaterSourceList(char** list) {
+    this->manager->getWaterSourceNames(list);
 }
 
-char** API::getWaterTankList() {
-    return this->manager->getWaterTankNames();
-}
-
-float API::getWaterTankVolume(char* name) {
-    WaterTank* waterTank = this->manager->getWaterTank(name);
-    if (waterTank != NULL) {
-        return waterTank->getVolume();
-    }
-    return 0;
-}
-
-float API::getWaterTankPressure(char* name) {
-    WaterTank* waterTank = this->manager->getWaterTank(name);
-    if (waterTank != NULL) {
-        return waterTank->getPressure();
-    }
-    return 0;
+void API::getWaterTankList(char** list) {
+    this->manager->getWaterTankNames(list);
 }
 
 WaterSource* API::getWaterSource(char* name) {
     return this->manager->getWaterSource(name);
 }
 
+WaterSource* API::getWaterSource(unsigned int handle) {
+    return this->manager->getWaterSource(handle);
+}
+
 WaterTank* API::getWaterTank(char* name) {
     return this->manager->getWaterTank(name);
 }
 
+WaterTank* API::getWaterTank(unsigned int handle) {
+    return this->manager->getWaterTank(handle);
+}
+
 char* API::getWaterSourceName(WaterSource* waterSource) {
     return this->manager->getWaterSourceName(waterSource);
 }
@@ -167,6 +184,18 @@ char* API::getWaterTankName(WaterTank* waterTank) {
     return this->manager->getWaterTankName(waterTank);
 }
 
+WaterTank* API::getWaterSourceOwner(WaterSource* waterSource) {
+    return this->manager->getWaterSourceOwner(waterSource);
+}
+
+unsigned int API::getWaterSourceHandle(char* name) {
+    return this->manager->getWaterSourceHandle(name);
+}
+
+unsigned int API::getWaterTankHandle(char* name) {
+    return this->manager->getWaterTankHandle(name);
+}
+
 unsigned int API::getTotalWaterSources() {
     return this->manager->getTotalWaterSources();
 }
@@ -175,33 +204,50 @@ unsigned int API::getTotalWaterTanks() {
     return this->manager->getTotalWaterTanks();
 }
 
-void API::removeWaterSource(char* name) {
-    WaterSource* waterSource = this->manager->unregisterWaterSource(name);
+const Exception* API::getPendingError(char** waterTankName) {
+    return this->manager->getPendingError(waterTankName);
+}
+
+void API::removeWaterSource(WaterSource* waterSource) {
+    waterSource = this->manager->unregisterWaterSource(waterSource);
     if (waterSource != NULL) {
         delete waterSource;
     }
 }
 
-void API::removeWaterTank(char* name) {
-    WaterTank* waterTank = this->manager->unregisterWaterTank(name);
+void API::removeWaterTank(WaterTank* waterTank) {
+    waterTank = this->manager->unregisterWaterTank(waterTank);
     if (waterTank != NULL) {
         delete waterTank;
     }
 }
 
-void API::fillWaterTank(char* name, bool enabled, bool force) {
+void API::fillWaterTank(WaterTank* waterTank, bool enabled, bool force) {
     if (enabled) {
-        this->manager->fillWaterTank(name, force);
+        this->manager->fillWaterTank(waterTank, force);
     } else {
-        this->manager->stopFillingWaterTank(name);
+        this->manager->stopFillingWaterTank(waterTank);
     }
 }
 
+void API::subscribe(unsigned long minimumInterval, float volumeDeadband) {
+    Notifier::subscribe(minimumInterval, volumeDeadband);
+}
+
+void API::unsubscribe() {
+    Notifier::unsubscribe();
+}
+
 void API::reset() {
+    Notifier::unsubscribe();
     delete this->manager;
     this->manager = new Manager();
 }
 
+void API::wakeUp() {
+    this->manager->wakeUp();
+}
+
 void API::loop() {
     this->manager->loop();
 }
@@ -210,6 +256,59 @@ IOInterface* API::getOrCreateIO(unsigned pin, IOType type, IOMode mode) {
     IOInterface* io = IOInterface::get(pin);
     if (io == NULL) {
         io = new IOInterface(pin, mode, type);
+        if (io == NULL) {
+            Exception::throwException(&MAX_IO_INTERFACES_ERROR);
+        }
     }
     return io;
 }
+
+unsigned int API::addWaterSource(char* name, short pin, WaterTank* waterTank) {
+    //The water sources pool has the same capacity as the manager, so it is full when the manager is
+    if (this->manager->getTotalWaterSources() >= MAX_WATER_SOURCES) {
+        Exception::throwException(&MAX_WATER_SOURCES_ERROR);
+        return NO_HANDLE;
+    }
+    bool isNewIO = IOInterface::get(pin) == NULL;
+    IOInterface* io = this->getOrCreateIO(pin, DIGITAL, READ_ONLY);
+    if (io == NULL) {
+        return NO_HANDLE;
+    }
+    WaterSource* waterSource = new WaterSource(io, waterTank);
+    this->manager->registerWaterSource(name, waterSource);
+    unsigned int handle = this->manager->getWaterSourceHandle(name);
+    if (handle == NO_HANDLE) {
+        //The objects are given back to their pools, so a rejected request does not hold them
+        delete waterSource;
+        if (isNewIO) {
+            IOInterface::remove(pin);
+        }
+    }
+    return handle;
+}
+
+unsigned int API::addWaterTank(char* name, short pressureSensorPin, float volumeFactor, float pressureFactor,
+                               float pressureChangingValue, WaterSource* waterSource) {
+    //The water tanks pool has the same capacity as the manager, so it is full when the manager is
+    if (this->manager->getTotalWaterTanks() >= MAX_WATER_TANKS) {
+        Exception::throwException(&MAX_WATER_TANKS_ERROR);
+        return NO_HANDLE;
+    }
+    bool isNewIO = IOInterface::get(pressureSensorPin) == NULL;
+    IOInterface* pressureSensor = this->getOrCreateIO(pressureSensorPin, ANALOGIC, READ_ONLY);
+    if (pressureSensor == NULL) {
+        return NO_HANDLE;
+    }
+    WaterTank* waterTank = new WaterTank(pressureSensor, volumeFactor, pressureFactor, waterSource);
+    waterTank->setPressureChangingValue(pressureChangingValue);
+    this->manager->registerWaterTank(name, waterTank);
+    unsigned int handle = this->manager->getWaterTankHandle(name);
+    if (handle == NO_HANDLE) {
+        //The objects are given back to their pools, so a rejected request does not hold them
+        delete waterTank;
+        if (isNewIO) {
+            IOInterface::remove(pressureSensorPin);
+        }
+    }
+    return handle;
+}
@@ -6,47 +6,62 @@
 #include "Manager.h"
 #include "WaterTank.h"
 #include "Exception.h"
+#include "Notifier.h"
 
 class API
 {
     public:
         API();
 
-        void createWaterSource(char* name, short pin);
-        void createWaterSource(char* name, short pin, char* waterTankName);
-        void createWaterTank(char* name, short volumeReaderPin, float volumeFactor, float pressureFactor, float pressureChangingValue);
-        void createWaterTank(char* name, short volumeReaderPin, float volumeFactor, float pressureFactor, float pressureChangingValue, char* waterSourceName);
-        void setWaterTankMinimumVolume(char* name, float minimum);
-        void setWaterTankMaxVolume(char* name, float max);
-        void setWaterZeroVolume(char* name, float pressure);
-        void setWaterTankVolumeFactor(char* name, float volumeFactor);
-        void setWaterTankPressureFactor(char* name, float pressureFactor);
-        void setWaterTankPressureChangingValue(char* name, float pressureChangingValue);
-        void setWaterTankActive(char* name, bool active);
+        unsigned int createWaterSource(char* name, short pin);
+        unsigned int createWaterSource(char* name, short pin, WaterTank* waterTank);
+        unsigned int createWaterTank(char* name, short volumeReaderPin, float volumeFactor, float pressureFactor, float pressureChangingValue);
+        unsigned int createWaterTank(char* name, short volumeReaderPin, float volumeFactor, float pressureFactor, float pressureChangingValue, WaterSource* waterSource);
+        void setWaterTankMinimumVolume(WaterTank* waterTank, float minimum);
+        void setWaterTankMaxVolume(WaterTank* waterTank, float max);
+        void setWaterZeroVolume(WaterTank* waterTank, float pressure);
+        void setWaterTankVolumeFactor(WaterTank* waterTank, float volumeFactor);
+        void setWaterTankPressureFactor(WaterTank* waterTank, float pressureFactor);
+        void setWaterTankPressureChangingValue(WaterTank* waterTank, float pressureChangingValue);
+        void setWaterTankActive(WaterTank* waterTank, bool active);
+        void setWaterTankFilter(WaterTank* waterTank, byte type, byte window, byte oversampling);
+        void setWaterTankCalibration(WaterTank* waterTank, const unsigned int* rawValues, const float* volumes, byte totalPoints);
+        void setWaterTankControl(WaterTank* waterTank, byte mode, float lowerBand, float upperBand);
+        void setWaterTankPriority(WaterTank* waterTank, byte weight);
         void setOperationMode(byte mode);
         byte getOperationMode();
-        void setWaterSourceState(char* name, bool enabled, bool force);
-        void setWaterSourceActive(char* name, bool active);
+        void setWaterSourceState(WaterSource* waterSource, bool enabled, bool force);
+        void setWaterSourceActive(WaterSource* waterSource, bool active);
         WaterSource* getWaterSource(char* name);
+        WaterSource* getWaterSource(unsigned int handle);
         WaterTank* getWaterTank(char* name);
+        WaterTank* getWaterTank(unsigned int handle);
         char* getWaterSourceName(WaterSource* waterSource);
         char* getWaterTankName(WaterTank* waterTank);
-        char** getWaterSourceList();
-        char** getWaterTankList();
-        float getWaterTankVolume(char* name);
-        float getWaterTankPressure(char* name);
+        WaterTank* getWaterSourceOwner(WaterSource* waterSource);
+        unsigned int getWaterSourceHandle(char* name);
+        unsigned int getWaterTankHandle(char* name);
+        void getWaterSourceList(char** list);
+        void getWaterTankList(char** list);
         unsigned int getTotalWaterSources();
         unsigned int getTotalWaterTanks();
-        void removeWaterSource(char* name);
-        void removeWaterTank(char* name);
-        void fillWaterTank(char* name, bool enabled, bool force);
+        const Exception* getPendingError(char** waterTankName);
+        void removeWaterSource(WaterSource* waterSource);
+        void removeWaterTank(WaterTank* waterTank);
+        void fillWaterTank(WaterTank* waterTank, bool enabled, bool force);
+        void subscribe(unsigned long minimumInterval, float volumeDeadband);
+        void unsubscribe();
         void reset();
+        void wakeUp();
         void loop();
 
     private:
         Manager* manager = NULL;
 
         IOInterface* getOrCreateIO(unsigned pin, IOType type, IOMode mode=READ_ONLY);
+        unsigned int addWaterSource(char* name, short pin, WaterTank* waterTank);
+        unsigned int addWaterTank(char* name, short pressureSensorPin, float volumeFactor, float pressureFactor,
+                                  float pressureChangingValue, WaterSource* waterSource);
 };
 
 #endif
@@ -0,0 +1,234 @@
+#include "AnalogSampler.h"
+
+const byte RING_MASK = CONVERSIONS_RING_SIZE - 1;
+const int CHANNEL_NOT_FOUND = -1;
+
+static_assert((CONVERSIONS_RING_SIZE & RING_MASK) == 0, "The ring size must be a power of two");
+
+AnalogSampler::ConversionRing AnalogSampler::rings[ANALOG_CHANNELS_CAPACITY];
+byte AnalogSampler::channels[ANALOG_CHANNELS_CAPACITY];
+volatile byte AnalogSampler::totalChannels = 0;
+volatile byte AnalogSampler::currentChannel = 0;
+volatile bool AnalogSampler::running = false;
+volatile bool AnalogSampler::discardConversion = false;
+volatile unsigned int AnalogSampler::passConversionsLeft = 0;
+unsigned long AnalogSampler::passStartTime = 0;
+
+ISR(ADC_vect) {
+    AnalogSampler::onConversion(ADC);
+}
+
+bool AnalogSampler::addPin(unsigned int pin) {
+    int channel = AnalogSampler::getChannel(pin);
+    if (channel == CHANNEL_NOT_FOUND) {
+        return false;
+    }
+    if (AnalogSampler::getIndex(channel) != CHANNEL_NOT_FOUND) {
+        return true;
+    }
+    noInterrupts();
+    byte index = AnalogSampler::totalChannels;
+    AnalogSampler::channels[index] = channel;
+    AnalogSampler::rings[index].head = 0;
+    AnalogSampler::rings[index].totalConversions = 0;
+    AnalogSampler::totalChannels += 1;
+    //The pin gets its conversions right away, in a new pass or in the pass on its way
+    if (AnalogSampler::running && AnalogSampler::passConversionsLeft == 0) {
+        AnalogSampler::beginPass();
+    } else if (AnalogSampler::running) {
+        AnalogSampler::passConversionsLeft += CONVERSIONS_RING_SIZE;
+    }
+    interrupts();
+    return true;
+}
+
+void AnalogSampler::removePin(unsigned int pin) {
+    int channel = AnalogSampler::getChannel(pin);
+    int index = channel != CHANNEL_NOT_FOUND ? AnalogSampler::getIndex(channel) : CHANNEL_NOT_FOUND;
+    if (index == CHANNEL_NOT_FOUND) {
+        return;
+    }
+    noInterrupts();
+    for (byte i = index + 1; i < AnalogSampler::totalChannels; i++) {
+        AnalogSampler::channels[i - 1] = AnalogSampler::channels[i];
+        memcpy((void*) &AnalogSampler::rings[i - 1], (void*) &AnalogSampler::rings[i], sizeof(ConversionRing));
+    }
+    AnalogSampler::totalChannels -= 1;
+    if (AnalogSampler::totalChannels == 0) {
+        AnalogSampler::passConversionsLeft = 0;
+    }
+    //The conversion on its way keeps the index of its pin. If it is the removed pin, the conversion is discarded
+    //and the next pin, which now has the same index, is converted instead
+    if (index < AnalogSampler::currentChannel) {
+        AnalogSampler::currentChannel -= 1;
+    } else if (index == AnalogSampler::currentChannel) {
+        AnalogSampler::discardConversion = AnalogSampler::running && AnalogSampler::passConversionsLeft > 0;
+        if (AnalogSampler::currentChannel >= AnalogSampler::totalChannels) {
+            AnalogSampler::currentChannel = 0;
+        }
+    }
+    interrupts();
+}
+
+bool AnalogSampler::isRunning() {
+    return AnalogSampler::running;
+}
+
+unsigned int AnalogSampler::getLatest(unsigned int pin) {
+    return AnalogSampler::getAverage(pin, 1);
+}
+
+unsigned int AnalogSampler::getAverage(unsigned int pin, byte count) {
+    int channel = AnalogSampler::getChannel(pin);
+    int index = channel != CHANNEL_NOT_FOUND ? AnalogSampler::getIndex(channel) : CHANNEL_NOT_FOUND;
+    if (index == CHANNEL_NOT_FOUND) {
+        return 0;
+    }
+    ConversionRing* ring = &AnalogSampler::rings[index];
+    //Only a pin just added has no conversion, its first one arrives within a round of the other pins. If it does
+    //not, the conversions have stopped and the pin is read the blocking way
+    for (unsigned int waitedTime = 0; ring->totalConversions == 0; waitedTime++) {
+        if (waitedTime == FIRST_CONVERSION_TIMEOUT) {
+            return AnalogSampler::readBlocking(pin);
+        }
+        delayMicroseconds(1);
+    }
+
+    count = constrain(count, 1, ring->totalConversions);
+    unsigned long sum;
+    byte head;
+    do {
+        head = ring->head;
+        sum = 0;
+        for (byte i = 1; i <= count; i++) {
+            sum += ring->conversions[(byte) (head - i) & RING_MASK];
+        }
+    } while (head != ring->head);
+    return (sum + count / 2) / count;
+}
+
+void AnalogSampler::start() {
+    if (AnalogSampler::running) {
+        return;
+    }
+    noInterrupts();
+    //The ADC clock is 16 MHz / 128, the slowest and most accurate one, a conversion takes 13 of its cycles.
+    //A conversion finished while it was stopped is discarded by clearing its flag
+    ADCSRA = (1 << ADEN) | (1 << ADIE) | (1 << ADIF) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+    AnalogSampler::running = true;
+    AnalogSampler::discardConversion = false;
+    AnalogSampler::beginPass();
+    interrupts();
+}
+
+void AnalogSampler::stop() {
+    noInterrupts();
+    ADCSRA &= ~(1 << ADIE);
+    AnalogSampler::running = false;
+    AnalogSampler::passConversionsLeft = 0;
+    interrupts();
+    //analogRead can be used again once the conversion on its way is done
+    while (ADCSRA & (1 << ADSC));
+}
+
+void AnalogSampler::startPass(unsigned long currentTime) {
+    noInterrupts();
+    if (AnalogSampler::running && AnalogSampler::passConversionsLeft == 0 &&
+        currentTime - AnalogSampler::passStartTime >= CONVERSIONS_PASS_INTERVAL) {
+        AnalogSampler::passStartTime = currentTime;
+        AnalogSampler::beginPass();
+    }
+    interrupts();
+}
+
+void AnalogSampler::onConversion(unsigned int value) {
+    if (AnalogSampler::totalChannels == 0) {
+        AnalogSampler::discardConversion = false;
+        return;
+    }
+    if (AnalogSampler::discardConversion) {
+        //The pin of the conversion was removed, the pin that took its index is converted now
+        AnalogSampler::discardConversion = false;
+    } else {
+        AnalogSampler::store(AnalogSampler::currentChannel, value);
+        AnalogSampler::currentChannel = (AnalogSampler::currentChannel + 1) % AnalogSampler::totalChannels;
+        if (AnalogSampler::passConversionsLeft > 0) {
+            AnalogSampler::passConversionsLeft -= 1;
+        }
+    }
+    //The ADC is in single conversion mode, once the pass is done no interrupt fires until the next one
+    if (AnalogSampler::running && AnalogSampler::passConversionsLeft > 0) {
+        AnalogSampler::startConversion();
+    }
+}
+
+#ifdef TEST
+void AnalogSampler::simulateConversions(unsigned int pin, unsigned int value, byte count) {
+    int channel = AnalogSampler::getChannel(pin);
+    int index = channel != CHANNEL_NOT_FOUND ? AnalogSampler::getIndex(channel) : CHANNEL_NOT_FOUND;
+    if (index != CHANNEL_NOT_FOUND) {
+        for (byte i = 0; i < count; i++) {
+            AnalogSampler::store(index, value);
+        }
+    }
+}
+#endif
+
+int AnalogSampler::getChannel(unsigned int pin) {
+    if (pin < ANALOG_CHANNELS_CAPACITY) {
+        return pin;
+    } else if (pin >= FIRST_ANALOG_PIN && pin < FIRST_ANALOG_PIN + ANALOG_CHANNELS_CAPACITY) {
+        return pin - FIRST_ANALOG_PIN;
+    }
+    return CHANNEL_NOT_FOUND;
+}
+
+int AnalogSampler::getIndex(byte channel) {
+    for (byte i = 0; i < AnalogSampler::totalChannels; i++) {
+        if (AnalogSampler::channels[i] == channel) {
+            return i;
+        }
+    }
+    return CHANNEL_NOT_FOUND;
+}
+
+void AnalogSampler::store(byte index, unsigned int value) {
+    //The head moves after the conversion is written, so a copy made meanwhile by the loop is made again
+    ConversionRing* ring = &AnalogSampler::rings[index];
+    ring->conversions[ring->head & RING_MASK] = value;
+    ring->head += 1;
+    if (ring->totalConversions < CONVERSIONS_RING_SIZE) {
+        ring->totalConversions += 1;
+    }
+}
+
+unsigned int AnalogSampler::readBlocking(unsigned int pin) {
+    noInterrupts();
+    while (ADCSRA & (1 << ADSC));
+    unsigned int value = analogRead(pin);
+    //The flag is cleared, so the interrupt does not store the value in a ring, and the round is started again
+    ADCSRA |= (1 << ADIF);
+    AnalogSampler::discardConversion = false;
+    if (AnalogSampler::running && AnalogSampler::passConversionsLeft > 0) {
+        AnalogSampler::startConversion();
+    }
+    interrupts();
+    return value;
+}
+
+void AnalogSampler::beginPass() {
+    //Every pin fills its ring, the pass starts from the first pin
+    AnalogSampler::currentChannel = 0;
+    AnalogSampler::passConversionsLeft = AnalogSampler::totalChannels * CONVERSIONS_RING_SIZE;
+    if (AnalogSampler::passConversionsLeft > 0) {
+        AnalogSampler::startConversion();
+    }
+}
+
+void AnalogSampler::startConversion() {
+    //AVcc reference, the MUX5 bit of ADCSRB selects the channels 8 to 15
+    byte channel = AnalogSampler::channels[AnalogSampler::currentChannel];
+    ADCSRB = (ADCSRB & ~(1 << MUX5)) | (((channel >> 3) & 0x01) << MUX5);
+    ADMUX = (1 << REFS0) | (channel & 0x07);
+    ADCSRA |= (1 << ADSC);
+}
@@ -0,0 +1,69 @@
+#ifndef ANALOG_SAMPLER_H
+#define ANALOG_SAMPLER_H
+
+#include <Arduino.h>
+
+//The ATmega2560 has 16 ADC channels, pins A0 to A15 can also be given by their channel number
+const byte ANALOG_CHANNELS_CAPACITY = 16;
+const unsigned int FIRST_ANALOG_PIN = 54;
+
+//A power of two, so the ring indexes wrap with a mask. It holds MAX_OVERSAMPLING conversions
+const byte CONVERSIONS_RING_SIZE = 16;
+//A conversion takes 104 us, the first conversion of a pin is waited for two rounds of every channel at most
+const unsigned int FIRST_CONVERSION_TIMEOUT = 2 * ANALOG_CHANNELS_CAPACITY * 104; //Microseconds
+//The sampling interval of the water tanks, a pass of conversions is started once per interval at most
+const unsigned long CONVERSIONS_PASS_INTERVAL = 1000UL; //Milliseconds
+
+/*
+Samples the analog pins in the background. The ADC conversion complete interrupt stores each conversion in the
+ring of its pin and starts the conversion of the next pin, so the pins are converted round-robin without blocking
+the loop. The conversions are made in passes that fill the ring of every pin, a pass takes 104 us times
+CONVERSIONS_RING_SIZE times the amount of pins. No conversion is started between the passes, so the interrupt does
+not wake the MCU from its idle sleep for the rest of the interval.
+
+Each ring has a single producer, the interrupt, and a single consumer, the loop, so it needs no lock: only the
+interrupt moves the head of a ring, and the loop copies the conversions again if the head moved while it copied.
+
+In the test build the virtual pins are fed by simulated conversions through the same rings.
+*/
+class AnalogSampler
+{
+    public:
+        static bool addPin(unsigned int pin);
+        static void removePin(unsigned int pin);
+        static bool isRunning();
+        static unsigned int getLatest(unsigned int pin);
+        static unsigned int getAverage(unsigned int pin, byte count);
+        static void start();
+        static void stop();
+        static void startPass(unsigned long currentTime);
+        static void onConversion(unsigned int value);
+        #ifdef TEST
+        static void simulateConversions(unsigned int pin, unsigned int value, byte count);
+        #endif
+
+    private:
+        struct ConversionRing {
+            volatile unsigned int conversions[CONVERSIONS_RING_SIZE];
+            volatile byte head;
+            volatile byte totalConversions;
+        };
+
+        static ConversionRing rings[ANALOG_CHANNELS_CAPACITY];
+        static byte channels[ANALOG_CHANNELS_CAPACITY];
+        static volatile byte totalChannels;
+        static volatile byte currentChannel;
+        static volatile bool running;
+        static volatile bool discardConversion;
+        static volatile unsigned int passConversionsLeft;
+        static unsigned long passStartTime;
+
+        static int getChannel(unsigned int pin);
+        static int getIndex(byte channel);
+        static void store(byte index, unsigned int value);
+        static void startConversion();
+        static void beginPass();
+        static unsigned int readBlocking(unsigned int pin);
+};
+
+#endif
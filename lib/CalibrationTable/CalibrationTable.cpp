@@ -0,0 +1,68 @@
+#include "CalibrationTable.h"
+
+Pool<CalibrationTable, CALIBRATION_TABLES_CAPACITY> CalibrationTable::pool;
+
+void* CalibrationTable::operator new(size_t size) noexcept {
+    return CalibrationTable::pool.allocate();
+}
+
+void CalibrationTable::operator delete(void* pointer) {
+    CalibrationTable::pool.release(pointer);
+}
+
+bool CalibrationTable::isValid(const unsigned int* rawValues, const float* volumes, byte totalPoints) {
+    if (totalPoints < MIN_CALIBRATION_POINTS || totalPoints > MAX_CALIBRATION_POINTS) {
+        return false;
+    }
+    for (byte i = 0; i < totalPoints; i++) {
+        //The raw values must be increasing, so every segment has a slope
+        if (volumes[i] < 0 || (i > 0 && rawValues[i] <= rawValues[i - 1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CalibrationTable::setPoints(const unsigned int* rawValues, const float* volumes, byte totalPoints) {
+    this->totalPoints = totalPoints;
+    for (byte i = 0; i < totalPoints; i++) {
+        this->rawValues[i] = rawValues[i];
+        this->volumes[i] = FixedPoint::fromFloat(volumes[i]);
+        if (i > 0) {
+            this->slopes[i - 1].setFactor((volumes[i] - volumes[i - 1]) / (rawValues[i] - rawValues[i - 1]));
+        }
+    }
+}
+
+byte CalibrationTable::getTotalPoints() {
+    return this->totalPoints;
+}
+
+unsigned int CalibrationTable::getRawValue(byte index) {
+    return this->rawValues[index];
+}
+
+float CalibrationTable::getVolume(byte index) {
+    return FixedPoint::toFloat(this->volumes[index]);
+}
+
+long CalibrationTable::getFixedVolume(unsigned int rawValue) {
+    byte last = this->totalPoints - 1;
+    if (rawValue <= this->rawValues[0]) {
+        return this->volumes[0];
+    } else if (rawValue >= this->rawValues[last]) {
+        return this->volumes[last];
+    }
+    //The segment is the last breakpoint whose raw value is not above the raw value
+    byte low = 0;
+    byte high = last;
+    while (high - low > 1) {
+        byte middle = (low + high) / 2;
+        if (this->rawValues[middle] <= rawValue) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return FixedPoint::limit(this->volumes[low] + this->slopes[low].apply(rawValue - this->rawValues[low]));
+}
@@ -0,0 +1,48 @@
+#ifndef CALIBRATION_TABLE_H
+#define CALIBRATION_TABLE_H
+
+#include <Arduino.h>
+
+#include "Capacity.h"
+#include "Pool.h"
+#include "FixedPoint.h"
+
+//Only the water tanks that are not straight-walled need a table, so there is one for half of them. The capacity
+//follows the water tanks capacity and it can also be set by the build flags
+#ifndef CALIBRATION_TABLES_CAPACITY
+#define CALIBRATION_TABLES_CAPACITY ((WATER_TANKS_CAPACITY + 1) / 2)
+#endif
+
+const byte MAX_CALIBRATION_POINTS = 32;
+const byte MIN_CALIBRATION_POINTS = 2;
+
+/*
+Maps the raw values of a pressure sensor to the volume of a water tank by linear interpolation between up to
+MAX_CALIBRATION_POINTS breakpoints, so the tanks that are not straight-walled have their volume right. The slope of
+each segment is computed when the table is set, a lookup is a binary search of the segment, a multiply and a shift.
+The raw values below the first breakpoint or above the last one have the volume of that breakpoint.
+*/
+class CalibrationTable
+{
+    public:
+        static void* operator new(size_t size) noexcept;
+        static void operator delete(void* pointer);
+        static Pool<CalibrationTable, CALIBRATION_TABLES_CAPACITY> pool;
+
+        static bool isValid(const unsigned int* rawValues, const float* volumes, byte totalPoints);
+
+        void setPoints(const unsigned int* rawValues, const float* volumes, byte totalPoints);
+        byte getTotalPoints();
+        unsigned int getRawValue(byte index);
+        float getVolume(byte index);
+        long getFixedVolume(unsigned int rawValue);
+
+    private:
+        unsigned int rawValues[MAX_CALIBRATION_POINTS];
+        long volumes[MAX_CALIBRATION_POINTS];
+        //The slope of the segment starting at each breakpoint, in volume per raw value
+        FixedScale slopes[MAX_CALIBRATION_POINTS - 1];
+        byte totalPoints = 0;
+};
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef CAPACITY_H
+#define CAPACITY_H
+
+//The capacity can be raised by the build flags, e.g. -D WATER_TANKS_CAPACITY=32
+#ifndef WATER_SOURCES_CAPACITY
+#define WATER_SOURCES_CAPACITY 5
+#endif
+#ifndef WATER_TANKS_CAPACITY
+#define WATER_TANKS_CAPACITY 5
+#endif
+
+#endif
@@ -36,14 +36,6 @@ bool Clock::hasStarted() {
 }
 
 unsigned long Clock::getElapsedTime() {
-    unsigned long currentTime = Clock::currentMillis();
-    unsigned long elapsedTime = 0L;
-    if (currentTime < this->startTime) {
-        //Long overflow
-        elapsedTime = UINT32_MAX - this->startTime;
-        elapsedTime += currentTime;
-    } else {
-        elapsedTime = currentTime - this->startTime;
-    }
-    return elapsedTime;
+    //The unsigned subtraction is right across a millis() overflow
+    return Clock::currentMillis() - this->startTime;
 }
@@ -0,0 +1,165 @@
+#include "Cobs.h"
+
+uint16_t updateCrc16(uint16_t crc, byte value) {
+    crc ^= (uint16_t) value << 8;
+    for (byte i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+CobsEncoder::CobsEncoder(Print* output) {
+    this->output = output;
+}
+
+void CobsEncoder::beginFrame() {
+    this->blockLength = 0;
+    this->crc = CRC16_INIT;
+}
+
+size_t CobsEncoder::write(uint8_t value) {
+    this->crc = updateCrc16(this->crc, value);
+    this->encode(value);
+    return 1;
+}
+
+void CobsEncoder::endFrame() {
+    //The CRC is sent big-endian, so the CRC of the whole decoded frame is 0
+    uint16_t crc = this->crc;
+    this->encode(crc >> 8);
+    this->encode(crc & 0xFF);
+    this->writeBlock();
+    this->output->write(COBS_DELIMITER);
+}
+
+void CobsEncoder::encode(byte value) {
+    if (value == COBS_DELIMITER) {
+        this->writeBlock();
+        return;
+    }
+    this->block[this->blockLength] = value;
+    this->blockLength += 1;
+    if (this->blockLength == COBS_MAX_BLOCK_LENGTH) {
+        this->writeBlock();
+    }
+}
+
+void CobsEncoder::writeBlock() {
+    //The block code is its length plus one, a code lower than 0xFF stands for a zero byte after the block
+    this->output->write((byte) (this->blockLength + 1));
+    this->output->write(this->block, this->blockLength);
+    this->blockLength = 0;
+}
+
+CobsDecoder::CobsDecoder(RingBuffer* input) {
+    this->input = input;
+}
+
+bool CobsDecoder::hasFrame() {
+    while (this->discarding && this->input->available() > 0) {
+        this->discarding = this->input->read() != COBS_DELIMITER;
+    }
+    //The scanned bytes are kept, so each byte is only scanned once while the frame arrives
+    while (this->frameSize == 0 && this->scannedBytes < this->input->available()) {
+        if (this->input->peek(this->scannedBytes) != COBS_DELIMITER) {
+            this->scannedBytes += 1;
+        } else if (this->scannedBytes == 0) {
+            //Empty frames are sent to flush the bytes left by a broken frame
+            this->input->read();
+        } else {
+            this->frameSize = this->scannedBytes + 1;
+        }
+    }
+    return this->frameSize > 0;
+}
+
+bool CobsDecoder::isFrameValid() {
+    if (this->frameSize == 0) {
+        return false;
+    }
+    this->rewind();
+    uint16_t crc = CRC16_INIT;
+    unsigned int length = 0;
+    byte value;
+    while (this->decode(&value)) {
+        crc = updateCrc16(crc, value);
+        length += 1;
+    }
+    this->frameLength = length > COBS_CRC_SIZE ? length - COBS_CRC_SIZE : 0;
+    //A block left unfinished means a code byte points past the delimiter
+    return this->blockLeft == 0 && this->frameLength > 0 && crc == 0;
+}
+
+unsigned int CobsDecoder::getFrameLength() {
+    return this->frameLength;
+}
+
+void CobsDecoder::beginFrame() {
+    this->rewind();
+    this->decodedLeft = this->frameLength;
+}
+
+bool CobsDecoder::read(byte* value) {
+    if (this->decodedLeft == 0) {
+        return false;
+    }
+    this->decodedLeft -= 1;
+    return this->decode(value);
+}
+
+void CobsDecoder::dropFrame() {
+    for (unsigned int i = 0; i < this->frameSize; i++) {
+        this->input->read();
+    }
+    this->frameSize = 0;
+    this->frameLength = 0;
+    this->scannedBytes = 0;
+    this->decodedLeft = 0;
+}
+
+void CobsDecoder::dropOversizedFrame() {
+    //The frame does not fit in the input, its bytes are dropped until the next delimiter arrives
+    this->input->clear();
+    this->reset();
+    this->discarding = true;
+}
+
+void CobsDecoder::reset() {
+    this->frameSize = 0;
+    this->frameLength = 0;
+    this->scannedBytes = 0;
+    this->discarding = false;
+    this->decodedLeft = 0;
+    this->rewind();
+}
+
+void CobsDecoder::rewind() {
+    this->offset = 0;
+    this->blockLeft = 0;
+    this->zeroPending = false;
+}
+
+bool CobsDecoder::decode(byte* value) {
+    unsigned int encodedSize = this->frameSize - 1;
+    while (this->blockLeft == 0) {
+        if (this->zeroPending) {
+            this->zeroPending = false;
+            *value = 0;
+            return true;
+        }
+        if (this->offset >= encodedSize) {
+            return false;
+        }
+        byte code = this->input->peek(this->offset);
+        this->offset += 1;
+        this->blockLeft = code - 1;
+        this->zeroPending = code < 0xFF && this->offset + this->blockLeft < encodedSize;
+    }
+    if (this->offset >= encodedSize) {
+        return false;
+    }
+    *value = this->input->peek(this->offset);
+    this->offset += 1;
+    this->blockLeft -= 1;
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef COBS_H
+#define COBS_H
+
+#include <Arduino.h>
+
+#include "RingBuffer.h"
+
+/*
+Consistent Overhead Byte Stuffing removes the zero bytes from a frame, so a zero byte can delimit the frames.
+Each frame ends with a CRC-16 (CCITT) trailer, a receiver drops a corrupted frame and resyncs on the next delimiter.
+*/
+const byte COBS_DELIMITER = 0;
+const byte COBS_MAX_BLOCK_LENGTH = 254;
+const unsigned int COBS_CRC_SIZE = 2;
+const uint16_t CRC16_INIT = 0xFFFF;
+
+uint16_t updateCrc16(uint16_t crc, byte value);
+
+class CobsEncoder : public Print
+{
+    public:
+        CobsEncoder(Print* output);
+
+        void beginFrame();
+        size_t write(uint8_t value);
+        using Print::write;
+        void endFrame();
+
+    private:
+        Print* output;
+        byte block[COBS_MAX_BLOCK_LENGTH];
+        byte blockLength = 0;
+        uint16_t crc = CRC16_INIT;
+
+        void encode(byte value);
+        void writeBlock();
+};
+
+class CobsDecoder
+{
+    public:
+        CobsDecoder(RingBuffer* input);
+
+        bool hasFrame();
+        bool isFrameValid();
+        unsigned int getFrameLength();
+        void beginFrame();
+        bool read(byte* value);
+        void dropFrame();
+        void dropOversizedFrame();
+        void reset();
+
+    private:
+        RingBuffer* input;
+        //Encoded size of the queued frame, including its delimiter. It is 0 while no frame is queued
+        unsigned int frameSize = 0;
+        unsigned int frameLength = 0;
+        unsigned int scannedBytes = 0;
+        bool discarding = false;
+        unsigned int offset = 0;
+        byte blockLeft = 0;
+        bool zeroPending = false;
+        unsigned int decodedLeft = 0;
+
+        void rewind();
+        bool decode(byte* value);
+};
+
+#endif
@@ -75,8 +75,16 @@ const Exception CANNOT_FILL_WATER_TANK_MAX_VOLUME = Exception(
 
 const Exception MAX_WATER_SOURCES_ERROR = Exception("Max of water sources reached", INVALID_REQUEST);
 const Exception MAX_WATER_TANKS_ERROR = Exception("Max of water tanks reached", INVALID_REQUEST);
+const Exception MAX_IO_INTERFACES_ERROR = Exception("Max of IO interfaces reached", INVALID_REQUEST);
+const Exception MAX_CALIBRATION_TABLES_ERROR = Exception("Max of calibration tables reached", INVALID_REQUEST);
 
 const Exception INVALID_OPERATION_MODE = Exception("Invalid operation mode", INVALID_REQUEST);
+const Exception INVALID_FILTER = Exception("Invalid filter settings", INVALID_REQUEST);
+const Exception INVALID_CALIBRATION = Exception("Invalid calibration table", INVALID_REQUEST);
+const Exception INVALID_CONTROL = Exception("Invalid control settings", INVALID_REQUEST);
+const Exception INVALID_PRIORITY = Exception("Invalid priority weight", INVALID_REQUEST);
+const Exception INVALID_FRAMING = Exception("Invalid framing", INVALID_REQUEST);
+const Exception INVALID_BAUD_RATE = Exception("Invalid baud rate", INVALID_REQUEST);
 
 const Exception CANNOT_REMOVE_WATER_SOURCE_DEPENDENCY = Exception(
     "Cannot remove the water source, there is a water tank dependent of it", INVALID_REQUEST);
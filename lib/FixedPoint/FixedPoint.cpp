@@ -0,0 +1,44 @@
+#include "FixedPoint.h"
+
+const int MAX_MANTISSA = 0x7FFF;
+const byte MAX_SHIFT = 30;
+
+long FixedPoint::fromFloat(float value) {
+    float limit = (float) FIXED_LIMIT / FIXED_ONE;
+    if (value >= limit) {
+        return FIXED_LIMIT;
+    } else if (value <= -limit) {
+        return -FIXED_LIMIT;
+    }
+    return (long) (value * FIXED_ONE + (value < 0 ? -0.5 : 0.5));
+}
+
+float FixedPoint::toFloat(long value) {
+    return (float) value / FIXED_ONE;
+}
+
+long FixedPoint::limit(long value) {
+    return constrain(value, -FIXED_LIMIT, FIXED_LIMIT);
+}
+
+void FixedScale::setFactor(float factor) {
+    //The largest shift that keeps the mantissa in 15 bits gives the most precision
+    float scaledFactor = factor < 0 ? -factor : factor;
+    this->shift = 0;
+    while (scaledFactor > 0 && scaledFactor * 2 < MAX_MANTISSA && this->shift < MAX_SHIFT) {
+        scaledFactor *= 2;
+        this->shift += 1;
+    }
+    int mantissa = (int) min(scaledFactor + 0.5, (float) MAX_MANTISSA);
+    this->mantissa = factor < 0 ? -mantissa : mantissa;
+}
+
+long FixedScale::apply(unsigned int rawValue) {
+    long product = (long) rawValue * this->mantissa;
+    if (this->shift >= FIXED_FRACTION_BITS) {
+        return FixedPoint::limit(product >> (this->shift - FIXED_FRACTION_BITS));
+    }
+    //Only a factor of 32 or more is shifted to the left, the product is limited before it can overflow
+    long maxProduct = FIXED_LIMIT >> (FIXED_FRACTION_BITS - this->shift);
+    return constrain(product, -maxProduct, maxProduct) * (1L << (FIXED_FRACTION_BITS - this->shift));
+}
@@ -0,0 +1,35 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <Arduino.h>
+
+//The control values are longs with FIXED_FRACTION_BITS fractional bits, a resolution of about 0.001 units.
+//They are limited to FIXED_LIMIT, so the sum or the difference of two values still fits a long
+const byte FIXED_FRACTION_BITS = 10;
+const long FIXED_ONE = 1L << FIXED_FRACTION_BITS;
+const long FIXED_LIMIT = 0x3FFFFFFFL;
+
+class FixedPoint
+{
+    public:
+        static long fromFloat(float value);
+        static float toFloat(long value);
+        static long limit(long value);
+};
+
+/*
+A factor applied to the raw values of a sensor. The factor is kept as a 15 bits mantissa and a shift chosen when
+it is set, so applying it to a raw value is a 16x16 bits multiply and a shift, with about 5 significant digits.
+*/
+class FixedScale
+{
+    public:
+        void setFactor(float factor);
+        long apply(unsigned int rawValue);
+
+    private:
+        int mantissa = 0;
+        byte shift = FIXED_FRACTION_BITS;
+};
+
+#endif
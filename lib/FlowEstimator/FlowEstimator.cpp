@@ -0,0 +1,87 @@
+#include "FlowEstimator.h"
+
+const long SAMPLES_PER_MINUTE = 60000UL / FLOW_SAMPLING_INTERVAL;
+
+//By the amount of volumes n: the sum of the positions 0..n-1, and n times the sum of their squares less the square
+//of their sum, the divisor of the slope
+constexpr unsigned int POSITIONS_SUMS[] PROGMEM = {0, 0, 1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 66};
+constexpr unsigned int SLOPE_DIVISORS[] PROGMEM = {0, 0, 1, 6, 20, 50, 105, 196, 336, 540, 825, 1210, 1716};
+
+static_assert(sizeof(POSITIONS_SUMS) / sizeof(unsigned int) == FLOW_WINDOW + 1 &&
+              sizeof(SLOPE_DIVISORS) / sizeof(unsigned int) == FLOW_WINDOW + 1 &&
+              POSITIONS_SUMS[FLOW_WINDOW] == FLOW_WINDOW * (FLOW_WINDOW - 1) / 2 &&
+              SLOPE_DIVISORS[FLOW_WINDOW] == FLOW_WINDOW * FLOW_WINDOW * (FLOW_WINDOW * FLOW_WINDOW - 1) / 12,
+              "Every window size must have its sums");
+//A volume at position i is i steps at most from the base volume, so the terms of the slope numerator are under
+//n times the sum of the squared positions by MAX_FLOW_STEP, and the numerator by the samples per minute is under the
+//slope divisor by MAX_FLOW_RATE
+static_assert((SLOPE_DIVISORS[FLOW_WINDOW] + (long) POSITIONS_SUMS[FLOW_WINDOW] * POSITIONS_SUMS[FLOW_WINDOW]) * MAX_FLOW_STEP <= 0x7FFFFFFFL &&
+              SLOPE_DIVISORS[FLOW_WINDOW] * MAX_FLOW_RATE <= 0x7FFFFFFFL, "The sums of the volumes must fit a long");
+
+FlowEstimator::FlowEstimator() : volumes() {
+
+}
+
+void FlowEstimator::push(long volume) {
+    //The fixed point volumes are under FIXED_LIMIT, so their difference fits a long
+    if (!this->isEmpty() && abs(volume - this->getNewestVolume()) > MAX_FLOW_STEP) {
+        this->clear();
+    }
+    if (this->isEmpty()) {
+        this->baseVolume = volume;
+    }
+    if (this->isFull()) {
+        this->dropOldestVolume();
+    }
+    long difference = volume - this->baseVolume;
+    this->volumesSum += difference;
+    this->weightedVolumesSum += this->totalVolumes * difference;
+    this->volumes[(this->head + this->totalVolumes) % FLOW_WINDOW] = volume;
+    this->totalVolumes += 1;
+}
+
+long FlowEstimator::getRate() {
+    //The volume per minute, 0 until there are enough volumes for a slope
+    if (!this->isReady()) {
+        return 0;
+    }
+    long positionsSum = pgm_read_word(&POSITIONS_SUMS[this->totalVolumes]);
+    long numerator = this->totalVolumes * this->weightedVolumesSum - positionsSum * this->volumesSum;
+    return (numerator * SAMPLES_PER_MINUTE) / (long) pgm_read_word(&SLOPE_DIVISORS[this->totalVolumes]);
+}
+
+bool FlowEstimator::isReady() {
+    return this->totalVolumes >= 3;
+}
+
+bool FlowEstimator::isFull() {
+    return this->totalVolumes == FLOW_WINDOW;
+}
+
+bool FlowEstimator::isEmpty() {
+    return this->totalVolumes == 0;
+}
+
+void FlowEstimator::clear() {
+    this->head = 0;
+    this->totalVolumes = 0;
+    this->baseVolume = 0;
+    this->volumesSum = 0;
+    this->weightedVolumesSum = 0;
+}
+
+long FlowEstimator::getNewestVolume() {
+    return this->volumes[(this->head + this->totalVolumes - 1) % FLOW_WINDOW];
+}
+
+void FlowEstimator::dropOldestVolume() {
+    //The oldest volume is the base, so it leaves the sums as they are. Every volume left moves a position back, then
+    //they are rebased on the new oldest volume, which is a step at most from the base
+    this->head = (this->head + 1) % FLOW_WINDOW;
+    this->totalVolumes -= 1;
+    this->weightedVolumesSum -= this->volumesSum;
+    long shift = this->volumes[this->head] - this->baseVolume;
+    this->volumesSum -= this->totalVolumes * shift;
+    this->weightedVolumesSum -= (long) pgm_read_word(&POSITIONS_SUMS[this->totalVolumes]) * shift;
+    this->baseVolume = this->volumes[this->head];
+}
@@ -0,0 +1,49 @@
+#ifndef FLOW_ESTIMATOR_H
+#define FLOW_ESTIMATOR_H
+
+#include <Arduino.h>
+
+#include "FixedPoint.h"
+
+const byte FLOW_WINDOW = 12;
+const unsigned long FLOW_SAMPLING_INTERVAL = 10000UL; //10 seconds, the window spans 2 minutes
+//The sums are kept in 32 bits, so a volume differs from the previous one by MAX_FLOW_STEP at most, 128 units per sample.
+//A larger step is not a flow, the window restarts from it. The slope is an average of the steps, so it is bounded too
+const long MAX_FLOW_STEP = 128 * FIXED_ONE;
+const long MAX_FLOW_RATE = MAX_FLOW_STEP * (long) (60000UL / FLOW_SAMPLING_INTERVAL);
+
+/*
+Estimates the flow of a water tank by the least squares slope of its last FLOW_WINDOW volumes, sampled once per
+FLOW_SAMPLING_INTERVAL. The samples are taken as evenly spaced, so the sums of the times are constants of the
+amount of samples, read from a table, and only the sums of the volumes are kept: they are updated as the window
+slides, a new volume costs the same whatever the window is. The volumes are fixed point values, they are summed
+relative to the oldest one in the window so the sums fit 32 bits.
+*/
+class FlowEstimator
+{
+    public:
+        FlowEstimator();
+
+        void push(long volume);
+        long getRate();
+        bool isReady();
+        bool isFull();
+        bool isEmpty();
+        void clear();
+
+    private:
+        long volumes[FLOW_WINDOW];
+        //The index of the oldest volume
+        byte head = 0;
+        byte totalVolumes = 0;
+        //The sum of the volumes and the sum of the volumes by their positions in the window, the oldest is 0. The volumes
+        //are summed less the base volume, the oldest one
+        long baseVolume = 0;
+        long volumesSum = 0;
+        long weightedVolumesSum = 0;
+
+        long getNewestVolume();
+        void dropOldestVolume();
+};
+
+#endif
@@ -6,12 +6,16 @@
 
 int ITEM_NOT_FOUND = -1;
 
-IOInterface** IOInterface::ios = NULL;
-unsigned int* IOInterface::ioPins = NULL;
+Pool<IOInterface, IO_INTERFACES_CAPACITY> IOInterface::pool;
+IOInterface* IOInterface::ios[IO_INTERFACES_CAPACITY];
+unsigned int IOInterface::ioPins[IO_INTERFACES_CAPACITY];
 unsigned int IOInterface::totalIos = 0;
+unsigned long IOInterface::samplingRound = 1;
 
 #ifdef TEST
 IOSource IOInterface::source = VIRTUAL;
+unsigned int IOInterface::samplingReads = 0;
+unsigned int IOInterface::maxSamplingReads = 0;
 #endif
 
 IOInterface::IOInterface(unsigned int pin, IOMode mode, IOType type) {
@@ -23,19 +27,37 @@ IOInterface::IOInterface(unsigned int pin, IOMode mode, IOType type) {
 	pinMode(pin, (mode == READ_ONLY) ? INPUT : OUTPUT);
 	#endif
 
+	if (type == ANALOGIC && mode != WRITE_ONLY) {
+		this->backgroundSampled = AnalogSampler::addPin(pin);
+		#ifdef TEST
+		if (IOInterface::source == VIRTUAL) {
+			AnalogSampler::simulateConversions(pin, this->value, CONVERSIONS_RING_SIZE);
+		}
+		#endif
+	} else {
+		AnalogSampler::removePin(pin);
+	}
+
 	int ioIndex = IOInterface::getIndex(pin);
 	if (ioIndex != ITEM_NOT_FOUND) {
 		delete IOInterface::ios[ioIndex];
 		IOInterface::ios[ioIndex] = this;
 	} else {
+		//The IO interfaces are allocated from the pool, so there is always room for them in the tables
 		IOInterface::totalIos += 1;
-		IOInterface::ios = (IOInterface**) realloc(IOInterface::ios, IOInterface::totalIos * sizeof(IOInterface*));
-		IOInterface::ioPins = (unsigned int*) realloc(IOInterface::ioPins, IOInterface::totalIos * sizeof(unsigned int));
 		IOInterface::ios[IOInterface::totalIos - 1] = this;
 		IOInterface::ioPins[IOInterface::totalIos - 1] = pin;
 	}
 }
 
+void* IOInterface::operator new(size_t size) noexcept {
+	return IOInterface::pool.allocate();
+}
+
+void IOInterface::operator delete(void* pointer) {
+	IOInterface::pool.release(pointer);
+}
+
 IOInterface* IOInterface::get(unsigned int pin) {
     int ioIndex = IOInterface::getIndex(pin);
 	if (ioIndex != ITEM_NOT_FOUND) {
@@ -49,6 +71,7 @@ void IOInterface::remove(unsigned int pin) {
 	if (ioIndex == ITEM_NOT_FOUND) {
 		return Exception::throwException(&PIN_NOT_FOUND);
 	}
+	AnalogSampler::removePin(pin);
 	delete IOInterface::ios[ioIndex];
 
 	for (unsigned int i = ioIndex + 1; i < IOInterface::totalIos; i++) {
@@ -57,14 +80,11 @@ void IOInterface::remove(unsigned int pin) {
 	}
 
 	IOInterface::totalIos -= 1;
-
-	IOInterface::ios = (IOInterface**) realloc(IOInterface::ios, IOInterface::totalIos * sizeof(IOInterface*));
-	IOInterface::ioPins = (unsigned int*) realloc(IOInterface::ioPins, IOInterface::totalIos * sizeof(unsigned int));
 }
 
 
 void IOInterface::removeAll() {
-	for (unsigned int i = 0; i < IOInterface::totalIos; i++) {
+	while (IOInterface::totalIos > 0) {
 		IOInterface::remove(IOInterface::ioPins[0]);
 	}
 }
@@ -78,8 +98,21 @@ int IOInterface::getIndex(unsigned int pin) {
     return ITEM_NOT_FOUND;
 }
 
+bool IOInterface::isSampledInBackground() {
+	#ifdef TEST
+	//The virtual inputs are fed by simulated conversions
+	if (IOInterface::source == VIRTUAL) {
+		return this->backgroundSampled;
+	}
+	#endif
+	return this->backgroundSampled && AnalogSampler::isRunning();
+}
+
 unsigned int IOInterface::read() {
 	if (type == ANALOGIC) {
+		if (this->isSampledInBackground()) {
+			return AnalogSampler::getLatest(this->pin);
+		}
 		#ifndef TEST
 		return analogRead(this->pin);
 		#else
@@ -103,7 +136,72 @@ unsigned int IOInterface::read() {
 	return 0;
 }
 
+unsigned int IOInterface::sample(byte oversampling) {
+	//The pin is read again for another oversampling, it only happens when the pin is shared by different settings
+	if (this->sampleRound != IOInterface::samplingRound || this->sampleOversampling != oversampling) {
+		if (this->isSampledInBackground()) {
+			//The newest conversions are averaged, no conversion is waited for
+			this->sampledValue = AnalogSampler::getAverage(this->pin, oversampling);
+		} else {
+			unsigned long sum = 0;
+			for (byte i = 0; i < oversampling; i++) {
+				sum += this->read();
+			}
+			this->sampledValue = (sum + oversampling / 2) / oversampling;
+		}
+		this->sampleOversampling = oversampling;
+		this->sampleRound = IOInterface::samplingRound;
+		#ifdef TEST
+		IOInterface::samplingReads += oversampling;
+		#endif
+	}
+	return this->sampledValue;
+}
+
+void IOInterface::startSampling(unsigned long currentTime) {
+	//The values sampled in the previous round are outdated
+	IOInterface::samplingRound += 1;
+	AnalogSampler::startPass(currentTime);
+	#ifdef TEST
+	//The simulated sampler converts each virtual input once per round, as the interrupt does between the rounds
+	if (IOInterface::source == VIRTUAL) {
+		for (unsigned int i = 0; i < IOInterface::totalIos; i++) {
+			if (IOInterface::ios[i]->backgroundSampled) {
+				AnalogSampler::simulateConversions(IOInterface::ioPins[i], IOInterface::ios[i]->value, 1);
+			}
+		}
+	}
+	IOInterface::maxSamplingReads = max(IOInterface::maxSamplingReads, IOInterface::samplingReads);
+	IOInterface::samplingReads = 0;
+	#endif
+}
+
+#ifdef TEST
+void IOInterface::setSource(IOSource source) {
+	IOInterface::source = source;
+	//The physical inputs are converted by the interrupt, the virtual inputs by simulated conversions of their values
+	if (source == PHYSICAL) {
+		AnalogSampler::start();
+	} else {
+		AnalogSampler::stop();
+		for (unsigned int i = 0; i < IOInterface::totalIos; i++) {
+			if (IOInterface::ios[i]->backgroundSampled) {
+				AnalogSampler::simulateConversions(IOInterface::ioPins[i], IOInterface::ios[i]->value, CONVERSIONS_RING_SIZE);
+			}
+		}
+	}
+}
+
+unsigned int IOInterface::popMaxSamplingReads() {
+	unsigned int maxSamplingReads = IOInterface::maxSamplingReads;
+	IOInterface::maxSamplingReads = 0;
+	return maxSamplingReads;
+}
+#endif
+
 void IOInterface::write(unsigned int value) {
+	//The written value is read again by the next sample
+	this->sampleRound = IOInterface::samplingRound - 1;
 	if (type == ANALOGIC) {
 		#ifndef TEST
 		analogWrite(this->pin, value);
@@ -111,7 +209,11 @@ void IOInterface::write(unsigned int value) {
 		if (IOInterface::source == PHYSICAL) {
 			analogWrite(this->pin, value);
 		} else {
+			//The virtual input holds the value, so every conversion the sampler makes from now on gives it
 			this->value = value;
+			if (this->backgroundSampled) {
+				AnalogSampler::simulateConversions(this->pin, value, CONVERSIONS_RING_SIZE);
+			}
 		}
 		#endif
 	} else if (type == DIGITAL) {
@@ -1,6 +1,14 @@
 #ifndef INPUT_SOURCE_H
 #define INPUT_SOURCE_H
 
+#include "Pool.h"
+#include "AnalogSampler.h"
+
+//Every water tank and water source uses an IO interface, they may share the same pin
+#ifndef IO_INTERFACES_CAPACITY
+#define IO_INTERFACES_CAPACITY 10
+#endif
+
 enum IOMode {
     READ_ONLY, WRITE_ONLY, READ_WRITE
 };
@@ -21,16 +29,26 @@ class IOInterface
         IOInterface(unsigned int pin, IOMode mode, IOType type);
 
         unsigned int read();
+        unsigned int sample(byte oversampling = 1);
         void write(unsigned int w);
         unsigned int getPin();
 
         #ifdef TEST
         static IOSource source;
+        static void setSource(IOSource source);
         #endif
 
+        static void* operator new(size_t size) noexcept;
+        static void operator delete(void* pointer);
+        static Pool<IOInterface, IO_INTERFACES_CAPACITY> pool;
+
         static IOInterface* get(unsigned int pin);
         static void remove(unsigned int pin);
         static void removeAll();
+        static void startSampling(unsigned long currentTime);
+        #ifdef TEST
+        static unsigned int popMaxSamplingReads();
+        #endif
 
     protected:
         unsigned int pin;
@@ -41,10 +59,22 @@ class IOInterface
         #endif
     
     private:
-        static IOInterface** ios;
-        static unsigned int* ioPins;
+        //The analog inputs are sampled in the background, an input without an ADC channel is read when needed
+        bool backgroundSampled = false;
+        //The value read in the current sampling round, so each pin is read once per round
+        unsigned int sampledValue = 0;
+        byte sampleOversampling = 0;
+        unsigned long sampleRound = 0;
+        static unsigned long samplingRound;
+        #ifdef TEST
+        static unsigned int samplingReads;
+        static unsigned int maxSamplingReads;
+        #endif
+        static IOInterface* ios[IO_INTERFACES_CAPACITY];
+        static unsigned int ioPins[IO_INTERFACES_CAPACITY];
         static unsigned int totalIos;
         static int getIndex(unsigned int pin);
+        bool isSampledInBackground();
 };
 
 #endif
@@ -4,96 +4,160 @@
 
 const int ITEM_NOT_FOUND = -1;
 
-Manager::Manager() : waterTanksLoopErrors() {
-    this->waterTanksErrorsTimer = new Clock();
-    this->waterTanksErrorsTimer->startTimer();
+Pool<Manager, 1> Manager::pool;
+
+//The pools are static, so they take their whole capacity of the 8 KB SRAM of the Mega. The rest is left for the
+//serial buffers, the request and response messages and the stack, a capacity raised by the build flags must fit
+const unsigned int POOLS_SRAM_BUDGET = 3072;
+static_assert(sizeof(Manager::pool) + sizeof(WaterTank::pool) + sizeof(WaterSource::pool) + sizeof(IOInterface::pool) +
+              sizeof(CalibrationTable::pool) <= POOLS_SRAM_BUDGET, "The resources pools must fit their SRAM budget");
+
+Manager::Manager() : waterTanks(), waterSources(),
+                     waterTankNamesIndex(waterTankNamesTable, sizeof(waterTankNamesTable)),
+                     waterTanksIndex(waterTanksTable, sizeof(waterTanksTable)),
+                     waterSourceNamesIndex(waterSourceNamesTable, sizeof(waterSourceNamesTable)),
+                     waterSourcesIndex(waterSourcesTable, sizeof(waterSourcesTable)),
+                     waterTankDependents(), waterSourceDependents(), waterTanksLoopErrors(),
+                     waterTanksNotifiedVolumes(), waterTanksNotificationTimes(), waterTanksDeadlines(),
+                     waterSourcesArbitrationPending(), waterTanksDemandTimes(), waterTanksWaiting() {
+    memset(this->waterSourceOwners, EMPTY_SLOT, sizeof(this->waterSourceOwners));
+    this->waterTanksErrorsTime = Clock::currentMillis();
+    this->lastLoopTime = this->waterTanksErrorsTime;
 }
 
 Manager::~Manager() {
-    delete this->waterTanksErrorsTimer;
-
-    char* name;
-    WaterTank* waterTank;
-    WaterSource* waterSource;
     for (unsigned int i = 0; i < this->totalWaterSources; i++) {
-        name = this->waterSourceNames[i];
-        waterSource = this->waterSources[i]; 
-        delete[] name;
-        delete waterSource;
+        delete this->waterSources[this->waterSourceOrder[i]];
     }
 
     for (unsigned int j = 0; j < this->totalWaterTanks; j++) {
-        name = this->waterTankNames[j];
-        waterTank = this->waterTanks[j]; 
-        delete[] name;
-        delete waterTank;
+        delete this->waterTanks[this->waterTankOrder[j]];
     }
     
     IOInterface::removeAll();
 }
 
+void* Manager::operator new(size_t size) noexcept {
+    return Manager::pool.allocate();
+}
+
+void Manager::operator delete(void* pointer) {
+    Manager::pool.release(pointer);
+}
+
 OperationMode Manager::getOperationMode() {
     return this->mode;
 }
 
 void Manager::setOperationMode(OperationMode mode) {
+    if (this->mode != mode) {
+        Notifier::notify(OPERATION_MODE_CHANGED, this, mode);
+        //The water tanks are not run in manual mode, so they are run right away
+        this->wakeUp();
+        //The water sources are handed out again from the state left by the previous mode
+        memset(this->waterSourceOwners, EMPTY_SLOT, sizeof(this->waterSourceOwners));
+        memset(this->waterTanksWaiting, false, sizeof(this->waterTanksWaiting));
+        for (unsigned int i = 0; i < this->totalWaterTanks; i++) {
+            this->waterTanks[this->waterTankOrder[i]]->clearFillRequest();
+        }
+    }
     this->mode = mode;
 }
 
 WaterTank* Manager::getWaterTank(char* name) {
     WaterTank* waterTank = NULL;
-    int waterTankIndex = this->getWaterTankIndex(name);
-    if (waterTankIndex == ITEM_NOT_FOUND) {
+    int waterTankSlot = this->getWaterTankSlot(name);
+    if (waterTankSlot == ITEM_NOT_FOUND) {
+        Exception::throwException(&WATER_TANK_NOT_FOUND);
+    } else {
+        waterTank = this->waterTanks[waterTankSlot]; 
+    }
+    return waterTank;
+}
+
+WaterTank* Manager::getWaterTank(unsigned int handle) {
+    WaterTank* waterTank = NULL;
+    int waterTankSlot = this->getWaterTankSlot(handle);
+    if (waterTankSlot == ITEM_NOT_FOUND) {
         Exception::throwException(&WATER_TANK_NOT_FOUND);
     } else {
-        waterTank = this->waterTanks[waterTankIndex]; 
+        waterTank = this->waterTanks[waterTankSlot];
     }
     return waterTank;
 }
 
 WaterSource* Manager::getWaterSource(char* name) {
     WaterSource* waterSource = NULL;
-    int waterSourceIndex = this->getWaterSourceIndex(name);
-    if (waterSourceIndex == ITEM_NOT_FOUND) {
+    int waterSourceSlot = this->getWaterSourceSlot(name);
+    if (waterSourceSlot == ITEM_NOT_FOUND) {
+        Exception::throwException(&WATER_SOURCE_NOT_FOUND);
+    } else {
+        waterSource = this->waterSources[waterSourceSlot];
+    }
+    return waterSource;
+}
+
+WaterSource* Manager::getWaterSource(unsigned int handle) {
+    WaterSource* waterSource = NULL;
+    int waterSourceSlot = this->getWaterSourceSlot(handle);
+    if (waterSourceSlot == ITEM_NOT_FOUND) {
         Exception::throwException(&WATER_SOURCE_NOT_FOUND);
     } else {
-        waterSource = this->waterSources[waterSourceIndex];
+        waterSource = this->waterSources[waterSourceSlot];
     }
     return waterSource;
 }
 
 char* Manager::getWaterSourceName(WaterSource* waterSource) {
-    for (unsigned int i = 0; i < this->totalWaterSources; i++) {
-        if (this->waterSources[i] == waterSource) {
-            return this->waterSourceNames[i];
-        }
+    int waterSourceSlot = this->getWaterSourceSlot(waterSource);
+    if (waterSourceSlot == ITEM_NOT_FOUND) {
+        return NULL;
     }
-    return NULL;
+    return this->waterSourceNames[waterSourceSlot];
 }
 
 char* Manager::getWaterTankName(WaterTank* waterTank) {
-    for (unsigned int i = 0; i < this->totalWaterTanks; i++) {
-        if (this->waterTanks[i] == waterTank) {
-            return this->waterTankNames[i];
-        }
+    int waterTankSlot = this->getWaterTankSlot(waterTank);
+    if (waterTankSlot == ITEM_NOT_FOUND) {
+        return NULL;
     }
-    return NULL;
+    return this->waterTankNames[waterTankSlot];
 }
 
-char** Manager::getWaterSourceNames() {
-    char** list = (char**) malloc(this->totalWaterSources * sizeof(char*));
+WaterTank* Manager::getWaterSourceOwner(WaterSource* waterSource) {
+    int waterSourceSlot = this->getWaterSourceSlot(waterSource);
+    if (waterSourceSlot == ITEM_NOT_FOUND || this->waterSourceOwners[waterSourceSlot] == EMPTY_SLOT) {
+        return NULL;
+    }
+    return this->waterTanks[this->waterSourceOwners[waterSourceSlot]];
+}
+
+unsigned int Manager::getWaterSourceHandle(char* name) {
+    int waterSourceSlot = this->getWaterSourceSlot(name);
+    if (waterSourceSlot == ITEM_NOT_FOUND) {
+        return NO_HANDLE;
+    }
+    return waterSourceSlot + 1;
+}
+
+unsigned int Manager::getWaterTankHandle(char* name) {
+    int waterTankSlot = this->getWaterTankSlot(name);
+    if (waterTankSlot == ITEM_NOT_FOUND) {
+        return NO_HANDLE;
+    }
+    return waterTankSlot + 1;
+}
+
+void Manager::getWaterSourceNames(char** list) {
     for (unsigned int i = 0; i < this->totalWaterSources; i++) {
-        list[i] = this->waterSourceNames[i];
+        list[i] = this->waterSourceNames[this->waterSourceOrder[i]];
     }
-    return list;
 }
 
-char** Manager::getWaterTankNames() {
-    char** list = (char**) malloc(this->totalWaterTanks * sizeof(char*));
+void Manager::getWaterTankNames(char** list) {
     for (unsigned int i = 0; i < this->totalWaterTanks; i++) {
-        list[i] = this->waterTankNames[i];
+        list[i] = this->waterTankNames[this->waterTankOrder[i]];
     }
-    return list;
 }
 
 unsigned int Manager::getTotalWaterSources() {
@@ -104,9 +168,21 @@ unsigned int Manager::getTotalWaterTanks() {
     return this->totalWaterTanks;
 }
 
-void Manager::setWaterSourceState(char* name, bool enabled, bool force) {
-    WaterSource* waterSource = this->getWaterSource(name);
-    if (!Exception::hasException()) {
+const Exception* Manager::getPendingError(char** waterTankName) {
+    //The water tanks loop errors are only collected in auto mode
+    for (unsigned int i = 0; this->mode == AUTO && i < this->totalWaterTanks; i++) {
+        byte slot = this->waterTankOrder[i];
+        if (this->waterTanksLoopErrors[slot] != NULL) {
+            *waterTankName = this->waterTankNames[slot];
+            return this->waterTanksLoopErrors[slot];
+        }
+    }
+    *waterTankName = NULL;
+    return NULL;
+}
+
+void Manager::setWaterSourceState(WaterSource* waterSource, bool enabled, bool force) {
+    if (waterSource != NULL) {
         if (this->mode == AUTO) {
             return Exception::throwException(&CANNOT_HANDLE_WATER_SOURCE_IN_AUTO);
         }
@@ -118,8 +194,8 @@ void Manager::setWaterSourceState(char* name, bool enabled, bool force) {
     }
 }
 
-void Manager::setWaterSourceState(char* name, bool enabled) {
-    return this->setWaterSourceState(name, enabled, false);
+void Manager::setWaterSourceState(WaterSource* waterSource, bool enabled) {
+    return this->setWaterSourceState(waterSource, enabled, false);
 }
 
 void Manager::registerWaterSource(char* name, WaterSource* waterSource) {
@@ -127,16 +203,28 @@ void Manager::registerWaterSource(char* name, WaterSource* waterSource) {
         return Exception::throwException(&WATER_SOURCE_ALREADY_REGISTERED);
     } else if(this->totalWaterSources + 1 > MAX_WATER_SOURCES) {
         return Exception::throwException(&MAX_WATER_SOURCES_ERROR);
-    } else {
-        char* waterSourceName = new char[MAX_NAME_LENGTH + 1];
-        strncpy(waterSourceName, name, MAX_NAME_LENGTH);
-        if (strlen(waterSourceName) == 0) {
-            delete[] waterSourceName;
-            return Exception::throwException(&RESOURCE_NAME_EMPTY);
-        }
-        this->totalWaterSources += 1;
-        this->waterSources[this->totalWaterSources - 1] = waterSource;
-        this->waterSourceNames[this->totalWaterSources - 1] = waterSourceName;
+    }
+    //The API only creates a water source with a registered water tank, so it is appended after its dependency
+    //The lowest free slot is used, so the handles are the same after loading the API from the EEPROM
+    byte slot = 0;
+    while (this->waterSources[slot] != NULL) {
+        slot++;
+    }
+    char* waterSourceName = this->waterSourceNames[slot];
+    if (!this->copyName(waterSourceName, name)) {
+        return Exception::throwException(&RESOURCE_NAME_EMPTY);
+    }
+    this->waterSources[slot] = waterSource;
+    this->waterSourceOrder[this->totalWaterSources] = slot;
+    this->totalWaterSources += 1;
+    this->waterSourceNamesIndex.insert(SlotIndex::hash(waterSourceName, MAX_NAME_LENGTH), slot);
+    this->waterSourcesIndex.insert(SlotIndex::hash(waterSource), slot);
+    this->waterSourceOwners[slot] = EMPTY_SLOT;
+    this->waterSourcesArbitrationPending[slot] = false;
+
+    int waterTankSlot = this->getWaterTankSlot(waterSource->getWaterTank());
+    if (waterTankSlot != ITEM_NOT_FOUND) {
+        this->waterTankDependents[waterTankSlot] += 1;
     }
 }
 
@@ -145,40 +233,59 @@ void Manager::registerWaterTank(char* name, WaterTank* waterTank) {
         return Exception::throwException(&WATER_TANK_ALREADY_REGISTERED);
     } else if(this->totalWaterTanks + 1 > MAX_WATER_TANKS) {
         return Exception::throwException(&MAX_WATER_TANKS_ERROR);
-    } else {
-        char* waterTankName = new char[MAX_NAME_LENGTH + 1];
-        strncpy(waterTankName, name, MAX_NAME_LENGTH);
-        if (strlen(waterTankName) == 0) {
-            delete[] waterTankName;
-            return Exception::throwException(&RESOURCE_NAME_EMPTY);
-        }
-        this->totalWaterTanks += 1;
-        this->waterTanks[this->totalWaterTanks - 1] = waterTank;
-        this->waterTankNames[this->totalWaterTanks - 1] = waterTankName;
+    }
+    //The API only creates a water tank with a registered water source, so it is appended after its dependency
+    //The lowest free slot is used, so the handles are the same after loading the API from the EEPROM
+    byte slot = 0;
+    while (this->waterTanks[slot] != NULL) {
+        slot++;
+    }
+    char* waterTankName = this->waterTankNames[slot];
+    if (!this->copyName(waterTankName, name)) {
+        return Exception::throwException(&RESOURCE_NAME_EMPTY);
+    }
+    this->waterTanks[slot] = waterTank;
+    this->waterTankOrder[this->totalWaterTanks] = slot;
+    this->totalWaterTanks += 1;
+    this->waterTankNamesIndex.insert(SlotIndex::hash(waterTankName, MAX_NAME_LENGTH), slot);
+    this->waterTanksIndex.insert(SlotIndex::hash(waterTank), slot);
+    this->waterTanksLoopErrors[slot] = NULL;
+    this->waterTanksNotifiedVolumes[slot] = UNDEFINED_VOLUME;
+    this->waterTanksNotificationTimes[slot] = 0;
+    this->waterTanksWaiting[slot] = false;
+    this->scheduleWaterTank(slot, Clock::currentMillis(), this->totalWaterTanks - 1);
+
+    int waterSourceSlot = this->getWaterSourceSlot(waterTank->getWaterSource());
+    if (waterSourceSlot != ITEM_NOT_FOUND) {
+        this->waterSourceDependents[waterSourceSlot] += 1;
     }
 }
 
-WaterSource* Manager::unregisterWaterSource(char* name) {
-    WaterSource* waterSource = NULL;
+WaterSource* Manager::unregisterWaterSource(WaterSource* waterSource) {
+    int waterSourceSlot = this->getWaterSourceSlot(waterSource);
 
-    if (!this->isWaterSourceRegistered(name)) {
+    if (waterSourceSlot == ITEM_NOT_FOUND) {
         Exception::throwException(&WATER_SOURCE_NOT_FOUND);
-    } else if (this->isWaterSourceDependency(name)) {
+        waterSource = NULL;
+    } else if (this->isWaterSourceDependency(waterSource)) {
         Exception::throwException(&CANNOT_REMOVE_WATER_SOURCE_DEPENDENCY);
+        waterSource = NULL;
     } else {
-        int waterSourceIndex = this->getWaterSourceIndex(name);
+        char* waterSourceName = this->waterSourceNames[waterSourceSlot];
+        this->waterSourceNamesIndex.remove(SlotIndex::hash(waterSourceName, MAX_NAME_LENGTH), waterSourceSlot);
+        this->waterSourcesIndex.remove(SlotIndex::hash(waterSource), waterSourceSlot);
+        this->removeOrder(this->waterSourceOrder, this->totalWaterSources, waterSourceSlot);
+        this->waterSources[waterSourceSlot] = NULL;
+        waterSourceName[0] = '\0';
 
-        waterSource = this->waterSources[waterSourceIndex];
-        char* waterSourceName = this->waterSourceNames[waterSourceIndex];
+        this->totalWaterSources -= 1;
 
-        for (unsigned int i = waterSourceIndex + 1; i < this->totalWaterSources; i++) {
-            this->waterSources[i - 1] = this->waterSources[i];
-            this->waterSourceNames[i - 1] = this->waterSourceNames[i];
+        int waterTankSlot = this->getWaterTankSlot(waterSource->getWaterTank());
+        if (waterTankSlot != ITEM_NOT_FOUND) {
+            this->waterTankDependents[waterTankSlot] -= 1;
         }
 
-        this->totalWaterSources -= 1;
-
-        delete[] waterSourceName;
+        Notifier::discard(waterSource);
 
         unsigned int pin = waterSource->getPin();
         if (!this->isIOInterfaceDependency(pin)) {
@@ -188,27 +295,37 @@ WaterSource* Manager::unregisterWaterSource(char* name) {
     return waterSource;
 }
 
-WaterTank* Manager::unregisterWaterTank(char* name) {
-    WaterTank* waterTank = NULL;
+WaterTank* Manager::unregisterWaterTank(WaterTank* waterTank) {
+    int waterTankSlot = this->getWaterTankSlot(waterTank);
 
-    if (!this->isWaterTankRegistered(name)) {
+    if (waterTankSlot == ITEM_NOT_FOUND) {
         Exception::throwException(&WATER_TANK_NOT_FOUND);
-    } else if (this->isWaterTankDependency(name)) {
+        waterTank = NULL;
+    } else if (this->isWaterTankDependency(waterTank)) {
         Exception::throwException(&CANNOT_REMOVE_WATER_TANK_DEPENDENCY);
+        waterTank = NULL;
     } else {
-        int waterTankIndex = this->getWaterTankIndex(name);
+        char* waterTankName = this->waterTankNames[waterTankSlot];
+        this->waterTankNamesIndex.remove(SlotIndex::hash(waterTankName, MAX_NAME_LENGTH), waterTankSlot);
+        this->waterTanksIndex.remove(SlotIndex::hash(waterTank), waterTankSlot);
+        this->removeOrder(this->waterTankOrder, this->totalWaterTanks, waterTankSlot);
+        this->removeOrder(this->waterTankSchedule, this->totalWaterTanks, waterTankSlot);
+        this->waterTanks[waterTankSlot] = NULL;
+        waterTankName[0] = '\0';
+        this->waterTanksLoopErrors[waterTankSlot] = NULL;
 
-        waterTank = this->waterTanks[waterTankIndex];
-        char* waterTankName = this->waterTankNames[waterTankIndex];
+        this->totalWaterTanks -= 1;
 
-        for (unsigned int i = waterTankIndex + 1; i < this->totalWaterTanks; i++) {
-            this->waterTanks[i - 1] = this->waterTanks[i];
-            this->waterTankNames[i - 1] = this->waterTankNames[i];
+        int waterSourceSlot = this->getWaterSourceSlot(waterTank->getWaterSource());
+        if (waterSourceSlot != ITEM_NOT_FOUND) {
+            this->waterSourceDependents[waterSourceSlot] -= 1;
+            if (this->waterSourceOwners[waterSourceSlot] == waterTankSlot) {
+                this->waterSourceOwners[waterSourceSlot] = EMPTY_SLOT;
+                this->waterSourcesArbitrationPending[waterSourceSlot] = true;
+            }
         }
 
-        this->totalWaterTanks -= 1;
-
-        delete[] waterTankName;
+        Notifier::discard(waterTank);
 
         unsigned int pin = waterTank->getPressureSensorPin();
         if (!this->isIOInterfaceDependency(pin)) {
@@ -219,37 +336,21 @@ WaterTank* Manager::unregisterWaterTank(char* name) {
 }
 
 bool Manager::isWaterSourceRegistered(char* name) {
-    return this->getWaterSourceIndex(name) != ITEM_NOT_FOUND;
+    return this->getWaterSourceSlot(name) != ITEM_NOT_FOUND;
 }
 
 bool Manager::isWaterTankRegistered(char* name) {
-    return this->getWaterTankIndex(name) != ITEM_NOT_FOUND;
+    return this->getWaterTankSlot(name) != ITEM_NOT_FOUND;
 }
 
-bool Manager::isWaterSourceDependency(char* name) {
-    int waterSourceIndex = this->getWaterSourceIndex(name);
-    if (waterSourceIndex != ITEM_NOT_FOUND) {
-        WaterSource* waterSource = this->waterSources[waterSourceIndex];
-        for (unsigned int i = 0; i < this->totalWaterTanks; i++) {
-            if (this->waterTanks[i]->getWaterSource() == waterSource) {
-                return true;
-            }
-        }
-    }
-    return false;
+bool Manager::isWaterSourceDependency(WaterSource* waterSource) {
+    int waterSourceSlot = this->getWaterSourceSlot(waterSource);
+    return waterSourceSlot != ITEM_NOT_FOUND && this->waterSourceDependents[waterSourceSlot] > 0;
 }
 
-bool Manager::isWaterTankDependency(char* name) {
-    int waterTankIndex = this->getWaterTankIndex(name);
-    if (waterTankIndex != ITEM_NOT_FOUND) {
-        WaterTank* waterTank = this->waterTanks[waterTankIndex];
-        for (unsigned int i = 0; i < this->totalWaterSources; i++) {
-            if (this->waterSources[i]->getWaterTank() == waterTank) {
-                return true;
-            }
-        }
-    }
-    return false;
+bool Manager::isWaterTankDependency(WaterTank* waterTank) {
+    int waterTankSlot = this->getWaterTankSlot(waterTank);
+    return waterTankSlot != ITEM_NOT_FOUND && this->waterTankDependents[waterTankSlot] > 0;
 }
 
 bool Manager::isIOInterfaceDependency(unsigned int pin) {
@@ -261,76 +362,279 @@ bool Manager::isIOInterfaceDependency(unsigned int pin) {
 }
 
 bool Manager::isIOInterfaceDependency(IOInterface* io) {
+    //Only used when a resource is removed, so it scans the slots instead of keeping an index by pin
     for (unsigned int i = 0; i < this->totalWaterSources; i++) {
-        if (this->waterSources[i]->getPin() == io->getPin()) {
+        if (this->waterSources[this->waterSourceOrder[i]]->getPin() == io->getPin()) {
             return true;
         }
     }
     for (unsigned int i = 0; i < this->totalWaterTanks; i++) {
-        if (this->waterTanks[i]->getPressureSensorPin() == io->getPin()) {
+        if (this->waterTanks[this->waterTankOrder[i]]->getPressureSensorPin() == io->getPin()) {
             return true;
         }
     }
     return false;
 }
 
-void Manager::fillWaterTank(char* name, bool force) {
+void Manager::fillWaterTank(WaterTank* waterTank, bool force) {
     if (this->mode == AUTO) {
         return Exception::throwException(&CANNOT_HANDLE_WATER_TANK_IN_AUTO);
     }
-    WaterTank* waterTank = this->getWaterTank(name);
     if (waterTank != NULL) {
         waterTank->fill(force);
     }
 }
 
-void Manager::stopFillingWaterTank(char* name) {
+void Manager::stopFillingWaterTank(WaterTank* waterTank) {
     if (this->mode == AUTO) {
         return Exception::throwException(&CANNOT_HANDLE_WATER_TANK_IN_AUTO);
     }
-    WaterTank* waterTank = this->getWaterTank(name);
     if (waterTank != NULL) {
         waterTank->stopFilling();
     }
 }
 
+void Manager::wakeUp() {
+    this->scheduleWaterTanks(Clock::currentMillis());
+}
+
 void Manager::loop() {
-    if (this->mode == AUTO) {
-        for (unsigned int i = 0; i < this->totalWaterTanks; i++) {
-            this->waterTanks[i]->loop();
-            this->waterTanksLoopErrors[i] = Exception::popException();
+    //The clock is read once per loop, so every decision of this loop is taken at the same time
+    unsigned long currentTime = Clock::currentMillis();
+
+    if ((long) (currentTime - this->lastLoopTime) < 0) {
+        //The clock has gone back (only the test clock does it), the deadlines would be too far
+        this->scheduleWaterTanks(currentTime);
+    }
+    this->lastLoopTime = currentTime;
+    IOInterface::startSampling(currentTime);
+
+    if (Notifier::isSubscribed()) {
+        this->notifyVolumeChanges(currentTime);
+    }
+
+    //The water tanks whose deadline has arrived are at the front of the schedule
+    bool waterTanksDue[MAX_WATER_TANKS] = {};
+    bool waterTankDue = false;
+    for (unsigned int i = 0; i < this->totalWaterTanks; i++) {
+        byte slot = this->waterTankSchedule[i];
+        if ((long) (currentTime - this->waterTanksDeadlines[slot]) < 0) {
+            break;
+        }
+        waterTanksDue[slot] = true;
+        waterTankDue = true;
+    }
+
+    //The due water tanks are run upstream first, in the topological order, so a water tank fed by another one
+    //is run on the volume sampled in this loop. The pressure filters are fed in both modes, the water tanks are
+    //only run in auto mode
+    bool arbitrationPending = false;
+    for (unsigned int i = 0; waterTankDue && i < this->totalWaterTanks; i++) {
+        byte slot = this->waterTankOrder[i];
+        if (!waterTanksDue[slot]) {
+            continue;
+        }
+        this->waterTanks[slot]->sample(currentTime);
+        if (this->mode == AUTO) {
+            this->waterTanks[slot]->loop(currentTime);
+            this->waterTanksLoopErrors[slot] = Exception::popException();
+            //The demand of a water tank only changes when it is run
+            int waterSourceSlot = this->getWaterSourceSlot(this->waterTanks[slot]->getWaterSource());
+            if (waterSourceSlot != ITEM_NOT_FOUND) {
+                this->waterSourcesArbitrationPending[waterSourceSlot] = true;
+                arbitrationPending = true;
+            }
+        }
+        //The waiting time is at least 1 ms, so the water tank goes after the due ones
+        this->removeOrder(this->waterTankSchedule, this->totalWaterTanks, slot);
+        this->scheduleWaterTank(slot, currentTime + this->waterTanks[slot]->getWaitingTime(currentTime),
+                                this->totalWaterTanks - 1);
+    }
+
+    //The water sources are arbitrated once every due water tank is sampled, so the ones fed by a water tank see its new volume
+    for (unsigned int i = 0; arbitrationPending && i < this->totalWaterSources; i++) {
+        byte slot = this->waterSourceOrder[i];
+        if (this->waterSourcesArbitrationPending[slot]) {
+            this->arbitrateWaterSource(slot, currentTime);
+            this->waterSourcesArbitrationPending[slot] = false;
         }
-        if (this->totalWaterTanks > 0 && this->waterTanksErrorsTimer->getElapsedTime() >= ERROR_INTERVAL) {
+    }
+
+    if (this->mode == AUTO) {
+        if (this->totalWaterTanks > 0 && currentTime - this->waterTanksErrorsTime >= ERROR_INTERVAL) {
+            if ((unsigned int) this->waterTankErrorIndex >= this->totalWaterTanks) {
+                this->waterTankErrorIndex = 0;
+            }
             const Exception* error = NULL;
-            char* waterTankName = this->waterTankNames[this->waterTankErrorIndex];
+            char* waterTankName = NULL;
             int endIndex = max(0, this->waterTankErrorIndex - 1);
             do {
-                error = this->waterTanksLoopErrors[this->waterTankErrorIndex];
-                waterTankName = this->waterTankNames[this->waterTankErrorIndex];
+                byte slot = this->waterTankOrder[this->waterTankErrorIndex];
+                error = this->waterTanksLoopErrors[slot];
+                waterTankName = this->waterTankNames[slot];
                 this->waterTankErrorIndex = (this->waterTankErrorIndex + 1) % this->totalWaterTanks;
             } while(error == NULL && this->waterTankErrorIndex != endIndex);
             if (error != NULL) {
                 Exception::throwException(error, waterTankName);
             }
-            this->waterTanksErrorsTimer->startTimer();
+            this->waterTanksErrorsTime = currentTime;
         }
     }
 }
 
-int Manager::getWaterTankIndex(char* name) {
+void Manager::arbitrateWaterSource(byte slot, unsigned long currentTime) {
+    WaterSource* waterSource = this->waterSources[slot];
+    byte owner = this->waterSourceOwners[slot];
+
+    //The dependent water tanks are gone through once, the waiting ones get their demand time
+    byte candidate = EMPTY_SLOT;
+    long candidatePriority = 0;
     for (unsigned int i = 0; i < this->totalWaterTanks; i++) {
-        if (strncmp(this->waterTankNames[i], name, MAX_NAME_LENGTH) == 0) {
-            return i;
+        byte waterTankSlot = this->waterTankOrder[i];
+        WaterTank* waterTank = this->waterTanks[waterTankSlot];
+        if (waterTank->getWaterSource() != waterSource || waterTankSlot == owner) {
+            continue;
+        }
+        if (!waterTank->isDemanding(currentTime)) {
+            this->waterTanksWaiting[waterTankSlot] = false;
+            continue;
+        }
+        if (!this->waterTanksWaiting[waterTankSlot]) {
+            this->waterTanksWaiting[waterTankSlot] = true;
+            this->waterTanksDemandTimes[waterTankSlot] = currentTime;
+        }
+        long priority = waterTank->getFillPriority(currentTime - this->waterTanksDemandTimes[waterTankSlot]);
+        if (candidate == EMPTY_SLOT || priority > candidatePriority) {
+            candidate = waterTankSlot;
+            candidatePriority = priority;
+        }
+    }
+
+    //The owner keeps the water source until it stops demanding it, then it goes to the candidate without turning it off
+    if (owner != EMPTY_SLOT && !this->waterTanks[owner]->isDemanding(currentTime)) {
+        this->waterTanks[owner]->release(currentTime);
+        owner = EMPTY_SLOT;
+    }
+    if (owner == EMPTY_SLOT && candidate != EMPTY_SLOT) {
+        this->waterTanks[candidate]->fill(false, currentTime);
+        const Exception* error = Exception::popException();
+        if (error != NULL) {
+            this->waterTanksLoopErrors[candidate] = error;
+        } else {
+            owner = candidate;
+            this->waterTanksWaiting[owner] = false;
+        }
+    }
+    if (owner == EMPTY_SLOT && waterSource->isTurnedOn()) {
+        waterSource->turnOff();
+    }
+    this->waterSourceOwners[slot] = owner;
+}
+
+void Manager::notifyVolumeChanges(unsigned long currentTime) {
+    for (unsigned int i = 0; i < this->totalWaterTanks; i++) {
+        byte slot = this->waterTankOrder[i];
+        //Each water tank notifies its volume at most once per interval
+        if (currentTime - this->waterTanksNotificationTimes[slot] < Notifier::getMinimumInterval()) {
+            continue;
+        }
+        float volume = this->waterTanks[slot]->getVolume();
+        if (this->waterTanksNotifiedVolumes[slot] == UNDEFINED_VOLUME ||
+            abs(volume - this->waterTanksNotifiedVolumes[slot]) >= Notifier::getVolumeDeadband()) {
+            Notifier::notify(WATER_TANK_VOLUME_CHANGED, this->waterTanks[slot], volume);
+            this->waterTanksNotifiedVolumes[slot] = volume;
+            this->waterTanksNotificationTimes[slot] = currentTime;
+        }
+    }
+}
+
+void Manager::scheduleWaterTank(byte slot, unsigned long deadline, unsigned int totalScheduled) {
+    //The water tank goes after the ones with the same deadline
+    unsigned int i = totalScheduled;
+    while (i > 0 && (long) (this->waterTanksDeadlines[this->waterTankSchedule[i - 1]] - deadline) > 0) {
+        this->waterTankSchedule[i] = this->waterTankSchedule[i - 1];
+        i--;
+    }
+    this->waterTankSchedule[i] = slot;
+    this->waterTanksDeadlines[slot] = deadline;
+}
+
+void Manager::scheduleWaterTanks(unsigned long deadline) {
+    for (unsigned int i = 0; i < this->totalWaterTanks; i++) {
+        byte slot = this->waterTankOrder[i];
+        this->waterTankSchedule[i] = slot;
+        this->waterTanksDeadlines[slot] = deadline;
+    }
+}
+
+int Manager::getWaterTankSlot(char* name) {
+    unsigned int position;
+    SlotIndex* index = &this->waterTankNamesIndex;
+    for (byte slot = index->first(SlotIndex::hash(name, MAX_NAME_LENGTH), &position); slot != EMPTY_SLOT; slot = index->next(&position)) {
+        if (strncmp(this->waterTankNames[slot], name, MAX_NAME_LENGTH) == 0) {
+            return slot;
         }
     }
     return ITEM_NOT_FOUND;
 }
 
-int Manager::getWaterSourceIndex(char* name) {
-    for (unsigned int i = 0; i < this->totalWaterSources; i++) {
-        if (strncmp(this->waterSourceNames[i], name, MAX_NAME_LENGTH) == 0) {
-            return i;
+int Manager::getWaterSourceSlot(char* name) {
+    unsigned int position;
+    SlotIndex* index = &this->waterSourceNamesIndex;
+    for (byte slot = index->first(SlotIndex::hash(name, MAX_NAME_LENGTH), &position); slot != EMPTY_SLOT; slot = index->next(&position)) {
+        if (strncmp(this->waterSourceNames[slot], name, MAX_NAME_LENGTH) == 0) {
+            return slot;
         }
     }
     return ITEM_NOT_FOUND;
 }
+
+int Manager::getWaterTankSlot(WaterTank* waterTank) {
+    unsigned int position;
+    SlotIndex* index = &this->waterTanksIndex;
+    for (byte slot = index->first(SlotIndex::hash(waterTank), &position); waterTank != NULL && slot != EMPTY_SLOT; slot = index->next(&position)) {
+        if (this->waterTanks[slot] == waterTank) {
+            return slot;
+        }
+    }
+    return ITEM_NOT_FOUND;
+}
+
+int Manager::getWaterTankSlot(unsigned int handle) {
+    if (handle == NO_HANDLE || handle > MAX_WATER_TANKS || this->waterTanks[handle - 1] == NULL) {
+        return ITEM_NOT_FOUND;
+    }
+    return handle - 1;
+}
+
+int Manager::getWaterSourceSlot(WaterSource* waterSource) {
+    unsigned int position;
+    SlotIndex* index = &this->waterSourcesIndex;
+    for (byte slot = index->first(SlotIndex::hash(waterSource), &position); waterSource != NULL && slot != EMPTY_SLOT; slot = index->next(&position)) {
+        if (this->waterSources[slot] == waterSource) {
+            return slot;
+        }
+    }
+    return ITEM_NOT_FOUND;
+}
+
+int Manager::getWaterSourceSlot(unsigned int handle) {
+    if (handle == NO_HANDLE || handle > MAX_WATER_SOURCES || this->waterSources[handle - 1] == NULL) {
+        return ITEM_NOT_FOUND;
+    }
+    return handle - 1;
+}
+
+bool Manager::copyName(char* resourceName, char* name) {
+    strncpy(resourceName, name, MAX_NAME_LENGTH);
+    resourceName[MAX_NAME_LENGTH] = '\0';
+    return strlen(resourceName) > 0;
+}
+
+void Manager::removeOrder(byte* order, unsigned int total, byte slot) {
+    unsigned int i = 0;
+    while (order[i] != slot) {
+        i++;
+    }
+    memmove(&order[i], &order[i + 1], total - i - 1);
+}
@@ -8,10 +8,17 @@
 #include "OperationMode.h"
 #include "IOInterface.h"
 #include "Clock.h"
+#include "Notifier.h"
+#include "SlotIndex.h"
+#include "Pool.h"
+
+static_assert(WATER_SOURCES_CAPACITY <= MAX_INDEXED_SLOTS && WATER_TANKS_CAPACITY <= MAX_INDEXED_SLOTS,
+              "The resources capacity must fit the slot index");
 
 const byte MAX_NAME_LENGTH = 20;
-const byte MAX_WATER_SOURCES = 5;
-const byte MAX_WATER_TANKS = 5;
+const byte MAX_WATER_SOURCES = WATER_SOURCES_CAPACITY;
+const byte MAX_WATER_TANKS = WATER_TANKS_CAPACITY;
+const unsigned int NO_HANDLE = 0;
 const unsigned int ERROR_INTERVAL = 10 * 1000;
 
 class Manager
@@ -20,46 +27,98 @@ class Manager
         Manager();
         ~Manager();
 
+        static void* operator new(size_t size) noexcept;
+        static void operator delete(void* pointer);
+        static Pool<Manager, 1> pool;
+
         OperationMode getOperationMode();
         void setOperationMode(OperationMode mode);
         WaterTank* getWaterTank(char* name);
+        WaterTank* getWaterTank(unsigned int handle);
         WaterSource* getWaterSource(char* name);
+        WaterSource* getWaterSource(unsigned int handle);
         char* getWaterSourceName(WaterSource* waterSource);
         char* getWaterTankName(WaterTank* waterTank);
-        char** getWaterSourceNames();
-        char** getWaterTankNames();
+        WaterTank* getWaterSourceOwner(WaterSource* waterSource);
+        unsigned int getWaterSourceHandle(char* name);
+        unsigned int getWaterTankHandle(char* name);
+        void getWaterSourceNames(char** list);
+        void getWaterTankNames(char** list);
         unsigned int getTotalWaterTanks();
         unsigned int getTotalWaterSources();
-        void setWaterSourceState(char* name, bool enabled);
-        void setWaterSourceState(char* name, bool enabled, bool force);
+        const Exception* getPendingError(char** waterTankName);
+        void setWaterSourceState(WaterSource* waterSource, bool enabled);
+        void setWaterSourceState(WaterSource* waterSource, bool enabled, bool force);
         void registerWaterSource(char* name, WaterSource* waterSource);
         void registerWaterTank(char* name, WaterTank* waterTank);
         bool isWaterSourceRegistered(char* name);
         bool isWaterTankRegistered(char* name);
-        bool isWaterSourceDependency(char* name);
-        bool isWaterTankDependency(char* name);
+        bool isWaterSourceDependency(WaterSource* waterSource);
+        bool isWaterTankDependency(WaterTank* waterTank);
         bool isIOInterfaceDependency(unsigned int pin);
         bool isIOInterfaceDependency(IOInterface* io);
-        WaterSource* unregisterWaterSource(char* name);
-        WaterTank* unregisterWaterTank(char* name);
-        void fillWaterTank(char* name, bool force);
-        void stopFillingWaterTank(char* name);
+        WaterSource* unregisterWaterSource(WaterSource* waterSource);
+        WaterTank* unregisterWaterTank(WaterTank* waterTank);
+        void fillWaterTank(WaterTank* waterTank, bool force);
+        void stopFillingWaterTank(WaterTank* waterTank);
+        void wakeUp();
         void loop();
 
     private:
+        //The resources are kept in slots, a handle is the slot + 1 so it stays the same while the resource is registered.
+        //The free slots are NULL, and the order arrays keep the registered slots in the registration order.
+        //A resource is only registered after its dependency, and a dependency cannot be unregistered, so the dependency
+        //graph has no cycles and the registration order is kept as its topological order, upstream first
         WaterTank* waterTanks[MAX_WATER_TANKS];
-        char* waterTankNames[MAX_WATER_TANKS];
+        char waterTankNames[MAX_WATER_TANKS][MAX_NAME_LENGTH + 1];
+        byte waterTankOrder[MAX_WATER_TANKS];
         WaterSource* waterSources[MAX_WATER_SOURCES];
-        char* waterSourceNames[MAX_WATER_SOURCES];
+        char waterSourceNames[MAX_WATER_SOURCES][MAX_NAME_LENGTH + 1];
+        byte waterSourceOrder[MAX_WATER_SOURCES];
+        //The resources are found by their names and pointers through the indexes, without scanning the slots
+        byte waterTankNamesTable[slotIndexSize(MAX_WATER_TANKS)];
+        byte waterTanksTable[slotIndexSize(MAX_WATER_TANKS)];
+        byte waterSourceNamesTable[slotIndexSize(MAX_WATER_SOURCES)];
+        byte waterSourcesTable[slotIndexSize(MAX_WATER_SOURCES)];
+        SlotIndex waterTankNamesIndex;
+        SlotIndex waterTanksIndex;
+        SlotIndex waterSourceNamesIndex;
+        SlotIndex waterSourcesIndex;
+        //Amount of registered resources depending on each slot
+        byte waterTankDependents[MAX_WATER_TANKS];
+        byte waterSourceDependents[MAX_WATER_SOURCES];
         OperationMode mode = MANUAL;
         unsigned int totalWaterTanks = 0;
         unsigned int totalWaterSources = 0;
-        Clock* waterTanksErrorsTimer;
+        unsigned long waterTanksErrorsTime;
         int waterTankErrorIndex = 0;
         const Exception* waterTanksLoopErrors[MAX_WATER_TANKS];
+        float waterTanksNotifiedVolumes[MAX_WATER_TANKS];
+        unsigned long waterTanksNotificationTimes[MAX_WATER_TANKS];
+        //The registered slots ordered by their deadlines, only the water tanks whose deadline has arrived are run
+        byte waterTankSchedule[MAX_WATER_TANKS];
+        unsigned long waterTanksDeadlines[MAX_WATER_TANKS];
+        unsigned long lastLoopTime;
+        //In auto mode each water source is turned on and off by the manager only. It fills a single owner at a time,
+        //the one with the highest priority when it is free, and it is kept on while a dependent water tank demands it
+        byte waterSourceOwners[MAX_WATER_SOURCES];
+        bool waterSourcesArbitrationPending[MAX_WATER_SOURCES];
+        unsigned long waterTanksDemandTimes[MAX_WATER_TANKS];
+        bool waterTanksWaiting[MAX_WATER_TANKS];
+
+        void notifyVolumeChanges(unsigned long currentTime);
+        void scheduleWaterTank(byte slot, unsigned long deadline, unsigned int totalScheduled);
+        void scheduleWaterTanks(unsigned long deadline);
+        void arbitrateWaterSource(byte slot, unsigned long currentTime);
 
-        int getWaterTankIndex(char* name);
-        int getWaterSourceIndex(char* name);
+        int getWaterTankSlot(char* name);
+        int getWaterTankSlot(WaterTank* waterTank);
+        int getWaterTankSlot(unsigned int handle);
+        int getWaterSourceSlot(char* name);
+        int getWaterSourceSlot(WaterSource* waterSource);
+        int getWaterSourceSlot(unsigned int handle);
+        bool copyName(char* resourceName, char* name);
+        void removeOrder(byte* order, unsigned int total, byte slot);
 };
 
 #endif
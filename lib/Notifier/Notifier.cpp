@@ -0,0 +1,93 @@
+#include "Notifier.h"
+
+bool Notifier::subscribed = false;
+unsigned long Notifier::minimumInterval = DEFAULT_NOTIFICATIONS_INTERVAL;
+float Notifier::volumeDeadband = DEFAULT_VOLUME_DEADBAND;
+Notification Notifier::notifications[MAX_PENDING_NOTIFICATIONS] = {};
+byte Notifier::totalNotifications = 0;
+bool Notifier::overflowed = false;
+unsigned int Notifier::droppedNotifications = 0;
+
+void Notifier::subscribe(unsigned long minimumInterval, float volumeDeadband) {
+    Notifier::subscribed = true;
+    Notifier::minimumInterval = minimumInterval;
+    Notifier::volumeDeadband = volumeDeadband > 0 ? volumeDeadband : DEFAULT_VOLUME_DEADBAND;
+}
+
+void Notifier::unsubscribe() {
+    Notifier::subscribed = false;
+    Notifier::totalNotifications = 0;
+    Notifier::overflowed = false;
+}
+
+bool Notifier::isSubscribed() {
+    return Notifier::subscribed;
+}
+
+unsigned long Notifier::getMinimumInterval() {
+    return Notifier::minimumInterval;
+}
+
+float Notifier::getVolumeDeadband() {
+    return Notifier::volumeDeadband;
+}
+
+void Notifier::notify(EventType type, void* resource, float value) {
+    if (!Notifier::subscribed) {
+        return;
+    }
+    for (byte i = 0; i < Notifier::totalNotifications; i++) {
+        if (Notifier::notifications[i].type == type && Notifier::notifications[i].resource == resource) {
+            Notifier::notifications[i].value = value;
+            return;
+        }
+    }
+    if (Notifier::totalNotifications == MAX_PENDING_NOTIFICATIONS) {
+        //The client reads the whole state after the resync event, so the pending changes are not needed anymore
+        Notifier::droppedNotifications += Notifier::totalNotifications + 1;
+        Notifier::totalNotifications = 0;
+        Notifier::overflowed = true;
+        return;
+    }
+    Notifier::notifications[Notifier::totalNotifications].type = type;
+    Notifier::notifications[Notifier::totalNotifications].resource = resource;
+    Notifier::notifications[Notifier::totalNotifications].value = value;
+    Notifier::totalNotifications += 1;
+}
+
+void Notifier::discard(void* resource) {
+    //The resource is being deleted, its events can't be sent anymore
+    byte j = 0;
+    for (byte i = 0; i < Notifier::totalNotifications; i++) {
+        if (Notifier::notifications[i].resource != resource) {
+            Notifier::notifications[j] = Notifier::notifications[i];
+            j += 1;
+        }
+    }
+    Notifier::totalNotifications = j;
+}
+
+bool Notifier::hasNotification() {
+    return Notifier::totalNotifications > 0;
+}
+
+Notification Notifier::popNotification() {
+    Notification notification = Notifier::notifications[0];
+    for (byte i = 1; i < Notifier::totalNotifications; i++) {
+        Notifier::notifications[i - 1] = Notifier::notifications[i];
+    }
+    Notifier::totalNotifications -= 1;
+    return notification;
+}
+
+bool Notifier::hasOverflowed() {
+    return Notifier::overflowed;
+}
+
+void Notifier::clearOverflow() {
+    Notifier::overflowed = false;
+}
+
+unsigned int Notifier::getDroppedNotifications() {
+    return Notifier::droppedNotifications;
+}
@@ -0,0 +1,52 @@
+#ifndef NOTIFIER_H
+#define NOTIFIER_H
+
+#include <Arduino.h>
+
+const byte MAX_PENDING_NOTIFICATIONS = 8;
+const unsigned long DEFAULT_NOTIFICATIONS_INTERVAL = 1000; //Miliseconds
+const float DEFAULT_VOLUME_DEADBAND = 1;
+
+enum EventType {
+    WATER_SOURCE_STATE_CHANGED, WATER_TANK_ACTIVE_CHANGED, OPERATION_MODE_CHANGED, WATER_TANK_VOLUME_CHANGED
+};
+
+struct Notification {
+    EventType type;
+    void* resource;
+    float value;
+};
+
+/*
+The Notifier keeps the changes that must be pushed to the subscribed client. The resources raise the events
+and the firmware sends them in the next loop. Events of the same resource are coalesced, so only the last
+state is sent when the client can't keep up. When there are more changed states than pending notifications,
+the pending ones are dropped and a resync event is sent instead, so the client reads the whole state again.
+*/
+class Notifier
+{
+    public:
+        static void subscribe(unsigned long minimumInterval, float volumeDeadband);
+        static void unsubscribe();
+        static bool isSubscribed();
+        static unsigned long getMinimumInterval();
+        static float getVolumeDeadband();
+        static void notify(EventType type, void* resource, float value);
+        static void discard(void* resource);
+        static bool hasNotification();
+        static Notification popNotification();
+        static bool hasOverflowed();
+        static void clearOverflow();
+        static unsigned int getDroppedNotifications();
+
+    private:
+        static bool subscribed;
+        static unsigned long minimumInterval;
+        static float volumeDeadband;
+        static Notification notifications[MAX_PENDING_NOTIFICATIONS];
+        static byte totalNotifications;
+        static bool overflowed;
+        static unsigned int droppedNotifications;
+};
+
+#endif
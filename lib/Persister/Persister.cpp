@@ -3,9 +3,23 @@
 #include <EEPROM.h>
 
 byte Persister::getTotalRequests() {
+    //The requests saved with another layout are not replayed
+    if (!Persister::isLayoutCurrent()) {
+        return 0;
+    }
     return EEPROM.read(Persister::TOTAL_REQUESTS_OFFSET);
 }
 
+bool Persister::isLayoutCurrent() {
+    return EEPROM.read(Persister::LAYOUT_VERSION_OFFSET) == Persister::LAYOUT_VERSION &&
+           EEPROM.read(Persister::LENGTH_TABLE_SIZE_OFFSET) == Persister::MAX_REQUESTS;
+}
+
+void Persister::saveLayout() {
+    EEPROM.update(Persister::LAYOUT_VERSION_OFFSET, Persister::LAYOUT_VERSION);
+    EEPROM.update(Persister::LENGTH_TABLE_SIZE_OFFSET, Persister::MAX_REQUESTS);
+}
+
 Request Persister::readRequest(byte index) {
     Request request = Request_init_zero;
     byte requestBuffer[Request_size];
@@ -31,11 +45,13 @@ void Persister::save(API* api) {
     unsigned int totalWaterSources = api->getTotalWaterSources();
     unsigned int totalWaterTanks = api->getTotalWaterTanks();
 
-    char** waterSourceNames = api->getWaterSourceList();
-    char** waterTankNames = api->getWaterTankList();
+    char* waterSourceNames[MAX_WATER_SOURCES];
+    char* waterTankNames[MAX_WATER_TANKS];
+    api->getWaterSourceList(waterSourceNames);
+    api->getWaterTankList(waterTankNames);
     
-    WaterSource** waterSources = new WaterSource*[totalWaterSources];
-    WaterTank** waterTanks = new WaterTank*[totalWaterTanks];
+    WaterSource* waterSources[MAX_WATER_SOURCES];
+    WaterTank* waterTanks[MAX_WATER_TANKS];
     
     unsigned int i, j = 0;
     for(i = 0; i < totalWaterSources; i++) {
@@ -46,8 +62,8 @@ void Persister::save(API* api) {
     }
 
     //Calculating weights
-    byte* waterSourceWeights = new byte[totalWaterSources] {};
-    byte* waterTankWeights = new byte[totalWaterTanks] {};
+    byte waterSourceWeights[MAX_WATER_SOURCES] = {};
+    byte waterTankWeights[MAX_WATER_TANKS] = {};
 
     for (i = 0; i < totalWaterSources; i++) {
         waterSourceWeights[i] = Persister::calculateWaterSourceDependencyWeight(waterSources[i], waterSources, waterTanks, 
@@ -107,9 +123,12 @@ void Persister::save(API* api) {
 
     //Creating requests
 
+    //The requests are replayed in a new API, so the i-th water source created gets the handle i + 1.
+    //The references are saved by these handles instead of the names to reduce the requests size
     Request request = {};
 
     byte totalRequests = 0;
+    unsigned int handle;
 
     i = 0;
     j = 0;
@@ -131,8 +150,8 @@ void Persister::save(API* api) {
             request.message.createWaterSource.pin = waterSource->getPin();
             strncpy(request.message.createWaterSource.name, name, MAX_NAME_LENGTH);
             if (waterSource->getWaterTank() != NULL) {
-                request.message.createWaterSource.has_waterTankName = true;
-                strncpy(request.message.createWaterSource.waterTankName, api->getWaterTankName(waterSource->getWaterTank()), MAX_NAME_LENGTH);
+                for (handle = 1; waterTanks[handle - 1] != waterSource->getWaterTank(); handle++);
+                request.message.createWaterSource.waterTankHandle = handle;
             }
             
             Persister::writeRequest(&request, totalRequests);
@@ -144,7 +163,7 @@ void Persister::save(API* api) {
             if (!waterSource->isActive()) {
                 request = {};
                 request.which_message = Request_setWaterSourceActive_tag;
-                strncpy(request.message.setWaterSourceActive.waterSourceName, name, MAX_NAME_LENGTH);
+                request.message.setWaterSourceActive.waterSourceHandle = i + 1;
                 request.message.setWaterSourceActive.active = false;
                 Persister::writeRequest(&request, totalRequests);
                 if (Exception::hasException()) {
@@ -160,12 +179,12 @@ void Persister::save(API* api) {
             request = {};
             request.which_message = Request_createWaterTank_tag;
             request.message.createWaterTank.pressureSensorPin = waterTank->getPressureSensorPin();
-            request.message.createWaterTank.pressureFactor = waterTank->pressureFactor;
-            request.message.createWaterTank.volumeFactor = waterTank->volumeFactor;
+            request.message.createWaterTank.pressureFactor = waterTank->getPressureFactor();
+            request.message.createWaterTank.volumeFactor = waterTank->getVolumeFactor();
             strncpy(request.message.createWaterTank.name, name, MAX_NAME_LENGTH);
-            if (waterSource->getWaterTank() != NULL) {
-                request.message.createWaterTank.has_waterSourceName = true;
-                strncpy(request.message.createWaterTank.waterSourceName, api->getWaterSourceName(waterTank->getWaterSource()), MAX_NAME_LENGTH);
+            if (waterTank->getWaterSource() != NULL) {
+                for (handle = 1; waterSources[handle - 1] != waterTank->getWaterSource(); handle++);
+                request.message.createWaterTank.waterSourceHandle = handle;
             }
             Persister::writeRequest(&request, totalRequests);
             if (Exception::hasException()) {
@@ -176,7 +195,7 @@ void Persister::save(API* api) {
             if (!waterTank->isActive()) {
                 request = {};
                 request.which_message = Request_setWaterTankActive_tag;
-                strncpy(request.message.setWaterTankActive.waterTankName, name, MAX_NAME_LENGTH);
+                request.message.setWaterTankActive.waterTankHandle = j + 1;
                 request.message.setWaterTankActive.active = false;
                 Persister::writeRequest(&request, totalRequests);
                 if (Exception::hasException()) {
@@ -185,19 +204,69 @@ void Persister::save(API* api) {
                 totalRequests += 1;
             }
 
-            j += 1;
-        }
-    }
+            if (waterTank->getFilterType() != NO_FILTER || waterTank->getOversampling() != 1) {
+                request = {};
+                request.which_message = Request_setWaterTankFilter_tag;
+                request.message.setWaterTankFilter.waterTankHandle = j + 1;
+                request.message.setWaterTankFilter.type = (SetWaterTankFilter_FilterType) waterTank->getFilterType();
+                request.message.setWaterTankFilter.window = waterTank->getFilterWindow();
+                request.message.setWaterTankFilter.oversampling = waterTank->getOversampling();
+                Persister::writeRequest(&request, totalRequests);
+                if (Exception::hasException()) {
+                    break;
+                }
+                totalRequests += 1;
+            }
 
-    free(waterSourceNames);
-    free(waterTankNames);
+            CalibrationTable* calibration = waterTank->getCalibration();
+            if (calibration != NULL) {
+                request = {};
+                request.which_message = Request_setWaterTankCalibration_tag;
+                request.message.setWaterTankCalibration.waterTankHandle = j + 1;
+                request.message.setWaterTankCalibration.rawValues_count = calibration->getTotalPoints();
+                request.message.setWaterTankCalibration.volumes_count = calibration->getTotalPoints();
+                for (byte k = 0; k < calibration->getTotalPoints(); k++) {
+                    request.message.setWaterTankCalibration.rawValues[k] = calibration->getRawValue(k);
+                    request.message.setWaterTankCalibration.volumes[k] = calibration->getVolume(k);
+                }
+                Persister::writeRequest(&request, totalRequests);
+                if (Exception::hasException()) {
+                    break;
+                }
+                totalRequests += 1;
+            }
 
-    delete[] waterSourceWeights;
-    delete[] waterTankWeights;
+            if (waterTank->getControlMode() != BANG_BANG_CONTROL || waterTank->getLowerBand() != 0 || waterTank->getUpperBand() != 0) {
+                request = {};
+                request.which_message = Request_setWaterTankControl_tag;
+                request.message.setWaterTankControl.waterTankHandle = j + 1;
+                request.message.setWaterTankControl.mode = (SetWaterTankControl_ControlMode) waterTank->getControlMode();
+                request.message.setWaterTankControl.lowerBand = waterTank->getLowerBand();
+                request.message.setWaterTankControl.upperBand = waterTank->getUpperBand();
+                Persister::writeRequest(&request, totalRequests);
+                if (Exception::hasException()) {
+                    break;
+                }
+                totalRequests += 1;
+            }
+
+            if (waterTank->getPriorityWeight() != 1) {
+                request = {};
+                request.which_message = Request_setWaterTankPriority_tag;
+                request.message.setWaterTankPriority.waterTankHandle = j + 1;
+                request.message.setWaterTankPriority.weight = waterTank->getPriorityWeight();
+                Persister::writeRequest(&request, totalRequests);
+                if (Exception::hasException()) {
+                    break;
+                }
+                totalRequests += 1;
+            }
 
-    delete[] waterSources;
-    delete[] waterTanks;
+            j += 1;
+        }
+    }
 
+    Persister::saveLayout();
     Persister::setTotalRequests(totalRequests);
     Persister::updateCRC();
 }
@@ -246,10 +315,12 @@ void Persister::writeRequest(Request* request, byte index) {
     
     requestStream = pb_ostream_from_buffer(requestBuffer, Request_size);
 
-    if(pb_encode(&requestStream, Request_fields, request)) {
+    unsigned int offset = Persister::getRequestOffset(index);
+    //The requests cannot overwrite the serial settings at the end of the EEPROM, and their lengths must fit a byte
+    if(pb_encode(&requestStream, Request_fields, request) && requestStream.bytes_written <= 0xFF &&
+       offset + requestStream.bytes_written <= Persister::getBaudRateOffset()) {
         EEPROM.update(LENGTH_TABLE_OFFSET + index, (byte) requestStream.bytes_written);
 
-        unsigned int offset = Persister::getRequestOffset(index);
         for (unsigned int i = 0; i < requestStream.bytes_written; i++) {
             EEPROM.update(offset + i, requestBuffer[i]);
         }
@@ -266,6 +337,24 @@ void Persister::clearEEPROM() {
     setTotalRequests(0);
 }
 
+unsigned long Persister::getBaudRate() {
+    //A baud rate that was never saved or is corrupted does not match its complement, it is read as 0
+    unsigned long baudRate = 0;
+    unsigned long complement = 0;
+    EEPROM.get(Persister::getBaudRateOffset(), baudRate);
+    EEPROM.get(Persister::getBaudRateOffset() + sizeof(unsigned long), complement);
+    return baudRate == ~complement ? baudRate : 0;
+}
+
+void Persister::saveBaudRate(unsigned long baudRate) {
+    EEPROM.put(Persister::getBaudRateOffset(), baudRate);
+    EEPROM.put(Persister::getBaudRateOffset() + sizeof(unsigned long), ~baudRate);
+}
+
+unsigned int Persister::getBaudRateOffset() {
+    return EEPROM.length() - Persister::BAUD_RATE_SIZE;
+}
+
 void Persister::updateCRC() {
     unsigned long crc = calculateCRC();
     EEPROM.put(CRC_OFFSET, crc);
@@ -19,13 +19,22 @@ using the same protobuf protocol used by Requests. See the format:
 START EEPROM ADDRESS: 0x0000
 DESCRIPTION                 |   OFFSET  |   Data Type   |   Data length (bytes)   |
 
-Amount of requests          |   0       |   byte        |   1
-EEPROM CRC                  |   1       |   ulong       |   4
-Length Table                |   5       |   byte array  |   MAX_REQUESTS (20)    |
-Request 1 Length            |   5       |   byte        |   2
+Layout version              |   0       |   byte        |   1
+Length Table size           |   1       |   byte        |   1
+Amount of requests          |   2       |   byte        |   1
+EEPROM CRC                  |   3       |   ulong       |   4
+Length Table                |   7       |   byte array  |   MAX_REQUESTS (40 by default)    |
+Request 1 Length            |   7       |   byte        |   1
 ...
-Request 1                   |   25     |   byte        |   Variable length
+Request 1                   |   47     |   byte        |   Variable length
 ...
+
+The requests are only loaded when the layout version and the Length Table size match the firmware ones,
+the offsets of the requests saved by another firmware are not the same.
+
+The serial settings are kept at the end of the EEPROM, apart from the requests:
+Baud rate                   |   EEPROM length - 8   |   ulong   |   4
+Baud rate complement        |   EEPROM length - 4   |   ulong   |   4
 */
 
 class Persister
@@ -36,17 +45,31 @@ class Persister
         static Request readRequest(byte index);
         static void save(API* api);
         static void clearEEPROM();
+        static unsigned long getBaudRate();
+        static void saveBaudRate(unsigned long baudRate);
 
     private:
-        //We need 2 requests to create a water tank/water source fully (create and setActive requests).
-        static const byte MAX_REQUESTS = (MAX_WATER_TANKS * 2) + (MAX_WATER_SOURCES * 2);
+        //We need 2 requests to create a water source fully (create and setActive requests), and a water tank
+        //also needs the setWaterTankFilter, setWaterTankCalibration, setWaterTankControl and setWaterTankPriority requests.
+        static const byte MAX_REQUESTS = (MAX_WATER_TANKS * 6) + (MAX_WATER_SOURCES * 2);
+        static_assert((WATER_TANKS_CAPACITY * 6) + (WATER_SOURCES_CAPACITY * 2) <= 0xFF, "The amount of requests must fit a byte");
 
-        static const unsigned int TOTAL_REQUESTS_OFFSET = 0;
+        //It must be increased when the layout changes, the Length Table size is checked apart
+        static const byte LAYOUT_VERSION = 1;
+
+        static const unsigned int LAYOUT_VERSION_OFFSET = 0;
+        static const unsigned int LENGTH_TABLE_SIZE_OFFSET = LAYOUT_VERSION_OFFSET + sizeof(byte);
+        static const unsigned int TOTAL_REQUESTS_OFFSET = LENGTH_TABLE_SIZE_OFFSET + sizeof(byte);
         static const unsigned int CRC_OFFSET = TOTAL_REQUESTS_OFFSET + sizeof(byte);
         static const unsigned int LENGTH_TABLE_OFFSET = CRC_OFFSET + sizeof(unsigned long);
         static const unsigned int REQUESTS_START_OFFSET = LENGTH_TABLE_OFFSET + (MAX_REQUESTS * sizeof(byte));
 
+        static const unsigned int BAUD_RATE_SIZE = 2 * sizeof(unsigned long);
+
         static unsigned long calculateCRC();
+        static bool isLayoutCurrent();
+        static void saveLayout();
+        static unsigned int getBaudRateOffset();
         static void readEPPROM(byte* dest, unsigned int offset, unsigned int size);
         static void writeRequest(Request* request, byte index);
         static byte getRequestLength(byte index);
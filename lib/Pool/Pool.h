@@ -0,0 +1,67 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <Arduino.h>
+
+/*
+A fixed capacity storage for the objects of a class, so they are not allocated in the heap. The free blocks
+are chained by their indexes, so allocating and releasing a block takes constant time. A class uses its pool by
+overloading its operators new and delete:
+
+static void* operator new(size_t size) noexcept { return pool.allocate(); }
+static void operator delete(void* pointer) { pool.release(pointer); }
+
+The new expression returns NULL when the pool is full.
+*/
+template <typename T, byte N>
+class Pool
+{
+    public:
+        Pool() {
+            for (byte i = 0; i < N; i++) {
+                this->nextFree[i] = i + 1;
+            }
+        }
+
+        void* allocate() {
+            if (this->firstFree == N) {
+                return NULL;
+            }
+            byte index = this->firstFree;
+            this->firstFree = this->nextFree[index];
+            this->used += 1;
+            this->maxUsed = max(this->maxUsed, this->used);
+            return this->blocks[index];
+        }
+
+        void release(void* pointer) {
+            if (pointer == NULL) {
+                return;
+            }
+            byte index = ((byte*) pointer - this->blocks[0]) / sizeof(T);
+            this->nextFree[index] = this->firstFree;
+            this->firstFree = index;
+            this->used -= 1;
+        }
+
+        byte getUsed() {
+            return this->used;
+        }
+
+        byte getMaxUsed() {
+            return this->maxUsed;
+        }
+
+        byte getCapacity() {
+            return N;
+        }
+
+    private:
+        alignas(T) byte blocks[N][sizeof(T)];
+        byte nextFree[N];
+        byte firstFree = 0;
+        byte used = 0;
+        byte maxUsed = 0;
+};
+
+#endif
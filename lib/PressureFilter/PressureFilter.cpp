@@ -0,0 +1,85 @@
+#include "PressureFilter.h"
+
+const byte EMA_FRACTION_BITS = 6;
+
+PressureFilter::PressureFilter() : values() {
+
+}
+
+void PressureFilter::setFilter(FilterType type, byte window) {
+    this->type = type;
+    this->window = window;
+    this->clear();
+}
+
+FilterType PressureFilter::getType() {
+    return this->type;
+}
+
+byte PressureFilter::getWindow() {
+    return this->window;
+}
+
+void PressureFilter::push(unsigned int value) {
+    long fixedValue = (long) value << EMA_FRACTION_BITS;
+    if (this->totalValues == 0) {
+        this->average = fixedValue;
+    } else {
+        this->average += (fixedValue - this->average) / this->window;
+    }
+
+    this->values[this->head] = value;
+    this->head = (this->head + 1) % this->window;
+    this->totalValues = min(this->totalValues + 1, this->window);
+}
+
+unsigned int PressureFilter::getValue() {
+    if (this->totalValues == 0) {
+        return 0;
+    } else if (this->type == MOVING_AVERAGE_FILTER) {
+        return this->getMovingAverage();
+    } else if (this->type == MEDIAN_FILTER) {
+        return this->getMedian();
+    } else if (this->type == EMA_FILTER) {
+        return (this->average + (1 << (EMA_FRACTION_BITS - 1))) >> EMA_FRACTION_BITS;
+    }
+    //Without a filter the last value is used
+    return this->values[(this->head + this->window - 1) % this->window];
+}
+
+bool PressureFilter::isEmpty() {
+    return this->totalValues == 0;
+}
+
+void PressureFilter::clear() {
+    this->head = 0;
+    this->totalValues = 0;
+    this->average = 0;
+}
+
+unsigned int PressureFilter::getMovingAverage() {
+    unsigned long sum = 0;
+    for (byte i = 0; i < this->totalValues; i++) {
+        sum += this->values[i];
+    }
+    return (sum + this->totalValues / 2) / this->totalValues;
+}
+
+unsigned int PressureFilter::getMedian() {
+    //The window is small, an insertion sort of a copy is enough
+    unsigned int sorted[MAX_FILTER_WINDOW];
+    for (byte i = 0; i < this->totalValues; i++) {
+        unsigned int value = this->values[i];
+        byte j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+    byte middle = this->totalValues / 2;
+    if (this->totalValues % 2 == 0) {
+        return ((unsigned long) sorted[middle - 1] + sorted[middle] + 1) / 2;
+    }
+    return sorted[middle];
+}
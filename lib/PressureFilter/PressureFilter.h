@@ -0,0 +1,45 @@
+#ifndef PRESSURE_FILTER_H
+#define PRESSURE_FILTER_H
+
+#include <Arduino.h>
+
+//The filter types have the same values of the SetWaterTankFilter request
+enum FilterType {
+    NO_FILTER, MOVING_AVERAGE_FILTER, MEDIAN_FILTER, EMA_FILTER
+};
+
+const byte MAX_FILTER_WINDOW = 8;
+//The sum of the oversampled raw values must fit an unsigned int
+const byte MAX_OVERSAMPLING = 16;
+
+/*
+Filters the raw values of a pressure sensor in integer arithmetic. The last window values are kept in a fixed
+ring: the moving average and the median filters are taken from it. The EMA filter keeps a fixed point average,
+each new value is weighted 1 / window.
+*/
+class PressureFilter
+{
+    public:
+        PressureFilter();
+
+        void setFilter(FilterType type, byte window);
+        FilterType getType();
+        byte getWindow();
+        void push(unsigned int value);
+        unsigned int getValue();
+        bool isEmpty();
+        void clear();
+
+    private:
+        FilterType type = NO_FILTER;
+        byte window = 1;
+        unsigned int values[MAX_FILTER_WINDOW];
+        byte head = 0;
+        byte totalValues = 0;
+        long average = 0;
+
+        unsigned int getMovingAverage();
+        unsigned int getMedian();
+};
+
+#endif
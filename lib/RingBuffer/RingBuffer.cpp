@@ -0,0 +1,60 @@
+#include "RingBuffer.h"
+
+RingBuffer::RingBuffer(unsigned int capacity) {
+    this->buffer = new byte[capacity];
+    this->capacity = capacity;
+}
+
+RingBuffer::~RingBuffer() {
+    delete[] this->buffer;
+}
+
+bool RingBuffer::write(byte value) {
+    if (this->isFull()) {
+        return false;
+    }
+    this->buffer[(this->head + this->total) % this->capacity] = value;
+    this->total += 1;
+    return true;
+}
+
+byte RingBuffer::read() {
+    if (this->total == 0) {
+        return 0;
+    }
+    byte value = this->buffer[this->head];
+    this->head = (this->head + 1) % this->capacity;
+    this->total -= 1;
+    return value;
+}
+
+byte RingBuffer::peek(unsigned int offset) {
+    if (offset >= this->total) {
+        return 0;
+    }
+    return this->buffer[(this->head + offset) % this->capacity];
+}
+
+unsigned int RingBuffer::available() {
+    return this->total;
+}
+
+unsigned int RingBuffer::getCapacity() {
+    return this->capacity;
+}
+
+bool RingBuffer::isFull() {
+    return this->total == this->capacity;
+}
+
+void RingBuffer::truncate(unsigned int length) {
+    //Drops the newest bytes, only the first length bytes are kept
+    if (length < this->total) {
+        this->total = length;
+    }
+}
+
+void RingBuffer::clear() {
+    this->head = 0;
+    this->total = 0;
+}
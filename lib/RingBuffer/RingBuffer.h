@@ -0,0 +1,32 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <Arduino.h>
+
+/*
+A fixed-size FIFO of bytes. The bytes received from the serial port are queued in it, so several frames
+can wait to be handled while the next ones are still arriving.
+*/
+class RingBuffer
+{
+    public:
+        RingBuffer(unsigned int capacity);
+        ~RingBuffer();
+
+        bool write(byte value);
+        byte read();
+        byte peek(unsigned int offset);
+        unsigned int available();
+        unsigned int getCapacity();
+        bool isFull();
+        void truncate(unsigned int length);
+        void clear();
+
+    private:
+        byte* buffer;
+        unsigned int capacity;
+        unsigned int head = 0;
+        unsigned int total = 0;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "SlotIndex.h"
+
+SlotIndex::SlotIndex(byte* table, unsigned int size) {
+    this->table = table;
+    this->size = size;
+    memset(this->table, EMPTY_SLOT, this->size);
+}
+
+void SlotIndex::insert(unsigned int hash, byte slot) {
+    unsigned int position = hash & (this->size - 1);
+    while (this->table[position] != EMPTY_SLOT && this->table[position] != DELETED_SLOT) {
+        position = (position + 1) & (this->size - 1);
+    }
+    this->table[position] = slot;
+}
+
+void SlotIndex::remove(unsigned int hash, byte slot) {
+    unsigned int position = hash & (this->size - 1);
+    for (unsigned int i = 0; i < this->size && this->table[position] != EMPTY_SLOT; i++) {
+        if (this->table[position] == slot) {
+            this->table[position] = DELETED_SLOT;
+            break;
+        }
+        position = (position + 1) & (this->size - 1);
+    }
+    //The deleted entries at the end of a probe sequence are not needed to reach any other slot
+    while (this->table[position] == DELETED_SLOT && this->table[(position + 1) & (this->size - 1)] == EMPTY_SLOT) {
+        this->table[position] = EMPTY_SLOT;
+        position = (position - 1) & (this->size - 1);
+    }
+}
+
+byte SlotIndex::first(unsigned int hash, unsigned int* position) {
+    this->probes = 0;
+    *position = (hash - 1) & (this->size - 1);
+    return this->next(position);
+}
+
+byte SlotIndex::next(unsigned int* position) {
+    while (this->probes < this->size) {
+        this->probes += 1;
+        *position = (*position + 1) & (this->size - 1);
+        byte slot = this->table[*position];
+        if (slot == EMPTY_SLOT) {
+            break;
+        } else if (slot != DELETED_SLOT) {
+            return slot;
+        }
+    }
+    return EMPTY_SLOT;
+}
+
+unsigned int SlotIndex::hash(const char* name, byte maxLength) {
+    //FNV-1a
+    unsigned long hash = 2166136261UL;
+    for (byte i = 0; i < maxLength && name[i] != '\0'; i++) {
+        hash = (hash ^ (byte) name[i]) * 16777619UL;
+    }
+    return (unsigned int) (hash ^ (hash >> 16));
+}
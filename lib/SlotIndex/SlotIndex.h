@@ -0,0 +1,47 @@
+#ifndef SLOT_INDEX_H
+#define SLOT_INDEX_H
+
+#include <Arduino.h>
+
+const byte EMPTY_SLOT = 0xFF;
+const byte DELETED_SLOT = 0xFE;
+const byte MAX_INDEXED_SLOTS = DELETED_SLOT;
+
+//The table size is a power of two at least twice the max of slots, so the probe sequences stay short
+constexpr unsigned int slotIndexSize(byte maxSlots, unsigned int size = 1) {
+    return size >= 2 * (unsigned int) maxSlots ? size : slotIndexSize(maxSlots, size << 1);
+}
+
+/*
+An open addressing hash table from a key to the slot of a resource, so a resource is found in constant time.
+The keys are not stored: the table returns the slots whose key has the same hash and the caller compares the
+key of each slot, so the same index works for the resources names and pointers. The table is owned by the
+caller, sized by slotIndexSize(). A lookup goes through the slots with the same hash with:
+
+for (byte slot = index->first(hash, &position); slot != EMPTY_SLOT; slot = index->next(&position))
+*/
+class SlotIndex
+{
+    public:
+        SlotIndex(byte* table, unsigned int size);
+
+        void insert(unsigned int hash, byte slot);
+        void remove(unsigned int hash, byte slot);
+        byte first(unsigned int hash, unsigned int* position);
+        byte next(unsigned int* position);
+
+        static unsigned int hash(const char* name, byte maxLength);
+        //The resources come from pools, so their addresses are spaced by the size of the resource. The address is
+        //divided by it, and the odd multiplier keeps the consecutive objects of a pool apart in the low bits
+        template <typename T>
+        static unsigned int hash(const T* pointer) {
+            return (unsigned int) (((uintptr_t) pointer / sizeof(T)) * 40503UL);
+        }
+
+    private:
+        byte* table;
+        unsigned int size;
+        unsigned int probes = 0;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "TxQueue.h"
+
+TxQueue::TxQueue(Print* output, unsigned int replyCapacity, unsigned int eventCapacity, byte maxFrames) {
+    this->output = output;
+    this->buffers[REPLY_PRIORITY] = new RingBuffer(replyCapacity);
+    this->buffers[EVENT_PRIORITY] = new RingBuffer(eventCapacity);
+    for (byte i = 0; i < TOTAL_TX_PRIORITIES; i++) {
+        this->frameSizes[i] = new RingBuffer(maxFrames * sizeof(uint16_t));
+    }
+}
+
+TxQueue::~TxQueue() {
+    for (byte i = 0; i < TOTAL_TX_PRIORITIES; i++) {
+        delete this->buffers[i];
+        delete this->frameSizes[i];
+    }
+}
+
+void TxQueue::beginFrame(TxPriority priority) {
+    this->openPriority = priority;
+    this->openFrameSize = 0;
+    this->openFrameDropped = false;
+    this->openFrameStreamed = false;
+}
+
+size_t TxQueue::write(uint8_t value) {
+    if (this->openFrameDropped) {
+        return 1;
+    }
+    RingBuffer* buffer = this->buffers[this->openPriority];
+    if (buffer->isFull()) {
+        if (this->openPriority == EVENT_PRIORITY) {
+            this->dropOpenFrame();
+            return 1;
+        }
+        this->stream();
+    }
+    buffer->write(value);
+    this->openFrameSize += 1;
+    return 1;
+}
+
+bool TxQueue::endFrame() {
+    if (!this->openFrameDropped && this->frameSizes[this->openPriority]->isFull()) {
+        if (this->openPriority == EVENT_PRIORITY) {
+            this->dropOpenFrame();
+        } else {
+            this->stream();
+        }
+    }
+    if (this->openFrameDropped) {
+        this->droppedFrames += 1;
+        return false;
+    }
+
+    this->totalFrames[this->openPriority] += 1;
+    if (this->openFrameStreamed) {
+        //The start of the frame has already been sent, so its end can't wait behind another frame
+        while (this->openFrameSize > 0) {
+            this->output->write(this->buffers[this->openPriority]->read());
+            this->openFrameSize -= 1;
+        }
+        this->totalSentFrames[this->openPriority] += 1;
+        this->openFrameStreamed = false;
+    } else if (this->openFrameSize == 0) {
+        this->totalSentFrames[this->openPriority] += 1;
+    } else {
+        RingBuffer* frameSizes = this->frameSizes[this->openPriority];
+        frameSizes->write(this->openFrameSize & 0xFF);
+        frameSizes->write(this->openFrameSize >> 8);
+    }
+    this->openFrameSize = 0;
+    return true;
+}
+
+bool TxQueue::canQueue(TxPriority priority, unsigned int frameSize) {
+    RingBuffer* buffer = this->buffers[priority];
+    return !this->frameSizes[priority]->isFull() && buffer->getCapacity() - buffer->available() >= frameSize;
+}
+
+void TxQueue::send(unsigned int maxBytes) {
+    while (maxBytes > 0 && this->sendByte()) {
+        maxBytes -= 1;
+    }
+}
+
+void TxQueue::flush() {
+    while (this->sendByte());
+}
+
+bool TxQueue::isEmpty() {
+    return this->buffers[REPLY_PRIORITY]->available() == 0 && this->buffers[EVENT_PRIORITY]->available() == 0;
+}
+
+unsigned long TxQueue::getTotalFrames(TxPriority priority) {
+    return this->totalFrames[priority];
+}
+
+unsigned long TxQueue::getTotalSentFrames(TxPriority priority) {
+    return this->totalSentFrames[priority];
+}
+
+unsigned int TxQueue::getDroppedFrames() {
+    return this->droppedFrames;
+}
+
+bool TxQueue::sendByte() {
+    if (this->sendingFrameLeft == 0) {
+        //The next frame is only chosen once the last one was fully sent, and a streamed frame is being sent
+        //until it ends
+        if (this->openFrameStreamed) {
+            return false;
+        } else if (this->frameSizes[REPLY_PRIORITY]->available() > 0) {
+            this->sendingPriority = REPLY_PRIORITY;
+        } else if (this->frameSizes[EVENT_PRIORITY]->available() > 0) {
+            this->sendingPriority = EVENT_PRIORITY;
+        } else {
+            return false;
+        }
+        RingBuffer* frameSizes = this->frameSizes[this->sendingPriority];
+        this->sendingFrameLeft = frameSizes->read();
+        this->sendingFrameLeft |= frameSizes->read() << 8;
+    }
+    this->output->write(this->buffers[this->sendingPriority]->read());
+    this->sendingFrameLeft -= 1;
+    if (this->sendingFrameLeft == 0) {
+        this->totalSentFrames[this->sendingPriority] += 1;
+    }
+    return true;
+}
+
+void TxQueue::stream() {
+    //Only a reply is streamed. The frame being sent and the queued replies go first, as the replies are the
+    //first ones to be chosen, and then the bytes of the open frame written so far
+    while (this->sendingFrameLeft > 0 || this->frameSizes[this->openPriority]->available() > 0) {
+        this->sendByte();
+    }
+    RingBuffer* buffer = this->buffers[this->openPriority];
+    while (this->openFrameSize > 0) {
+        this->output->write(buffer->read());
+        this->openFrameSize -= 1;
+    }
+    this->openFrameStreamed = true;
+}
+
+void TxQueue::dropOpenFrame() {
+    RingBuffer* buffer = this->buffers[this->openPriority];
+    buffer->truncate(buffer->available() - this->openFrameSize);
+    this->openFrameSize = 0;
+    this->openFrameDropped = true;
+}
@@ -0,0 +1,56 @@
+#ifndef TX_QUEUE_H
+#define TX_QUEUE_H
+
+#include <Arduino.h>
+
+#include "RingBuffer.h"
+
+enum TxPriority {
+    REPLY_PRIORITY, EVENT_PRIORITY
+};
+
+const byte TOTAL_TX_PRIORITIES = 2;
+
+/*
+The frames waiting to be sent, the serial port sends them while the firmware keeps running. The replies are sent
+before the events, but a frame is always sent whole so the frames are never mixed. An event that does not fit
+is dropped, while a reply that does not fit is streamed to the output, waiting for the serial port.
+*/
+class TxQueue : public Print
+{
+    public:
+        TxQueue(Print* output, unsigned int replyCapacity, unsigned int eventCapacity, byte maxFrames);
+        ~TxQueue();
+
+        void beginFrame(TxPriority priority);
+        size_t write(uint8_t value);
+        using Print::write;
+        bool endFrame();
+        bool canQueue(TxPriority priority, unsigned int frameSize);
+        void send(unsigned int maxBytes);
+        void flush();
+        bool isEmpty();
+        unsigned long getTotalFrames(TxPriority priority);
+        unsigned long getTotalSentFrames(TxPriority priority);
+        unsigned int getDroppedFrames();
+
+    private:
+        Print* output;
+        RingBuffer* buffers[TOTAL_TX_PRIORITIES];
+        RingBuffer* frameSizes[TOTAL_TX_PRIORITIES];
+        unsigned long totalFrames[TOTAL_TX_PRIORITIES] = {};
+        unsigned long totalSentFrames[TOTAL_TX_PRIORITIES] = {};
+        unsigned int droppedFrames = 0;
+        TxPriority openPriority = REPLY_PRIORITY;
+        unsigned int openFrameSize = 0;
+        bool openFrameDropped = false;
+        bool openFrameStreamed = false;
+        TxPriority sendingPriority = REPLY_PRIORITY;
+        unsigned int sendingFrameLeft = 0;
+
+        bool sendByte();
+        void stream();
+        void dropOpenFrame();
+};
+
+#endif
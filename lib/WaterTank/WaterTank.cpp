@@ -2,21 +2,21 @@
 
 #include "WaterTank.h"
 #include "Exception.h"
+#include "Notifier.h"
+
+Pool<WaterTank, WATER_TANKS_CAPACITY> WaterTank::pool;
+Pool<WaterSource, WATER_SOURCES_CAPACITY> WaterSource::pool;
 
 WaterTank::WaterTank(IOInterface* pressureSensor, float volumeFactor, float pressureFactor, WaterSource* waterSource) {
     this->pressureSensor = pressureSensor;
-    this->volumeFactor = volumeFactor;
-    this->pressureFactor = pressureFactor;
     this->waterSource = waterSource;
-    this->zeroVolumePressure = 0;
+    this->setVolumeFactor(volumeFactor);
+    this->setPressureFactor(pressureFactor);
     this->active = true;
     this->error = NULL;
 
-    this->fillingTimer = new Clock();
-    this->pressureChangingTimer = new Clock();
-    this->fillingCallsProtectionTimer = new Clock();
-
-    this->fillingCallsProtectionTimer->startTimer();
+    this->fillingCallsProtectionStartTime = Clock::currentMillis();
+    this->fillCyclesStartTime = this->fillingCallsProtectionStartTime;
 }
 
 WaterTank::WaterTank(IOInterface* pressureSensor, float volumeFactor, float pressureFactor) : WaterTank(pressureSensor, volumeFactor, pressureFactor, NULL){
@@ -24,21 +24,355 @@ WaterTank::WaterTank(IOInterface* pressureSensor, float volumeFactor, float pres
 }
 
 WaterTank::~WaterTank() {
-    delete this->fillingTimer;
-    delete this->pressureChangingTimer;
-    delete this->fillingCallsProtectionTimer;
+    delete this->calibration;
+}
+
+void* WaterTank::operator new(size_t size) noexcept {
+    return WaterTank::pool.allocate();
+}
+
+void WaterTank::operator delete(void* pointer) {
+    WaterTank::pool.release(pointer);
 }
 
 float WaterTank::getVolume() {
-    return max(0, (this->getPressure() * volumeFactor) - this->zeroVolumePressure);
+    return this->getVolume(this->getPressureRawValue());
+}
+
+float WaterTank::getVolume(unsigned int pressureRawValue) {
+    return FixedPoint::toFloat(this->getFixedVolume(pressureRawValue));
 }
 
 float WaterTank::getPressure() {
-    return this->pressureSensor->read() * pressureFactor;
+    return this->getPressure(this->getPressureRawValue());
+}
+
+float WaterTank::getPressure(unsigned int pressureRawValue) {
+    return FixedPoint::toFloat(this->getFixedPressure(pressureRawValue));
+}
+
+long WaterTank::getFixedVolume(unsigned int pressureRawValue) {
+    if (this->calibration != NULL) {
+        return this->calibration->getFixedVolume(pressureRawValue);
+    }
+    return max(0L, this->volumeScale.apply(pressureRawValue) - this->fixedZeroVolumePressure);
+}
+
+long WaterTank::getFixedPressure(unsigned int pressureRawValue) {
+    return this->pressureScale.apply(pressureRawValue);
+}
+
+float WaterTank::getMinimumVolume() {
+    return this->minimumVolume;
+}
+
+float WaterTank::getMaxVolume() {
+    return this->maxVolume;
+}
+
+float WaterTank::getVolumeFactor() {
+    return this->volumeFactor;
+}
+
+float WaterTank::getPressureFactor() {
+    return this->pressureFactor;
+}
+
+float WaterTank::getZeroVolumePressure() {
+    return this->zeroVolumePressure;
+}
+
+float WaterTank::getPressureChangingValue() {
+    return this->pressureChangingValue;
+}
+
+void WaterTank::setMinimumVolume(float minimumVolume) {
+    this->minimumVolume = minimumVolume;
+    this->fixedMinimumVolume = FixedPoint::fromFloat(minimumVolume);
+}
+
+void WaterTank::setMaxVolume(float maxVolume) {
+    this->maxVolume = maxVolume;
+    this->fixedMaxVolume = FixedPoint::fromFloat(maxVolume);
+}
+
+void WaterTank::setVolumeFactor(float volumeFactor) {
+    this->volumeFactor = volumeFactor;
+    this->volumeScale.setFactor(this->pressureFactor * volumeFactor);
+    //The sampled volumes and the learned fill rate are not comparable to the new ones
+    this->clearFlow();
+}
+
+void WaterTank::setPressureFactor(float pressureFactor) {
+    this->pressureFactor = pressureFactor;
+    this->pressureScale.setFactor(pressureFactor);
+    this->volumeScale.setFactor(pressureFactor * this->volumeFactor);
+    this->clearFlow();
+}
+
+void WaterTank::setZeroVolumePressure(float zeroVolumePressure) {
+    this->zeroVolumePressure = zeroVolumePressure;
+    this->fixedZeroVolumePressure = FixedPoint::fromFloat(zeroVolumePressure);
+    this->clearFlow();
+}
+
+void WaterTank::setPressureChangingValue(float pressureChangingValue) {
+    this->pressureChangingValue = pressureChangingValue;
+    this->fixedPressureChangingValue = FixedPoint::fromFloat(pressureChangingValue);
+}
+
+bool WaterTank::isUnderMinimumVolume() {
+    //At the minimum volume the water tank is also considered under it
+    return this->getFixedVolume(this->getPressureRawValue()) <= this->fixedMinimumVolume;
 }
 
 unsigned int WaterTank::getPressureRawValue() {
-    return this->pressureSensor->read();
+    //The pressure sensor is read once per manager loop, every check of the loop sees the same value
+    if (this->filter.getType() == NO_FILTER) {
+        return this->pressureSensor->sample(this->oversampling);
+    }
+    if (this->filter.isEmpty()) {
+        this->filter.push(this->pressureSensor->sample(this->oversampling));
+        this->lastSampleTime = this->lastTickTime;
+    }
+    return this->filter.getValue();
+}
+
+void WaterTank::setFilter(FilterType type, byte window, byte oversampling) {
+    this->filter.setFilter(type, window);
+    this->oversampling = oversampling;
+}
+
+FilterType WaterTank::getFilterType() {
+    return this->filter.getType();
+}
+
+byte WaterTank::getFilterWindow() {
+    return this->filter.getWindow();
+}
+
+byte WaterTank::getOversampling() {
+    return this->oversampling;
+}
+
+void WaterTank::setCalibration(const unsigned int* rawValues, const float* volumes, byte totalPoints) {
+    this->clearFlow();
+    //A table without points removes the calibration, giving the table back to its pool
+    if (totalPoints == 0) {
+        delete this->calibration;
+        this->calibration = NULL;
+        return;
+    }
+    if (this->calibration == NULL) {
+        this->calibration = new CalibrationTable();
+        if (this->calibration == NULL) {
+            return Exception::throwException(&MAX_CALIBRATION_TABLES_ERROR);
+        }
+    }
+    this->calibration->setPoints(rawValues, volumes, totalPoints);
+}
+
+CalibrationTable* WaterTank::getCalibration() {
+    return this->calibration;
+}
+
+float WaterTank::getFlowRate() {
+    return FixedPoint::toFloat(this->flow.getRate());
+}
+
+float WaterTank::getExpectedFillRate() {
+    return this->isFillRateLearned() ? FixedPoint::toFloat(this->expectedFillRate) : 0;
+}
+
+void WaterTank::setControl(ControlMode mode, float lowerBand, float upperBand) {
+    this->controlMode = mode;
+    this->lowerBand = lowerBand;
+    this->upperBand = upperBand;
+    this->fixedLowerBand = FixedPoint::fromFloat(lowerBand);
+    this->fixedUpperBand = FixedPoint::fromFloat(upperBand);
+}
+
+ControlMode WaterTank::getControlMode() {
+    return this->controlMode;
+}
+
+float WaterTank::getLowerBand() {
+    return this->lowerBand;
+}
+
+float WaterTank::getUpperBand() {
+    return this->upperBand;
+}
+
+unsigned long WaterTank::getSettleLag() {
+    return this->settleLag;
+}
+
+unsigned int WaterTank::getFillCycles() {
+    return this->fillCycles;
+}
+
+unsigned int WaterTank::getLastDayFillCycles() {
+    return this->lastDayFillCycles;
+}
+
+bool WaterTank::isUnderStartVolume() {
+    //The lower band holds the start of a fill under the minimum volume
+    return this->getFixedVolume(this->getPressureRawValue()) <= this->fixedMinimumVolume - this->fixedLowerBand;
+}
+
+bool WaterTank::isOverStopVolume() {
+    long volume = this->getFixedVolume(this->getPressureRawValue());
+    if (this->controlMode == PREDICTIVE_CONTROL) {
+        volume += this->predictedOvershoot;
+    }
+    return volume >= this->fixedMaxVolume - this->fixedUpperBand;
+}
+
+unsigned long WaterTank::getTimeToMaxVolume(unsigned int pressureRawValue) {
+    return this->flow.getRate() > 0 ? this->getTimeToVolume(this->fixedMaxVolume, pressureRawValue) : 0;
+}
+
+unsigned long WaterTank::getTimeToMinimumVolume(unsigned int pressureRawValue) {
+    return this->flow.getRate() < 0 ? this->getTimeToVolume(this->fixedMinimumVolume, pressureRawValue) : 0;
+}
+
+unsigned long WaterTank::getTimeToVolume(long volume, unsigned int pressureRawValue) {
+    //The seconds to reach the volume at the estimated flow, 0 when it has been reached
+    long rate = this->flow.getRate();
+    long remainingVolume = volume - this->getFixedVolume(pressureRawValue);
+    if (rate == 0 || (remainingVolume > 0) != (rate > 0)) {
+        return 0;
+    }
+    //The minutes and the rest are converted apart, so the seconds are computed in 32 bits. The rest is under the rate,
+    //which is under MAX_FLOW_RATE, and a time too long for its seconds to fit is saturated
+    unsigned long minutes = remainingVolume / rate;
+    if (minutes >= 0xFFFFFFFFUL / 60) {
+        return 0xFFFFFFFFUL;
+    }
+    return minutes * 60 + ((remainingVolume % rate) * 60) / rate;
+}
+
+void WaterTank::sample(unsigned long currentTime) {
+    this->lastTickTime = currentTime;
+    if (this->filter.getType() != NO_FILTER &&
+        (this->filter.isEmpty() || currentTime - this->lastSampleTime >= SAMPLING_INTERVAL)) {
+        this->filter.push(this->pressureSensor->sample(this->oversampling));
+        this->lastSampleTime = currentTime;
+    }
+    //The volume is taken after the filter is fed
+    long volume = this->getFixedVolume(this->getPressureRawValue());
+    bool filling = this->isServed();
+    if (currentTime - this->fillCyclesStartTime >= FILL_CYCLES_DAY) {
+        this->lastDayFillCycles = this->fillCycles;
+        this->fillCycles = 0;
+        this->fillCyclesStartTime = currentTime;
+    }
+    if (filling != this->flowFilling) {
+        this->flow.clear();
+        this->flowFilling = filling;
+        this->fillStalled = false;
+        this->predictedOvershoot = 0;
+        //The settle is watched from the stop, a new fill drops it
+        this->settling = !filling;
+        this->settleStopTime = currentTime;
+        this->settlePeakTime = currentTime;
+        this->settlePeakVolume = volume;
+        if (filling) {
+            this->fillCycles += 1;
+        }
+    }
+    if (this->settling) {
+        this->checkSettle(volume, currentTime);
+    }
+    if (this->flow.isEmpty() || currentTime - this->lastFlowSampleTime >= FLOW_SAMPLING_INTERVAL) {
+        this->flow.push(volume);
+        this->lastFlowSampleTime = currentTime;
+        if (filling && this->flow.isReady()) {
+            this->checkFillRate(currentTime);
+            long rate = this->flow.getRate();
+            //The lag is taken in seconds, up to MAX_TIME_NOT_FILLING, so its product by a rate under MAX_FLOW_RATE fits a long
+            long settleLagSeconds = min(this->settleLag, MAX_TIME_NOT_FILLING) / 1000;
+            this->predictedOvershoot = rate > 0 ? (rate * settleLagSeconds) / 60 : 0;
+        }
+    }
+}
+
+void WaterTank::checkSettle(long volume, unsigned long currentTime) {
+    if (volume > this->settlePeakVolume) {
+        this->settlePeakVolume = volume;
+        this->settlePeakTime = currentTime;
+    } else if (currentTime - this->settlePeakTime >= SETTLE_TIME) {
+        long lag = this->settlePeakTime - this->settleStopTime;
+        if (this->settleLagLearned) {
+            this->settleLag += (lag - (long) this->settleLag) / SETTLE_LAG_WEIGHT;
+        } else {
+            this->settleLag = lag;
+            this->settleLagLearned = true;
+        }
+        this->settling = false;
+    }
+}
+
+void WaterTank::clearFlow() {
+    this->flow.clear();
+    this->predictedOvershoot = 0;
+    this->learnedFillSamples = 0;
+    this->fillStalled = false;
+}
+
+void WaterTank::checkFillRate(unsigned long currentTime) {
+    long rate = this->flow.getRate();
+    if (this->isFillRateLearned() && rate < this->getMinimumFillRate()) {
+        //A long pipe delays the first rise of the volume, so a fill is only taken as stalled once its first
+        //window is full, and the rate of the delay is not learned
+        if (!this->flow.isFull()) {
+            return;
+        }
+        if (!this->fillStalled) {
+            this->fillStalled = true;
+            this->fillStallStartTime = currentTime;
+        }
+        return;
+    }
+    this->fillStalled = false;
+    //Only a rising volume is learned, a first fill without flow must not be taken as the expected one
+    if (rate <= 0) {
+        return;
+    }
+    if (this->learnedFillSamples == 0) {
+        this->expectedFillRate = rate;
+        this->fillRateDeviation = rate / 4;
+    } else {
+        long difference = rate - this->expectedFillRate;
+        this->expectedFillRate += difference / FILL_RATE_WEIGHT;
+        this->fillRateDeviation += (abs(difference) - this->fillRateDeviation) / FILL_RATE_WEIGHT;
+    }
+    this->learnedFillSamples = min(this->learnedFillSamples + 1, FILL_RATE_LEARNING_SAMPLES);
+}
+
+bool WaterTank::isFillRateLearned() {
+    return this->learnedFillSamples >= FILL_RATE_LEARNING_SAMPLES;
+}
+
+long WaterTank::getMinimumFillRate() {
+    //The confidence bound is kept at a fraction of the expected rate, even when the rate has varied a lot
+    return max(this->expectedFillRate - STALL_DEVIATIONS * this->fillRateDeviation, this->expectedFillRate / 4);
+}
+
+unsigned long WaterTank::getStallTime() {
+    //A small water tank or a strong water source is stopped sooner
+    long volumeRange = this->fixedMaxVolume - this->fixedMinimumVolume;
+    if (volumeRange <= 0) {
+        return MIN_STALL_TIME;
+    }
+    //The expected rate is under MAX_FLOW_RATE, so the time is computed in 32 bits by its minutes and the seconds of the rest
+    long stallVolumeRate = STALL_VOLUME_DIVISOR * this->expectedFillRate;
+    if (stallVolumeRate <= 0 || volumeRange / stallVolumeRate >= (long) (MAX_TIME_NOT_FILLING / 60000)) {
+        return MAX_TIME_NOT_FILLING;
+    }
+    unsigned long stallTime = (volumeRange / stallVolumeRate) * 60000 + ((volumeRange % stallVolumeRate) * 60 / stallVolumeRate) * 1000;
+    return max(stallTime, MIN_STALL_TIME);
 }
 
 unsigned int WaterTank::getPressureSensorPin() {
@@ -50,7 +384,8 @@ WaterSource* WaterTank::getWaterSource() {
 }
 
 bool WaterTank::canFill() {
-    return this->waterSource != NULL && this->waterSource->canEnable() && this->active && this->getVolume() < this->maxVolume;
+    return this->waterSource != NULL && this->waterSource->canEnable() && this->active &&
+           this->getFixedVolume(this->getPressureRawValue()) < this->fixedMaxVolume;
 }
 
 bool WaterTank::isActive() {
@@ -58,21 +393,26 @@ bool WaterTank::isActive() {
 }
 
 void WaterTank::fill(bool force) {
+    this->fill(force, Clock::currentMillis());
+}
+
+void WaterTank::fill(bool force, unsigned long currentTime) {
     if (this->waterSource == NULL) {
         return Exception::throwException(&CANNOT_FILL_WATER_TANK_WITHOUT_WATER_SOURCE);
     }
     if (!force && !this->active) {
         return Exception::throwException(&CANNOT_FILL_DEACTIVATED_WATER_TANK);
     }
-    if (!force && this->getVolume() >= this->maxVolume) {
+    if (!force && this->getFixedVolume(this->getPressureRawValue()) >= this->fixedMaxVolume) {
         return Exception::throwException(&CANNOT_FILL_WATER_TANK_MAX_VOLUME);
     }
-    this->active = true;
-    this->fillingTimer->startTimer();
-    this->fillingCallsProtectionTimer->startTimer();
-    this->pressureChangingTimer->stopTimer();
+    this->setActive(true);
+    this->fillRequested = true;
+    this->fillingStartTime = currentTime;
+    this->fillingCallsProtectionStartTime = currentTime;
+    this->pressureChangingStarted = false;
     this->waterSource->turnOn(force);
-    this->lastLoopPressure = this->getPressure();
+    this->lastLoopPressure = this->getFixedPressure(this->getPressureRawValue());
 }
 
 bool WaterTank::isFilling() {
@@ -80,46 +420,117 @@ bool WaterTank::isFilling() {
 }
 
 void WaterTank::stopFilling() {
+    this->fillRequested = false;
     if (this->waterSource != NULL) {
         this->waterSource->turnOff();
     }
 }
 
+bool WaterTank::isServed() {
+    return this->fillRequested && this->waterSource != NULL && this->waterSource->isTurnedOn();
+}
+
+bool WaterTank::isDemanding(unsigned long currentTime) {
+    if (this->waterSource == NULL || !this->active) {
+        return false;
+    }
+    //The demand is held while the filling calls protection lasts, so the water source is not turned on and off in a row
+    bool isProtected = currentTime - this->fillingCallsProtectionStartTime <= FILLING_CALLS_PROTECTION_TIME;
+    if (this->isServed()) {
+        return isProtected || (this->canFill() && !this->isOverStopVolume());
+    }
+    return !isProtected && this->canFill() && this->isUnderStartVolume();
+}
+
+void WaterTank::release(unsigned long currentTime) {
+    //The water source is turned off by its owner, it may keep filling another water tank
+    this->fillRequested = false;
+    this->fillingCallsProtectionStartTime = currentTime;
+}
+
+void WaterTank::clearFillRequest() {
+    this->fillRequested = false;
+}
+
+long WaterTank::getFillPriority(unsigned long waitingTime) {
+    long volumeRange = this->fixedMaxVolume - this->fixedMinimumVolume;
+    long deficit = this->fixedMaxVolume - this->getFixedVolume(this->getPressureRawValue());
+    long deficitPercent = 100;
+    if (volumeRange > 0) {
+        if (abs(deficit) > MAX_PERCENT_DEFICIT) {
+            //A deficit too large for its percent to fit a long is scaled down with the range, the volumes are under
+            //FIXED_LIMIT so 7 bits are enough. Such a deficit is over 20000 units, the precision lost does not matter
+            deficit /= 128;
+            volumeRange = max(volumeRange / 128, 1L);
+        }
+        deficitPercent = (deficit * 100) / volumeRange;
+    }
+    return this->priorityWeight * (deficitPercent + (long) (waitingTime / 60000UL) * WAITING_MINUTE_PRIORITY);
+}
+
+void WaterTank::setPriorityWeight(byte weight) {
+    this->priorityWeight = weight;
+}
+
+byte WaterTank::getPriorityWeight() {
+    return this->priorityWeight;
+}
+
 void WaterTank::setActive(bool active) {
+    if (this->active != active) {
+        Notifier::notify(WATER_TANK_ACTIVE_CHANGED, this, active);
+    }
     this->active = active;
-    if (!active) {
+    //A water tank that is not being filled leaves a shared water source to the others
+    if (!active && this->fillRequested) {
         this->stopFilling();
     }
 }
  
-void WaterTank::loop() {
+void WaterTank::loop(unsigned long currentTime) {
     if (this->waterSource == NULL) {
         return;
     }
 
-    if (this->active && this->waterSource->isTurnedOn()) {
+    if (this->active && this->isServed() && this->isFillRateLearned()) {
         this->error = NULL;
 
-        float currentPressure = this->getPressure();
+        //The flow is checked when it is sampled, the fill has stalled since its rate is under the confidence bound
+        if (this->fillStalled) {
+            if (currentTime - this->fillStallStartTime >= this->getStallTime()) {
+                this->error = &MAX_TIME_WATER_TANK_NOT_FILLING;
+                this->setActive(false);
+            } else {
+                this->error = &WATER_TANK_IS_NOT_FILLING;
+            }
+        }
+    } else if (this->active && this->isServed()) {
+        //Until the fill rate is learned, a fill is checked by the pressure changes
+        this->error = NULL;
 
-        if (abs(this->lastLoopPressure - currentPressure) >= this->pressureChangingValue) {
-            this->pressureChangingTimer->startTimer();
+        long currentPressure = this->getFixedPressure(this->getPressureRawValue());
+
+        if (abs(this->lastLoopPressure - currentPressure) >= this->fixedPressureChangingValue) {
+            this->pressureChangingStartTime = currentTime;
+            this->pressureChangingStarted = true;
         } else {
+            unsigned long pressureChangingElapsedTime = currentTime - this->pressureChangingStartTime;
+            unsigned long fillingElapsedTime = currentTime - this->fillingStartTime;
 
-            if (this->pressureChangingTimer->hasStarted()) {
-                if (this->pressureChangingTimer->getElapsedTime() >= MAX_TIME_NOT_FILLING) {
+            if (this->pressureChangingStarted) {
+                if (pressureChangingElapsedTime >= MAX_TIME_NOT_FILLING) {
                     this->error = &MAX_TIME_WATER_TANK_NOT_FILLING;
                     this->setActive(false);
 
-                } else if (this->pressureChangingTimer->getElapsedTime() >= CHANGING_INTERVAL) {
+                } else if (pressureChangingElapsedTime >= CHANGING_INTERVAL) {
                     //Volume/Presure is not changing anymore
                     this->error = &WATER_TANK_HAS_STOPPED_TO_FILL;
                 }
-            } else if (this->fillingTimer->getElapsedTime() >= MAX_TIME_NOT_FILLING) {
+            } else if (fillingElapsedTime >= MAX_TIME_NOT_FILLING) {
                 this->error = &MAX_TIME_WATER_TANK_NOT_FILLING;
                 this->setActive(false);
 
-            } else if (this->fillingTimer->getElapsedTime() >= CHANGING_INTERVAL) {
+            } else if (fillingElapsedTime >= CHANGING_INTERVAL) {
                 //Volume/Pressure didn't change since water tank was ordered to fill
                 this->error = &WATER_TANK_IS_NOT_FILLING;
             }
@@ -127,21 +538,45 @@ void WaterTank::loop() {
         this->lastLoopPressure = currentPressure;
     }
 
-    if (this->fillingCallsProtectionTimer->getElapsedTime() > FILLING_CALLS_PROTECTION_TIME) {
-        if (!this->canFill() && this->waterSource->isTurnedOn()) {
-            this->waterSource->turnOff();
-            this->fillingCallsProtectionTimer->startTimer();
-        } else if ((this->canFill() && this->getVolume() <= this->minimumVolume) && !this->waterSource->isTurnedOn()) {
-            this->fill(false);
-            this->fillingCallsProtectionTimer->startTimer();
-        }
-    }
+    //The water source is turned on and off by the manager, from the demand of the water tanks depending on it
 
     if (this->error != NULL) {
         Exception::throwException(this->error);
     }
 }
 
+unsigned long WaterTank::getWaitingTime(unsigned long currentTime) {
+    //Nothing changes before the next sample of the pressure sensor, unless a timer expires before it
+    unsigned long waitingTime = SAMPLING_INTERVAL;
+    //The flow estimator expects its volumes evenly spaced
+    waitingTime = min(waitingTime, WaterTank::getRemainingTime(this->lastFlowSampleTime, FLOW_SAMPLING_INTERVAL, currentTime));
+    if (this->waterSource == NULL) {
+        return waitingTime;
+    }
+    if (this->active && this->isServed() && this->isFillRateLearned()) {
+        if (this->fillStalled) {
+            waitingTime = min(waitingTime, WaterTank::getRemainingTime(this->fillStallStartTime, this->getStallTime(), currentTime));
+        }
+    } else if (this->active && this->isServed()) {
+        unsigned long startTime = this->pressureChangingStarted ? this->pressureChangingStartTime : this->fillingStartTime;
+        waitingTime = min(waitingTime, WaterTank::getRemainingTime(startTime, CHANGING_INTERVAL, currentTime));
+        waitingTime = min(waitingTime, WaterTank::getRemainingTime(startTime, MAX_TIME_NOT_FILLING, currentTime));
+    }
+    //The filling calls protection expires once its time is exceeded
+    waitingTime = min(waitingTime, WaterTank::getRemainingTime(this->fillingCallsProtectionStartTime,
+                                                               FILLING_CALLS_PROTECTION_TIME + 1, currentTime));
+    return waitingTime;
+}
+
+unsigned long WaterTank::getRemainingTime(unsigned long startTime, unsigned long interval, unsigned long currentTime) {
+    unsigned long elapsedTime = currentTime - startTime;
+    if (elapsedTime >= interval) {
+        //An expired timer does not need an earlier sample
+        return SAMPLING_INTERVAL;
+    }
+    return interval - elapsedTime;
+}
+
 WaterSource::WaterSource(IOInterface* io, WaterTank* waterTank) {
     this->io = io;
     this->waterTank = waterTank;
@@ -152,6 +587,14 @@ WaterSource::WaterSource(IOInterface* io) : WaterSource(io, NULL) {
 
 }
 
+void* WaterSource::operator new(size_t size) noexcept {
+    return WaterSource::pool.allocate();
+}
+
+void WaterSource::operator delete(void* pointer) {
+    WaterSource::pool.release(pointer);
+}
+
 void WaterSource::turnOn(bool force) {
     if (!force && !this->active) {
         return Exception::throwException(&CANNOT_TURN_ON_DEACTIVATED_WATER_SOURCE);
@@ -159,10 +602,16 @@ void WaterSource::turnOn(bool force) {
     if (!force && !this->canEnable()) {
         return Exception::throwException(&CANNOT_ENABLE_WATER_SOURCE_DUE_MINIMUM_VOLUME);
     }
+    if (!this->isTurnedOn()) {
+        Notifier::notify(WATER_SOURCE_STATE_CHANGED, this, HIGH);
+    }
     this->io->write(HIGH);
 }
 
 void WaterSource::turnOff() {
+    if (this->isTurnedOn()) {
+        Notifier::notify(WATER_SOURCE_STATE_CHANGED, this, LOW);
+    }
     this->io->write(LOW);
 }
 
@@ -179,7 +628,7 @@ WaterTank* WaterSource::getWaterTank() {
 }
 
 bool WaterSource::canEnable() {
-    return this->active && (this->waterTank == NULL || this->waterTank->getVolume() > this->waterTank->minimumVolume);
+    return this->active && (this->waterTank == NULL || !this->waterTank->isUnderMinimumVolume());
 }
 
 bool WaterSource::isActive() {
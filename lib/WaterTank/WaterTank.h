@@ -1,55 +1,192 @@
 #ifndef WATER_TANK_H
 #define WATER_TANK_H
 
+#include "Capacity.h"
 #include "IOInterface.h"
 #include "Exception.h"
 #include "Clock.h"
+#include "Pool.h"
+#include "PressureFilter.h"
+#include "CalibrationTable.h"
+#include "FlowEstimator.h"
+#include "FixedPoint.h"
+
+static_assert(IO_INTERFACES_CAPACITY >= WATER_TANKS_CAPACITY + WATER_SOURCES_CAPACITY,
+              "Every water tank and water source needs an IO interface");
 
 const float UNDEFINED_VOLUME = -1;
 const unsigned long CHANGING_INTERVAL = 300000UL; //5 minutes
 const unsigned long FILLING_CALLS_PROTECTION_TIME = 60000UL;  //1 minute
 const unsigned long MAX_TIME_NOT_FILLING = 600000UL; //10 minutes
+const unsigned long SAMPLING_INTERVAL = 1000UL; //1 second
+//The fill rate is learned from the flow while filling, once it is learned a fill is stalled below its confidence bound.
+//The stall is only checked from the first full flow window of a fill, 110 seconds after it starts
+const byte FILL_RATE_LEARNING_SAMPLES = 6; //1 minute of filling
+const byte FILL_RATE_WEIGHT = 8;
+const byte STALL_DEVIATIONS = 3;
+//A stalled fill is stopped once the expected rate would have filled 1/STALL_VOLUME_DIVISOR of the volume range
+const byte STALL_VOLUME_DIVISOR = 20;
+const unsigned long MIN_STALL_TIME = 10000UL; //10 seconds
+//The volume keeps rising after the water source is turned off, it has settled once it stops rising for SETTLE_TIME
+const unsigned long SETTLE_TIME = 60000UL; //1 minute
+const byte SETTLE_LAG_WEIGHT = 4;
+const unsigned long FILL_CYCLES_DAY = 86400000UL;
+//The fill priority grows by the deficit, in percent of the volume range, and by the minutes waited for the water source
+const long WAITING_MINUTE_PRIORITY = 10;
+const long MAX_PERCENT_DEFICIT = 0x7FFFFFFFL / 100;
+
+//The control modes have the same values of the SetWaterTankControl request
+enum ControlMode {
+    BANG_BANG_CONTROL, PREDICTIVE_CONTROL
+};
 
 class WaterSource;
 
 class WaterTank
 {
     public:
-        float minimumVolume = 0;
-        float maxVolume = 0;
-        float volumeFactor;
-        float pressureFactor;
-        float zeroVolumePressure;
-        float pressureChangingValue = 0.2;
-
         WaterTank(IOInterface* pressureSensor, float volumeFactor, float pressureFactor);
         WaterTank(IOInterface* pressureSensor, float volumeFactor, float pressureFactor, WaterSource* waterSource);
         ~WaterTank();
+        static void* operator new(size_t size) noexcept;
+        static void operator delete(void* pointer);
+        static Pool<WaterTank, WATER_TANKS_CAPACITY> pool;
 
         float getVolume();
+        float getVolume(unsigned int pressureRawValue);
         float getPressure();
+        float getPressure(unsigned int pressureRawValue);
+        float getMinimumVolume();
+        float getMaxVolume();
+        float getVolumeFactor();
+        float getPressureFactor();
+        float getZeroVolumePressure();
+        float getPressureChangingValue();
+        void setMinimumVolume(float minimumVolume);
+        void setMaxVolume(float maxVolume);
+        void setVolumeFactor(float volumeFactor);
+        void setPressureFactor(float pressureFactor);
+        void setZeroVolumePressure(float zeroVolumePressure);
+        void setPressureChangingValue(float pressureChangingValue);
+        bool isUnderMinimumVolume();
         bool canFill();
         bool isActive();
         unsigned int getPressureRawValue();
         unsigned int getPressureSensorPin();
         WaterSource* getWaterSource();
         void fill(bool force);
+        void fill(bool force, unsigned long currentTime);
         bool isFilling();
         void stopFilling();
+        bool isDemanding(unsigned long currentTime);
+        void release(unsigned long currentTime);
+        void clearFillRequest();
+        long getFillPriority(unsigned long waitingTime);
+        void setPriorityWeight(byte weight);
+        byte getPriorityWeight();
         void setActive(bool active);
-        void loop();
+        void setFilter(FilterType type, byte window, byte oversampling);
+        FilterType getFilterType();
+        byte getFilterWindow();
+        byte getOversampling();
+        void setCalibration(const unsigned int* rawValues, const float* volumes, byte totalPoints);
+        CalibrationTable* getCalibration();
+        float getFlowRate();
+        float getExpectedFillRate();
+        void setControl(ControlMode mode, float lowerBand, float upperBand);
+        ControlMode getControlMode();
+        float getLowerBand();
+        float getUpperBand();
+        unsigned long getSettleLag();
+        unsigned int getFillCycles();
+        unsigned int getLastDayFillCycles();
+        unsigned long getTimeToMaxVolume(unsigned int pressureRawValue);
+        unsigned long getTimeToMinimumVolume(unsigned int pressureRawValue);
+        void sample(unsigned long currentTime);
+        void loop(unsigned long currentTime);
+        unsigned long getWaitingTime(unsigned long currentTime);
 
     protected:
         IOInterface* pressureSensor;
         WaterSource* waterSource = NULL;
 
     private:
-    bool active;
-        Clock* fillingTimer;
-        Clock* pressureChangingTimer;
-        Clock* fillingCallsProtectionTimer;
-        float lastLoopPressure;
+        //The settings are kept as set for the clients, the control uses their fixed point values computed when they are set
+        float minimumVolume = 0;
+        float maxVolume = 0;
+        float volumeFactor = 0;
+        float pressureFactor = 0;
+        float zeroVolumePressure = 0;
+        float pressureChangingValue = 0.2;
+        long fixedMinimumVolume = 0;
+        long fixedMaxVolume = 0;
+        long fixedZeroVolumePressure = 0;
+        long fixedPressureChangingValue = FixedPoint::fromFloat(0.2);
+        FixedScale pressureScale;
+        //The volume is the raw value by the pressure and the volume factors, they are applied as a single scale
+        FixedScale volumeScale;
+        bool active;
+        //Set while the water source is filling this water tank. A water source shared by several water tanks fills one of them
+        //at a time, the others do not check the fill
+        bool fillRequested = false;
+        byte priorityWeight = 1;
+        //The timers are the times they were started, the elapsed times are taken from the loop current time
+        unsigned long fillingStartTime = 0;
+        unsigned long pressureChangingStartTime = 0;
+        bool pressureChangingStarted = false;
+        unsigned long fillingCallsProtectionStartTime = 0;
+        long lastLoopPressure;
+        //The filter is fed once per sampling interval, so its window spans a fixed time
+        PressureFilter filter;
+        byte oversampling = 1;
+        unsigned long lastSampleTime = 0;
+        //The timestamp of the last manager loop, a value read between the loops is taken as sampled in it
+        unsigned long lastTickTime = 0;
+        //Without a calibration table the volume is proportional to the pressure
+        CalibrationTable* calibration = NULL;
+        //The flow is estimated in both modes from the volumes sampled by the manager
+        FlowEstimator flow;
+        unsigned long lastFlowSampleTime = 0;
+        //The estimator is cleared when the water tank starts or stops filling, so its window has a single regime
+        bool flowFilling = false;
+        long expectedFillRate = 0;
+        long fillRateDeviation = 0;
+        byte learnedFillSamples = 0;
+        bool fillStalled = false;
+        unsigned long fillStallStartTime = 0;
+        //The predictive control stops filling once the volume and the overshoot expected after the stop reach the max
+        //volume less the upper band. The overshoot is the fill rate by the lag learned between a stop and the settle
+        ControlMode controlMode = BANG_BANG_CONTROL;
+        float lowerBand = 0;
+        float upperBand = 0;
+        long fixedLowerBand = 0;
+        long fixedUpperBand = 0;
+        unsigned long settleLag = 0;
+        bool settleLagLearned = false;
+        bool settling = false;
+        unsigned long settleStopTime = 0;
+        unsigned long settlePeakTime = 0;
+        long settlePeakVolume = 0;
+        long predictedOvershoot = 0;
+        //The fills started in the current day and in the last one
+        unsigned int fillCycles = 0;
+        unsigned int lastDayFillCycles = 0;
+        unsigned long fillCyclesStartTime = 0;
         const Exception* error;
+
+        long getFixedVolume(unsigned int pressureRawValue);
+        long getFixedPressure(unsigned int pressureRawValue);
+        unsigned long getTimeToVolume(long volume, unsigned int pressureRawValue);
+        void clearFlow();
+        void checkFillRate(unsigned long currentTime);
+        bool isFillRateLearned();
+        long getMinimumFillRate();
+        unsigned long getStallTime();
+        void checkSettle(long volume, unsigned long currentTime);
+        bool isUnderStartVolume();
+        bool isOverStopVolume();
+        bool isServed();
+        static unsigned long getRemainingTime(unsigned long startTime, unsigned long interval, unsigned long currentTime);
 };
 
 class WaterSource
@@ -60,6 +197,10 @@ class WaterSource
         WaterSource(IOInterface* io);
         WaterSource(IOInterface* io, WaterTank* waterTank);
 
+        static void* operator new(size_t size) noexcept;
+        static void operator delete(void* pointer);
+        static Pool<WaterSource, WATER_SOURCES_CAPACITY> pool;
+
         void turnOn(bool force=false);
         void turnOff();
         bool isTurnedOn();
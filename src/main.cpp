@@ -2,11 +2,16 @@
 #include <pb_decode.h>
 #include <pb_encode.h>
 #include <pb_common.h>
+#include <avr/sleep.h>
 
 #include "API.h"
 #include "Clock.h"
 #include "IOInterface.h"
+#include "AnalogSampler.h"
 #include "Persister.h"
+#include "RingBuffer.h"
+#include "Cobs.h"
+#include "TxQueue.h"
 #include "api.pb.c"
 
 
@@ -26,6 +31,45 @@ messageType:
 01: API.proto messages
 02: Test.proto messages
 03: Debug messages
+04: Batch of API.proto messages
+05: API.proto events (sent to subscribed clients only)
+
+A batch carries several API requests in a single frame, they are handled in order and answered
+with a single batch frame holding one Response per Request. In a batch the messageLength field is
+replaced by the amount of messages and each message has its own length:
+[byte] messageType (04)
+[uint] totalMessages
+[uint] message 1 length
+[variable-size] MESSAGE 1
+...
+
+The received bytes are queued in an RX ring buffer, so several frames can be waiting while the firmware
+handles the first one. The queued frames are handled in arrival order, each loop pass stops handling them
+once REQUESTS_TIME_BUDGET is spent so the water tanks keep being controlled during a burst of requests.
+A frame is never waited for: it is handled once it has fully arrived, and a batch is handled one message at
+a time, so a batch larger than the RX buffer keeps its reply frame open across the loop passes. The events
+and the unsolicited errors wait for that frame to end. A frame with an invalid header is answered right away
+and its payload is dropped while it arrives. A frame that stops arriving is dropped once READ_TIMEOUT passes
+without a new byte, and the water tanks keep being run while it is waited for.
+
+A client can switch to the COBS framing with a setFraming request, it is answered before the framing changes.
+Each frame keeps the format above, followed by a CRC-16 of the frame, and it is COBS encoded and ended by a
+zero byte. A corrupted frame is answered with an error as soon as its delimiter arrives and the next frame is
+handled normally, so the reader does not wait READ_TIMEOUT to resync. A COBS frame must fit in the RX buffer.
+The framing goes back to the legacy one when the board resets, so it is negotiated on each connection.
+
+The frames to send are queued in a TX queue, which the serial port drains in the background while the water
+tanks keep being controlled. The replies are sent before the events and the unsolicited errors, a reply larger
+than its queue is streamed while the serial port sends it. Events are dropped while their queue is full.
+
+When no request is waiting, the MCU sleeps in the idle mode until the next interrupt. The millis timer wakes it
+on every tick, so the water tanks whose deadline has arrived are run, and a received byte wakes it right away.
+The ADC conversions of the pressure sensors also wake it, they are sampled in the background by AnalogSampler.
+
+The link starts at DEFAULT_BAUD_RATE, or at the baud rate saved in the EEPROM. A client can propose another
+baud rate with a setBaudRate request, it is answered at the current baud rate and the firmware switches right
+after. If no valid request arrives in BAUD_RATE_TIMEOUT at the new baud rate, both sides go back to
+DEFAULT_BAUD_RATE. A baud rate requested to be persisted is saved once it is confirmed by a valid request.
 */
 
 #ifdef TEST
@@ -34,59 +78,316 @@ const unsigned int MAX_MESSAGE_SIZE = max(Request_size, _TestRequest_size);
 const unsigned int MAX_MESSAGE_SIZE = Request_size;
 #endif
 
+const unsigned int MAX_BATCH_MESSAGES = 64;
+
 const unsigned int READ_TIMEOUT = 2500; //Miliseconds
 
-byte requestBuffer[Request_size];
-byte responseBuffer[Response_size];
+const unsigned long DEFAULT_BAUD_RATE = 9600;
+const unsigned long SUPPORTED_BAUD_RATES[] = {9600, 19200, 38400, 57600, 115200, 250000, 500000};
+const unsigned int BAUD_RATE_TIMEOUT = 3000; //Miliseconds
+
+const unsigned int RX_BUFFER_SIZE = 512;
+const unsigned int FRAME_HEADER_SIZE = sizeof(byte) + sizeof(unsigned int);
+static_assert(FRAME_HEADER_SIZE + MAX_MESSAGE_SIZE <= RX_BUFFER_SIZE && sizeof(unsigned int) + Request_size <= RX_BUFFER_SIZE,
+              "A valid frame and a valid batch message must fit in the RX buffer, they are handled once fully queued");
+const unsigned int REQUESTS_TIME_BUDGET = 20; //Miliseconds
+
+const unsigned int TX_REPLY_BUFFER_SIZE = 512;
+const unsigned int TX_EVENT_BUFFER_SIZE = 192;
+const byte MAX_TX_FRAMES = 16;
+//A COBS frame adds a block code, the CRC and the delimiter
+const unsigned int MAX_EVENT_FRAME_SIZE = FRAME_HEADER_SIZE + Event_size + COBS_CRC_SIZE + 2;
+
 byte messageType = 0;
-unsigned int read = 0;
+bool messageTruncated = false;
+bool batchResponse = false;
+bool unsolicitedResponse = false;
+unsigned int batchMessagesLeft = 0;
+unsigned int rxBytesToSkip = 0;
 
-byte messageLengthBuffer[2] = {0, 0};
-byte messageLengthBufferReadIndex = 0;
 unsigned int messageLength;
 
 Request request = Request_init_zero;
 Response response = Response_init_zero;
 pb_istream_t requestStream;
-pb_ostream_t responseStream;
 
 API* api;
 Clock* readerTimer;
+Clock* requestsTimer;
+RingBuffer* rxBuffer;
 HardwareSerial* apiSerial = &Serial;
 
+SetFraming_Framing framing = SetFraming_Framing_LEGACY;
+SetFraming_Framing requestedFraming = SetFraming_Framing_LEGACY;
+CobsEncoder* cobsEncoder;
+CobsDecoder* cobsDecoder;
+Print* frameOutput;
+TxQueue* txQueue;
+
+unsigned long baudRate = DEFAULT_BAUD_RATE;
+unsigned long requestedBaudRate = 0;
+bool persistBaudRate = false;
+bool baudRateConfirmed = true;
+Clock* baudRateTimer;
+
+const Exception* queuedError = NULL;
+char queuedErrorArg[MAX_ERROR_ARG_LENGTH + 1] = "";
+unsigned long queuedErrorFrame = 0;
+
+//An error raised while a batch reply frame is open is sent after the frame ends
+const Exception* deferredError = NULL;
+char deferredErrorArg[MAX_ERROR_ARG_LENGTH + 1] = "";
+
+struct SystemStateSnapshot {
+    char* waterTankNames[MAX_WATER_TANKS];
+    char* waterSourceNames[MAX_WATER_SOURCES];
+    unsigned int totalWaterTanks;
+    unsigned int totalWaterSources;
+    WaterTank* waterTanks[MAX_WATER_TANKS];
+    WaterSource* waterSources[MAX_WATER_SOURCES];
+    unsigned int waterTankHandles[MAX_WATER_TANKS];
+    unsigned int waterSourceHandles[MAX_WATER_SOURCES];
+    unsigned int pressureRawValues[MAX_WATER_TANKS];
+};
+
+SystemStateSnapshot systemStateSnapshot = {};
+
+typedef void (*RequestHandler)();
+
 #ifdef TEST
-byte testResponseBuffer[_TestResponse_size];
 _TestRequest testRequest = _TestRequest_init_zero;
 _TestResponse testResponse = _TestResponse_init_zero;
+
+unsigned int maxQueuedFrames = 0;
+unsigned int rxOverruns = 0;
+unsigned long idleTime = 0; //Microseconds
+unsigned long dutyCycleStartTime = 0;
 #endif
 
 void freeRequestBuffer() {
-    read = 0;
     messageType = 0;
+    messageTruncated = false;
     messageLength = 0;
-    messageLengthBufferReadIndex = 0;
     request = {};
 }
 
+void receiveSerialBytes() {
+    while (apiSerial->available()) {
+        if (rxBuffer->isFull()) {
+            //The rest stays in the serial port buffer, it is lost if that buffer also fills up
+            #ifdef TEST
+            rxOverruns += 1;
+            #endif
+            break;
+        }
+        rxBuffer->write(apiSerial->read());
+        readerTimer->startTimer();
+    }
+}
+
+void sendSerialBytes() {
+    //Only the bytes that fit in the serial port buffer are sent, so the loop is never blocked
+    txQueue->send(apiSerial->availableForWrite());
+}
+
+void sleepUntilInterrupt() {
+    //The idle mode keeps the timers and the serial port running, any of their interrupts wakes the MCU
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    #ifdef TEST
+    unsigned long sleepStartTime = micros();
+    #endif
+    sleep_mode();
+    #ifdef TEST
+    idleTime += micros() - sleepStartTime;
+    #endif
+}
+
+bool readRxBytes(byte* buffer, unsigned int count) {
+    if (framing == SetFraming_Framing_COBS) {
+        //The whole COBS frame is queued, reading past its end means the length field is wrong
+        for (unsigned int i = 0; i < count; i++) {
+            if (!cobsDecoder->read(&buffer[i])) {
+                messageTruncated = true;
+                return false;
+            }
+        }
+        return true;
+    }
+    //A legacy frame is only handled once it is queued, reading past the queued bytes means the length field is wrong
+    for (unsigned int i = 0; i < count; i++) {
+        if (rxBuffer->available() == 0) {
+            messageTruncated = true;
+            return false;
+        }
+        buffer[i] = rxBuffer->read();
+    }
+    return true;
+}
+
+void dropSkippedRxBytes() {
+    //The payload of a rejected frame is dropped while it arrives
+    while (rxBytesToSkip > 0 && rxBuffer->available() > 0) {
+        rxBuffer->read();
+        rxBytesToSkip -= 1;
+    }
+}
+
+bool readRxStream(pb_istream_t* stream, pb_byte_t* buffer, size_t count) {
+    return readRxBytes(buffer, count);
+}
+
+pb_istream_t createRxStream(unsigned int length) {
+    pb_istream_t stream = PB_ISTREAM_EMPTY;
+    stream.callback = &readRxStream;
+    stream.state = rxBuffer;
+    stream.bytes_left = length;
+    return stream;
+}
+
+void skipRxStream(pb_istream_t* stream) {
+    //Drop the rest of the payload to keep the reader in sync with the next message
+    if (!messageTruncated && stream->bytes_left > 0) {
+        pb_read(stream, NULL, stream->bytes_left);
+    }
+}
+
+unsigned int peekRxUInt(unsigned int offset) {
+    return rxBuffer->peek(offset) | (rxBuffer->peek(offset + 1) << 8);
+}
+
+bool isValidFrameHeader(byte type, unsigned int length) {
+    return (type == 4 && length <= MAX_BATCH_MESSAGES) || (type != 4 && length <= MAX_MESSAGE_SIZE);
+}
+
+unsigned int getQueuedFrameSize(unsigned int offset) {
+    //Returns the size of the frame starting at offset in the RX buffer, or 0 when it has not fully arrived
+    unsigned int available = rxBuffer->available() - offset;
+    if (available < FRAME_HEADER_SIZE) {
+        return 0;
+    }
+    unsigned int size = FRAME_HEADER_SIZE;
+    unsigned int length = peekRxUInt(offset + 1);
+    if (rxBuffer->peek(offset) == 4) {
+        for (unsigned int i = 0; i < length; i++) {
+            if (available < size + sizeof(unsigned int)) {
+                return 0;
+            }
+            size += sizeof(unsigned int) + peekRxUInt(offset + size);
+        }
+    } else {
+        size += length;
+    }
+    return available >= size ? size : 0;
+}
+
+bool isQueuedBatchMessageReady() {
+    //A message too large to be a request is answered right away, its payload is dropped while it arrives
+    if (rxBuffer->available() < sizeof(unsigned int)) {
+        return false;
+    }
+    unsigned int length = peekRxUInt(0);
+    return length > Request_size || rxBuffer->available() >= sizeof(unsigned int) + length;
+}
+
+bool isQueuedFrameReady() {
+    //A frame is handled once it has fully arrived and a batch once its header has, its messages are handled
+    //as they arrive. An invalid header is answered right away
+    if (framing == SetFraming_Framing_COBS) {
+        return cobsDecoder->hasFrame();
+    }
+    if (batchMessagesLeft > 0) {
+        return isQueuedBatchMessageReady();
+    }
+    if (rxBuffer->available() < FRAME_HEADER_SIZE) {
+        return false;
+    }
+    byte type = rxBuffer->peek(0);
+    return type == 4 || !isValidFrameHeader(type, peekRxUInt(1)) || getQueuedFrameSize(0) > 0;
+}
+
+#ifdef TEST
+void updateMaxQueuedFrames() {
+    //The RX buffer does not start at a frame while a batch is handled
+    if (framing == SetFraming_Framing_COBS || batchMessagesLeft > 0) {
+        return;
+    }
+    unsigned int queuedFrames = 0;
+    unsigned int frameSize;
+    for (unsigned int offset = 0; (frameSize = getQueuedFrameSize(offset)) > 0; offset += frameSize) {
+        queuedFrames += 1;
+    }
+    maxQueuedFrames = max(maxQueuedFrames, queuedFrames);
+}
+#endif
+
 void freeResponseBuffer() {
     response = {};
+    systemStateSnapshot = {};
 
     #ifdef TEST
     testResponse = {};
     #endif
 }
 
-void sendResponse() {
-    responseStream = pb_ostream_from_buffer(responseBuffer, Response_size);
+bool writeSerialStream(pb_ostream_t* stream, const pb_byte_t* buffer, size_t count) {
+    Print* output = (Print*) stream->state;
+    return output->write(buffer, count) == count;
+}
+
+void beginFrame(byte messageType, TxPriority priority) {
+    txQueue->beginFrame(priority);
+    if (framing == SetFraming_Framing_COBS) {
+        cobsEncoder->beginFrame();
+    }
+    frameOutput->write(messageType);
+}
+
+void endFrame() {
+    if (framing == SetFraming_Framing_COBS) {
+        cobsEncoder->endFrame();
+    }
+    txQueue->endFrame();
+}
 
-    if(!pb_encode(&responseStream, Response_fields, &response)) {
+
+void setFraming(SetFraming_Framing value) {
+    framing = value;
+    requestedFraming = value;
+    cobsDecoder->reset();
+    frameOutput = framing == SetFraming_Framing_COBS ? (Print*) cobsEncoder : (Print*) txQueue;
+}
+
+void writeMessage(const pb_msgdesc_t* fields, const void* message) {
+    //The length prefix is computed beforehand, so the message can be encoded straight to the serial port
+    size_t encodedSize = 0;
+    if (!pb_get_encoded_size(&encodedSize, fields, message)) {
         //TODO: Handle failed to encode response
+        encodedSize = 0;
+    }
+    unsigned int payloadLength = (unsigned int) encodedSize;
+    frameOutput->write((byte*) &payloadLength, sizeof(unsigned int));
+
+    if (encodedSize > 0) {
+        pb_ostream_t stream = PB_OSTREAM_SIZING;
+        stream.callback = &writeSerialStream;
+        stream.state = frameOutput;
+        stream.max_size = encodedSize;
+        pb_encode(&stream, fields, message);
+    }
+}
+
+void sendMessage(byte messageType, const pb_msgdesc_t* fields, const void* message, TxPriority priority) {
+    beginFrame(messageType, priority);
+    writeMessage(fields, message);
+    endFrame();
+}
+
+void sendResponse() {
+    if (batchResponse) {
+        //The batch frame header has already been sent
+        writeMessage(Response_fields, &response);
     } else {
-        apiSerial->write((byte) 1); //API message type
-        unsigned int responseLength = (long unsigned int) responseStream.bytes_written;
-        apiSerial->write((byte*) &responseLength, sizeof(unsigned int));
-        apiSerial->write(responseBuffer, responseLength);
-        apiSerial->flush();
+        sendMessage(1, Response_fields, &response, unsolicitedResponse ? EVENT_PRIORITY : REPLY_PRIORITY); //API message type
     }
 }
 
@@ -100,19 +401,20 @@ void sendErrorResponse(unsigned int requestId, const char* error, char* arg) {
     sendResponse();
 }
 
-void sendErrorResponse(unsigned int requestId, const Exception* error, char* arg) {
+Error_Exception getErrorType(const Exception* error) {
     switch (error->getExceptionType())
     {
     case RUNTIME_ERROR:
-        response.content.error.type = Error_Exception_RUNTIME_ERROR;
-        break;
+        return Error_Exception_RUNTIME_ERROR;
     case INVALID_REQUEST:
-        response.content.error.type = Error_Exception_INVALID_REQUEST;
-        break;
+        return Error_Exception_INVALID_REQUEST;
     default:
-    response.content.error.type = Error_Exception_EXCEPTION;
-        break;
+        return Error_Exception_EXCEPTION;
     }
+}
+
+void sendErrorResponse(unsigned int requestId, const Exception* error, char* arg) {
+    response.content.error.type = getErrorType(error);
     const char* message = ((Exception*) error)->getMessage();
     sendErrorResponse(requestId, message, arg);
 }
@@ -125,138 +427,582 @@ void sendErrorResponse(unsigned int requestId, const char* error) {
     sendErrorResponse(requestId, error, NULL);
 }
 
+void sendUnsolicitedError(const Exception* error, char* arg) {
+    //An error equal to the one still waiting in the TX queue is not queued again
+    if (arg == NULL) {
+        arg = (char*) "";
+    }
+    bool errorQueued = txQueue->getTotalSentFrames(EVENT_PRIORITY) < queuedErrorFrame;
+    if (errorQueued && error == queuedError && strncmp(queuedErrorArg, arg, MAX_ERROR_ARG_LENGTH) == 0) {
+        return;
+    }
+    unsigned long totalFrames = txQueue->getTotalFrames(EVENT_PRIORITY);
+    unsolicitedResponse = true;
+    sendErrorResponse(0, error, arg);
+    unsolicitedResponse = false;
+    freeResponseBuffer();
+    if (txQueue->getTotalFrames(EVENT_PRIORITY) > totalFrames) {
+        queuedError = error;
+        strncpy(queuedErrorArg, arg, MAX_ERROR_ARG_LENGTH);
+        queuedErrorFrame = txQueue->getTotalFrames(EVENT_PRIORITY);
+    }
+}
+
 void sendOkResponse(unsigned int requestId) {
     response.id = requestId;
     response.which_content = Response_message_tag;
     sendResponse();
 }
 
-void handleAPIRequest() {
-    if (request.which_message == Request_createWaterSource_tag) {
-        if (request.message.createWaterSource.has_waterTankName) {
-            api->createWaterSource(request.message.createWaterSource.name, request.message.createWaterSource.pin, 
-                                   request.message.createWaterSource.waterTankName);
-        } else {
-            api->createWaterSource(request.message.createWaterSource.name, request.message.createWaterSource.pin);
+WaterSource* findWaterSource(char* name, unsigned int handle) {
+    //The handle is preferred, the name is only scanned when no handle was sent
+    if (handle != NO_HANDLE) {
+        return api->getWaterSource(handle);
+    }
+    return api->getWaterSource(name);
+}
+
+WaterTank* findWaterTank(char* name, unsigned int handle) {
+    if (handle != NO_HANDLE) {
+        return api->getWaterTank(handle);
+    }
+    return api->getWaterTank(name);
+}
+
+void setHandleValue(unsigned int handle) {
+    if (!Exception::hasException()) {
+        response.content.message.has_value = true;
+        response.content.message.value.which_content = PrimitiveValue_intValue_tag;
+        response.content.message.value.content.intValue = handle;
+    }
+}
+
+void fillWaterSourceState(WaterSourceState* waterSourceState, char* name, unsigned int handle, WaterSource* waterSource) {
+    strncpy(waterSourceState->name, name, MAX_NAME_LENGTH);
+    waterSourceState->handle = handle;
+    waterSourceState->pin = waterSource->getPin();
+    waterSourceState->active = waterSource->isActive();
+    waterSourceState->turnedOn = waterSource->isTurnedOn();
+    if (waterSource->getWaterTank() != NULL) {
+        waterSourceState->has_sourceWaterTank = true;
+        strncpy(waterSourceState->sourceWaterTank, api->getWaterTankName(waterSource->getWaterTank()), MAX_NAME_LENGTH);
+    }
+    WaterTank* owner = api->getWaterSourceOwner(waterSource);
+    if (owner != NULL) {
+        waterSourceState->has_ownerWaterTank = true;
+        strncpy(waterSourceState->ownerWaterTank, api->getWaterTankName(owner), MAX_NAME_LENGTH);
+    }
+}
+
+bool encodeCalibrationRawValues(pb_ostream_t* stream, const pb_field_t* field, void* const* arg) {
+    CalibrationTable* calibration = (CalibrationTable*) *arg;
+    for (byte i = 0; i < calibration->getTotalPoints(); i++) {
+        if (!pb_encode_tag_for_field(stream, field) || !pb_encode_varint(stream, calibration->getRawValue(i))) {
+            return false;
         }
-    } else if (request.which_message == Request_getWaterSourceList_tag) {
-        char** waterSourceList = api->getWaterSourceList();
-        unsigned int totalWaterSources = api->getTotalWaterSources();
-        response.content.message.listValue_count = totalWaterSources;
-        PrimitiveValue value = PrimitiveValue_init_zero;
-        for (unsigned int i = 0; i < totalWaterSources; i++) {
-            value.which_content = PrimitiveValue_stringValue_tag;
-            strncpy(value.content.stringValue, waterSourceList[i], MAX_NAME_LENGTH);
-            response.content.message.listValue[i] = value;
-        }
-        free(waterSourceList);
-    } else if (request.which_message == Request_removeWaterSource_tag) {
-        api->removeWaterSource(request.message.removeWaterSource.waterSourceName);
-    } else if (request.which_message == Request_setWaterSourceState_tag) {
-        api->setWaterSourceState(request.message.setWaterSourceState.waterSourceName, request.message.setWaterSourceState.state,
-                                 request.message.setWaterSourceState.force);
-    } else if (request.which_message == Request_setWaterSourceActive_tag) {
-        api->setWaterSourceActive(request.message.setWaterSourceActive.waterSourceName, request.message.setWaterSourceActive.active);
-    } else if (request.which_message == Request_getWaterSource_tag) {
-        WaterSource* waterSource = api->getWaterSource(request.message.getWaterSource.waterSourceName);
-        if (waterSource != NULL) {
-            response.content.message.has_waterSource = true;
-            WaterSourceState waterSourceState = WaterSourceState_init_zero;
-            strncpy(waterSourceState.name, request.message.getWaterSource.waterSourceName, MAX_NAME_LENGTH);
-            waterSourceState.pin = waterSource->getPin();
-            waterSourceState.active = waterSource->isActive();
-            waterSourceState.turnedOn = waterSource->isTurnedOn();
-            if (waterSource->getWaterTank() != NULL) {
-                waterSourceState.has_sourceWaterTank = true;
-                strncpy(waterSourceState.sourceWaterTank, api->getWaterTankName(waterSource->getWaterTank()), MAX_NAME_LENGTH);
-            }
-            response.content.message.waterSource = waterSourceState;
-        }
-    } if (request.which_message == Request_createWaterTank_tag) {
-        if (request.message.createWaterTank.has_waterSourceName) {
-            api->createWaterTank(request.message.createWaterTank.name, request.message.createWaterTank.pressureSensorPin, 
-                                 request.message.createWaterTank.volumeFactor, request.message.createWaterTank.pressureFactor,
-                                 request.message.createWaterTank.pressureChangingValue,
-                                 request.message.createWaterTank.waterSourceName);
-        } else {
-            api->createWaterTank(request.message.createWaterTank.name, request.message.createWaterTank.pressureSensorPin,
-                                 request.message.createWaterTank.volumeFactor, request.message.createWaterTank.pressureFactor,
-                                 request.message.createWaterTank.pressureChangingValue);
+    }
+    return true;
+}
+
+bool encodeCalibrationVolumes(pb_ostream_t* stream, const pb_field_t* field, void* const* arg) {
+    CalibrationTable* calibration = (CalibrationTable*) *arg;
+    for (byte i = 0; i < calibration->getTotalPoints(); i++) {
+        float volume = calibration->getVolume(i);
+        if (!pb_encode_tag_for_field(stream, field) || !pb_encode_fixed32(stream, &volume)) {
+            return false;
         }
-        if (!Exception::hasException()) {
-            api->setWaterTankMinimumVolume(request.message.createWaterTank.name, request.message.createWaterTank.minimumVolume);
-            api->setWaterTankMaxVolume(request.message.createWaterTank.name, request.message.createWaterTank.maxVolume);
-            api->setWaterZeroVolume(request.message.createWaterTank.name, request.message.createWaterTank.zeroVolumePressure);
-        }
-    } else if (request.which_message == Request_getWaterTankList_tag) {
-        char** waterTankList = api->getWaterTankList();
-        unsigned int totalWaterTanks = api->getTotalWaterTanks();
-        response.content.message.listValue_count = totalWaterTanks;
-        PrimitiveValue value = PrimitiveValue_init_zero;
-        for (unsigned int i = 0; i < totalWaterTanks; i++) {
-            value.which_content = PrimitiveValue_stringValue_tag;
-            strncpy(value.content.stringValue, waterTankList[i], MAX_NAME_LENGTH);
-            response.content.message.listValue[i] = value;
-        }
-        free(waterTankList);
-    } else if (request.which_message == Request_removeWaterTank_tag) {
-        api->removeWaterTank(request.message.removeWaterTank.waterTankName);
-    } else if (request.which_message == Request_getWaterTank_tag) {
-        WaterTank* waterTank = api->getWaterTank(request.message.getWaterTank.waterTankName);
-        if (waterTank != NULL) {
-            response.content.message.has_waterTank = true;
-            WaterTankState waterTankState = WaterTankState_init_zero;
-            strncpy(waterTankState.name, request.message.getWaterTank.waterTankName, MAX_NAME_LENGTH);
-            waterTankState.pressureSensorPin = waterTank->getPressureSensorPin();
-            waterTankState.filling = waterTank->isFilling();
-            waterTankState.active = waterTank->isActive();
-            waterTankState.volumeFactor = waterTank->volumeFactor;
-            waterTankState.pressureFactor = waterTank->pressureFactor;
-            waterTankState.minimumVolume = waterTank->minimumVolume;
-            waterTankState.maxVolume = waterTank->maxVolume;
-            waterTankState.zeroVolumePressure = waterTank->zeroVolumePressure;
-            waterTankState.pressureChangingValue = waterTank->pressureChangingValue;
-            waterTankState.rawPressureValue = waterTank->getPressureRawValue();
-            waterTankState.pressure = waterTank->getPressure();
-            waterTankState.volume = waterTank->getVolume();
-            if (waterTank->getWaterSource() != NULL) {
-                waterTankState.has_waterSource = true;
-                strncpy(waterTankState.waterSource, api->getWaterSourceName(waterTank->getWaterSource()), MAX_NAME_LENGTH);
-            }
-            response.content.message.waterTank = waterTankState;
-        }
-    } else if (request.which_message == Request_setWaterTankMinimumVolume_tag) {
-        api->setWaterTankMinimumVolume(request.message.setWaterTankMinimumVolume.waterTankName, request.message.setWaterTankMinimumVolume.value);
-    } else if (request.which_message == Request_setWaterTankMaxVolume_tag) {
-        api->setWaterTankMaxVolume(request.message.setWaterTankMaxVolume.waterTankName, request.message.setWaterTankMaxVolume.value);
-    } else if (request.which_message == Request_setWaterTankZeroVolume_tag) {
-        api->setWaterZeroVolume(request.message.setWaterTankZeroVolume.waterTankName, request.message.setWaterTankZeroVolume.value);
-    } else if (request.which_message == Request_setWaterTankVolumeFactor_tag) {
-        api->setWaterTankVolumeFactor(request.message.setWaterTankVolumeFactor.waterTankName, request.message.setWaterTankVolumeFactor.value);
-    } else if (request.which_message == Request_setWaterTankPressureFactor_tag) {
-        api->setWaterTankPressureFactor(request.message.setWaterTankPressureFactor.waterTankName, request.message.setWaterTankPressureFactor.value);
-    } else if (request.which_message == Request_setWaterTankPressureChangingValue_tag) {
-        api->setWaterTankPressureChangingValue(request.message.setWaterTankPressureChangingValue.waterTankName, request.message.setWaterTankPressureChangingValue.value);
-    } else if (request.which_message == Request_setWaterTankActive_tag) {
-        api->setWaterTankActive(request.message.setWaterTankActive.waterTankName, request.message.setWaterTankActive.active);
-    } else if (request.which_message == Request_fillWaterTank_tag) {
-        api->fillWaterTank(request.message.fillWaterTank.waterTankName, request.message.fillWaterTank.enabled, request.message.fillWaterTank.force);
-    } else if (request.which_message == Request_setMode_tag) {
-        api->setOperationMode(request.message.setMode.mode);
-    } else if (request.which_message == Request_getMode_tag) {
-        byte mode = api->getOperationMode();
-        if (!Exception::hasException()) {
-            response.content.message.has_value = true;
-            response.content.message.value.which_content = PrimitiveValue_intValue_tag;
-            response.content.message.value.content.intValue = mode;
-        }
-    } else if (request.which_message == Request_save_tag) {
-        Persister::save(api);
-    } else if (request.which_message == Request_reset_tag) {
-        api->reset();
+    }
+    return true;
+}
+
+void fillWaterTankState(WaterTankState* waterTankState, char* name, unsigned int handle, WaterTank* waterTank,
+                        unsigned int pressureRawValue) {
+    strncpy(waterTankState->name, name, MAX_NAME_LENGTH);
+    waterTankState->handle = handle;
+    waterTankState->pressureSensorPin = waterTank->getPressureSensorPin();
+    waterTankState->filling = waterTank->isFilling();
+    waterTankState->active = waterTank->isActive();
+    waterTankState->volumeFactor = waterTank->getVolumeFactor();
+    waterTankState->pressureFactor = waterTank->getPressureFactor();
+    waterTankState->minimumVolume = waterTank->getMinimumVolume();
+    waterTankState->maxVolume = waterTank->getMaxVolume();
+    waterTankState->zeroVolumePressure = waterTank->getZeroVolumePressure();
+    waterTankState->pressureChangingValue = waterTank->getPressureChangingValue();
+    waterTankState->filterType = (SetWaterTankFilter_FilterType) waterTank->getFilterType();
+    waterTankState->filterWindow = waterTank->getFilterWindow();
+    waterTankState->oversampling = waterTank->getOversampling();
+    //The calibration points are encoded straight from the table
+    if (waterTank->getCalibration() != NULL) {
+        waterTankState->calibrationRawValues.funcs.encode = &encodeCalibrationRawValues;
+        waterTankState->calibrationRawValues.arg = waterTank->getCalibration();
+        waterTankState->calibrationVolumes.funcs.encode = &encodeCalibrationVolumes;
+        waterTankState->calibrationVolumes.arg = waterTank->getCalibration();
+    }
+    waterTankState->rawPressureValue = pressureRawValue;
+    waterTankState->pressure = waterTank->getPressure(pressureRawValue);
+    waterTankState->volume = waterTank->getVolume(pressureRawValue);
+    waterTankState->flowRate = waterTank->getFlowRate();
+    waterTankState->expectedFillRate = waterTank->getExpectedFillRate();
+    waterTankState->controlMode = (SetWaterTankControl_ControlMode) waterTank->getControlMode();
+    waterTankState->lowerBand = waterTank->getLowerBand();
+    waterTankState->upperBand = waterTank->getUpperBand();
+    waterTankState->settleLag = waterTank->getSettleLag();
+    waterTankState->fillCycles = waterTank->getFillCycles();
+    waterTankState->lastDayFillCycles = waterTank->getLastDayFillCycles();
+    waterTankState->priorityWeight = waterTank->getPriorityWeight();
+    waterTankState->timeToMaxVolume = waterTank->getTimeToMaxVolume(pressureRawValue);
+    waterTankState->timeToMinimumVolume = waterTank->getTimeToMinimumVolume(pressureRawValue);
+    if (waterTank->getWaterSource() != NULL) {
+        waterTankState->has_waterSource = true;
+        strncpy(waterTankState->waterSource, api->getWaterSourceName(waterTank->getWaterSource()), MAX_NAME_LENGTH);
+    }
+}
+
+bool encodeWaterTankStates(pb_ostream_t* stream, const pb_field_t* field, void* const* arg) {
+    //Called twice per response (sizing and encoding), so it must only use the sampled values
+    SystemStateSnapshot* snapshot = (SystemStateSnapshot*) *arg;
+    WaterTankState waterTankState;
+    for (unsigned int i = 0; i < snapshot->totalWaterTanks; i++) {
+        waterTankState = WaterTankState_init_zero;
+        fillWaterTankState(&waterTankState, snapshot->waterTankNames[i], snapshot->waterTankHandles[i], snapshot->waterTanks[i],
+                           snapshot->pressureRawValues[i]);
+        if (!pb_encode_tag_for_field(stream, field) || !pb_encode_submessage(stream, WaterTankState_fields, &waterTankState)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool encodeWaterSourceStates(pb_ostream_t* stream, const pb_field_t* field, void* const* arg) {
+    //Called twice per response too, the water sources were looked up once by the snapshot
+    SystemStateSnapshot* snapshot = (SystemStateSnapshot*) *arg;
+    WaterSourceState waterSourceState;
+    for (unsigned int i = 0; i < snapshot->totalWaterSources; i++) {
+        waterSourceState = WaterSourceState_init_zero;
+        fillWaterSourceState(&waterSourceState, snapshot->waterSourceNames[i], snapshot->waterSourceHandles[i],
+                             snapshot->waterSources[i]);
+        if (!pb_encode_tag_for_field(stream, field) || !pb_encode_submessage(stream, WaterSourceState_fields, &waterSourceState)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void handleCreateWaterSource() {
+    unsigned int handle;
+    if (request.message.createWaterSource.has_waterTankName || request.message.createWaterSource.waterTankHandle != NO_HANDLE) {
+        WaterTank* waterTank = findWaterTank(request.message.createWaterSource.waterTankName, request.message.createWaterSource.waterTankHandle);
+        handle = api->createWaterSource(request.message.createWaterSource.name, request.message.createWaterSource.pin, waterTank);
+    } else {
+        handle = api->createWaterSource(request.message.createWaterSource.name, request.message.createWaterSource.pin);
+    }
+    setHandleValue(handle);
+}
+
+static_assert(pb_arraysize(Value, listValue) >= MAX_WATER_SOURCES && pb_arraysize(Value, listValue) >= MAX_WATER_TANKS,
+              "The listValue max_count must fit every resource");
+
+void handleGetWaterSourceList() {
+    char* waterSourceList[MAX_WATER_SOURCES];
+    api->getWaterSourceList(waterSourceList);
+    unsigned int totalWaterSources = api->getTotalWaterSources();
+    response.content.message.listValue_count = totalWaterSources;
+    PrimitiveValue value = PrimitiveValue_init_zero;
+    for (unsigned int i = 0; i < totalWaterSources; i++) {
+        value.which_content = PrimitiveValue_stringValue_tag;
+        strncpy(value.content.stringValue, waterSourceList[i], MAX_NAME_LENGTH);
+        response.content.message.listValue[i] = value;
+    }
+}
+
+void handleRemoveWaterSource() {
+    WaterSource* waterSource = findWaterSource(request.message.removeWaterSource.waterSourceName,
+                                               request.message.removeWaterSource.waterSourceHandle);
+    api->removeWaterSource(waterSource);
+}
+
+void handleSetWaterSourceState() {
+    WaterSource* waterSource = findWaterSource(request.message.setWaterSourceState.waterSourceName,
+                                               request.message.setWaterSourceState.waterSourceHandle);
+    api->setWaterSourceState(waterSource, request.message.setWaterSourceState.state, request.message.setWaterSourceState.force);
+}
+
+void handleSetWaterSourceActive() {
+    WaterSource* waterSource = findWaterSource(request.message.setWaterSourceActive.waterSourceName,
+                                               request.message.setWaterSourceActive.waterSourceHandle);
+    api->setWaterSourceActive(waterSource, request.message.setWaterSourceActive.active);
+}
+
+void handleGetWaterSource() {
+    WaterSource* waterSource = findWaterSource(request.message.getWaterSource.waterSourceName,
+                                               request.message.getWaterSource.waterSourceHandle);
+    if (waterSource != NULL) {
+        response.content.message.has_waterSource = true;
+        WaterSourceState waterSourceState = WaterSourceState_init_zero;
+        char* name = api->getWaterSourceName(waterSource);
+        fillWaterSourceState(&waterSourceState, name, api->getWaterSourceHandle(name), waterSource);
+        response.content.message.waterSource = waterSourceState;
+    }
+}
+
+void handleCreateWaterTank() {
+    unsigned int handle;
+    if (request.message.createWaterTank.has_waterSourceName || request.message.createWaterTank.waterSourceHandle != NO_HANDLE) {
+        WaterSource* waterSource = findWaterSource(request.message.createWaterTank.waterSourceName,
+                                                   request.message.createWaterTank.waterSourceHandle);
+        handle = api->createWaterTank(request.message.createWaterTank.name, request.message.createWaterTank.pressureSensorPin, 
+                                      request.message.createWaterTank.volumeFactor, request.message.createWaterTank.pressureFactor,
+                                      request.message.createWaterTank.pressureChangingValue, waterSource);
+    } else {
+        handle = api->createWaterTank(request.message.createWaterTank.name, request.message.createWaterTank.pressureSensorPin,
+                                      request.message.createWaterTank.volumeFactor, request.message.createWaterTank.pressureFactor,
+                                      request.message.createWaterTank.pressureChangingValue);
+    }
+    if (!Exception::hasException()) {
+        WaterTank* waterTank = api->getWaterTank(handle);
+        api->setWaterTankMinimumVolume(waterTank, request.message.createWaterTank.minimumVolume);
+        api->setWaterTankMaxVolume(waterTank, request.message.createWaterTank.maxVolume);
+        api->setWaterZeroVolume(waterTank, request.message.createWaterTank.zeroVolumePressure);
+    }
+    setHandleValue(handle);
+}
+
+void handleGetWaterTankList() {
+    char* waterTankList[MAX_WATER_TANKS];
+    api->getWaterTankList(waterTankList);
+    unsigned int totalWaterTanks = api->getTotalWaterTanks();
+    response.content.message.listValue_count = totalWaterTanks;
+    PrimitiveValue value = PrimitiveValue_init_zero;
+    for (unsigned int i = 0; i < totalWaterTanks; i++) {
+        value.which_content = PrimitiveValue_stringValue_tag;
+        strncpy(value.content.stringValue, waterTankList[i], MAX_NAME_LENGTH);
+        response.content.message.listValue[i] = value;
+    }
+}
+
+void handleRemoveWaterTank() {
+    WaterTank* waterTank = findWaterTank(request.message.removeWaterTank.waterTankName, request.message.removeWaterTank.waterTankHandle);
+    api->removeWaterTank(waterTank);
+}
+
+void handleGetWaterTank() {
+    WaterTank* waterTank = findWaterTank(request.message.getWaterTank.waterTankName, request.message.getWaterTank.waterTankHandle);
+    if (waterTank != NULL) {
+        response.content.message.has_waterTank = true;
+        WaterTankState waterTankState = WaterTankState_init_zero;
+        char* name = api->getWaterTankName(waterTank);
+        fillWaterTankState(&waterTankState, name, api->getWaterTankHandle(name), waterTank, waterTank->getPressureRawValue());
+        response.content.message.waterTank = waterTankState;
+    }
+}
+
+void handleSetWaterTankMinimumVolume() {
+    WaterTank* waterTank = findWaterTank(request.message.setWaterTankMinimumVolume.waterTankName, request.message.setWaterTankMinimumVolume.waterTankHandle);
+    api->setWaterTankMinimumVolume(waterTank, request.message.setWaterTankMinimumVolume.value);
+}
+
+void handleSetWaterTankMaxVolume() {
+    WaterTank* waterTank = findWaterTank(request.message.setWaterTankMaxVolume.waterTankName, request.message.setWaterTankMaxVolume.waterTankHandle);
+    api->setWaterTankMaxVolume(waterTank, request.message.setWaterTankMaxVolume.value);
+}
+
+void handleSetWaterTankZeroVolume() {
+    WaterTank* waterTank = findWaterTank(request.message.setWaterTankZeroVolume.waterTankName, request.message.setWaterTankZeroVolume.waterTankHandle);
+    api->setWaterZeroVolume(waterTank, request.message.setWaterTankZeroVolume.value);
+}
+
+void handleSetWaterTankVolumeFactor() {
+    WaterTank* waterTank = findWaterTank(request.message.setWaterTankVolumeFactor.waterTankName, request.message.setWaterTankVolumeFactor.waterTankHandle);
+    api->setWaterTankVolumeFactor(waterTank, request.message.setWaterTankVolumeFactor.value);
+}
+
+void handleSetWaterTankPressureFactor() {
+    WaterTank* waterTank = findWaterTank(request.message.setWaterTankPressureFactor.waterTankName, request.message.setWaterTankPressureFactor.waterTankHandle);
+    api->setWaterTankPressureFactor(waterTank, request.message.setWaterTankPressureFactor.value);
+}
+
+void handleSetWaterTankPressureChangingValue() {
+    WaterTank* waterTank = findWaterTank(request.message.setWaterTankPressureChangingValue.waterTankName, request.message.setWaterTankPressureChangingValue.waterTankHandle);
+    api->setWaterTankPressureChangingValue(waterTank, request.message.setWaterTankPressureChangingValue.value);
+}
+
+void handleSetWaterTankActive() {
+    WaterTank* waterTank = findWaterTank(request.message.setWaterTankActive.waterTankName, request.message.setWaterTankActive.waterTankHandle);
+    api->setWaterTankActive(waterTank, request.message.setWaterTankActive.active);
+}
+
+void handleSetWaterTankFilter() {
+    SetWaterTankFilter* filter = &request.message.setWaterTankFilter;
+    WaterTank* waterTank = findWaterTank(filter->waterTankName, filter->waterTankHandle);
+    //The values are narrowed to bytes, a larger value is refused instead of wrapping around
+    if (waterTank != NULL && ((uint32_t) filter->type > 0xFF || filter->window > 0xFF || filter->oversampling > 0xFF)) {
+        return Exception::throwException(&INVALID_FILTER);
+    }
+    api->setWaterTankFilter(waterTank, filter->type, filter->window, filter->oversampling);
+}
+
+static_assert(pb_arraysize(SetWaterTankCalibration, rawValues) == MAX_CALIBRATION_POINTS &&
+              pb_arraysize(SetWaterTankCalibration, volumes) == MAX_CALIBRATION_POINTS,
+              "The calibration request must fit every calibration point");
+
+void handleSetWaterTankCalibration() {
+    SetWaterTankCalibration* calibration = &request.message.setWaterTankCalibration;
+    WaterTank* waterTank = findWaterTank(calibration->waterTankName, calibration->waterTankHandle);
+    if (waterTank != NULL && calibration->rawValues_count != calibration->volumes_count) {
+        return Exception::throwException(&INVALID_CALIBRATION);
+    }
+    unsigned int rawValues[MAX_CALIBRATION_POINTS];
+    for (pb_size_t i = 0; i < calibration->rawValues_count; i++) {
+        rawValues[i] = calibration->rawValues[i];
+    }
+    api->setWaterTankCalibration(waterTank, rawValues, calibration->volumes, calibration->rawValues_count);
+}
+
+void handleSetWaterTankControl() {
+    SetWaterTankControl* control = &request.message.setWaterTankControl;
+    WaterTank* waterTank = findWaterTank(control->waterTankName, control->waterTankHandle);
+    api->setWaterTankControl(waterTank, min((uint32_t) control->mode, 0xFFUL), control->lowerBand, control->upperBand);
+}
+
+void handleSetWaterTankPriority() {
+    SetWaterTankPriority* priority = &request.message.setWaterTankPriority;
+    WaterTank* waterTank = findWaterTank(priority->waterTankName, priority->waterTankHandle);
+    if (waterTank != NULL && priority->weight > 0xFF) {
+        return Exception::throwException(&INVALID_PRIORITY);
+    }
+    api->setWaterTankPriority(waterTank, priority->weight);
+}
+
+void handleFillWaterTank() {
+    WaterTank* waterTank = findWaterTank(request.message.fillWaterTank.waterTankName, request.message.fillWaterTank.waterTankHandle);
+    api->fillWaterTank(waterTank, request.message.fillWaterTank.enabled, request.message.fillWaterTank.force);
+}
+
+void handleSetMode() {
+    api->setOperationMode(request.message.setMode.mode);
+}
+
+void handleGetMode() {
+    byte mode = api->getOperationMode();
+    if (!Exception::hasException()) {
+        response.content.message.has_value = true;
+        response.content.message.value.which_content = PrimitiveValue_intValue_tag;
+        response.content.message.value.content.intValue = mode;
+    }
+}
+
+void handleGetSystemState() {
+    SystemStateSnapshot* snapshot = &systemStateSnapshot;
+    snapshot->totalWaterTanks = api->getTotalWaterTanks();
+    snapshot->totalWaterSources = api->getTotalWaterSources();
+    api->getWaterTankList(snapshot->waterTankNames);
+    api->getWaterSourceList(snapshot->waterSourceNames);
+    //Each resource is looked up and each pressure sensor is sampled once, the same values are used to size and to
+    //encode the response
+    for (unsigned int i = 0; i < snapshot->totalWaterTanks; i++) {
+        snapshot->waterTanks[i] = api->getWaterTank(snapshot->waterTankNames[i]);
+        snapshot->waterTankHandles[i] = api->getWaterTankHandle(snapshot->waterTankNames[i]);
+        snapshot->pressureRawValues[i] = snapshot->waterTanks[i]->getPressureRawValue();
+    }
+    for (unsigned int i = 0; i < snapshot->totalWaterSources; i++) {
+        snapshot->waterSources[i] = api->getWaterSource(snapshot->waterSourceNames[i]);
+        snapshot->waterSourceHandles[i] = api->getWaterSourceHandle(snapshot->waterSourceNames[i]);
+    }
+
+    SystemState* systemState = &response.content.message.systemState;
+    response.content.message.has_systemState = true;
+    systemState->waterTanks.funcs.encode = &encodeWaterTankStates;
+    systemState->waterTanks.arg = snapshot;
+    systemState->waterSources.funcs.encode = &encodeWaterSourceStates;
+    systemState->waterSources.arg = snapshot;
+    systemState->mode = api->getOperationMode();
+
+    char* waterTankName = NULL;
+    const Exception* error = api->getPendingError(&waterTankName);
+    if (error != NULL) {
+        systemState->has_error = true;
+        systemState->error.type = getErrorType(error);
+        strncpy(systemState->error.message, error->getMessage(), MAX_ERROR_LENGTH);
+        strncpy(systemState->error.arg, waterTankName, MAX_ERROR_ARG_LENGTH);
+    }
+}
+
+void handleSubscribe() {
+    api->subscribe(request.message.subscribe.minimumInterval, request.message.subscribe.volumeDeadband);
+}
+
+void handleUnsubscribe() {
+    api->unsubscribe();
+}
+
+void handleSave() {
+    Persister::save(api);
+}
+
+void handleSetFraming() {
+    //The framing changes once the response has been sent
+    if (request.message.setFraming.framing == SetFraming_Framing_LEGACY || request.message.setFraming.framing == SetFraming_Framing_COBS) {
+        requestedFraming = request.message.setFraming.framing;
+        //The queued frames use the current framing, they must be sent before the response
+        txQueue->flush();
+    } else {
+        Exception::throwException(&INVALID_FRAMING);
+    }
+}
+
+bool isSupportedBaudRate(unsigned long value) {
+    for (byte i = 0; i < sizeof(SUPPORTED_BAUD_RATES) / sizeof(unsigned long); i++) {
+        if (SUPPORTED_BAUD_RATES[i] == value) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void setBaudRate(unsigned long value) {
+    //The queued frames are sent at the current baud rate before it changes
+    txQueue->flush();
+    apiSerial->flush();
+    apiSerial->end();
+    apiSerial->begin(value);
+    //The bytes received while switching are garbage
+    rxBuffer->clear();
+    cobsDecoder->reset();
+
+    baudRate = value;
+    requestedBaudRate = 0;
+    baudRateConfirmed = value == DEFAULT_BAUD_RATE;
+    baudRateTimer->startTimer();
+}
+
+void confirmBaudRate() {
+    //Called for each request received from the client, the requests loaded from the EEPROM do not count
+    if (!baudRateConfirmed) {
+        baudRateConfirmed = true;
+        if (persistBaudRate) {
+            Persister::saveBaudRate(baudRate);
+        }
+    }
+    persistBaudRate = false;
+}
+
+void handleSetBaudRate() {
+    //The baud rate changes once the response has been sent
+    if (isSupportedBaudRate(request.message.setBaudRate.baudRate)) {
+        requestedBaudRate = request.message.setBaudRate.baudRate;
+        persistBaudRate = request.message.setBaudRate.persist;
+    } else {
+        Exception::throwException(&INVALID_BAUD_RATE);
+    }
+}
+
+void handleReset() {
+    api->reset();
+    #ifdef TEST
+    IOInterface::setSource(VIRTUAL);
+    #endif
+}
+
+//Handlers indexed by the Request message tag, starting at FIRST_REQUEST_TAG. They must follow the tags order
+constexpr RequestHandler requestHandlers[] PROGMEM = {
+    &handleCreateWaterSource,
+    &handleGetWaterSourceList,
+    &handleRemoveWaterSource,
+    &handleSetWaterSourceState,
+    &handleSetWaterSourceActive,
+    &handleGetWaterSource,
+    &handleCreateWaterTank,
+    &handleGetWaterTankList,
+    &handleRemoveWaterTank,
+    &handleGetWaterTank,
+    &handleSetWaterTankMinimumVolume,
+    &handleSetWaterTankMaxVolume,
+    &handleSetWaterTankZeroVolume,
+    &handleSetWaterTankVolumeFactor,
+    &handleSetWaterTankPressureFactor,
+    &handleSetWaterTankPressureChangingValue,
+    &handleSetWaterTankActive,
+    &handleFillWaterTank,
+    &handleSetMode,
+    &handleGetMode,
+    &handleSave,
+    &handleReset,
+    &handleGetSystemState,
+    &handleSubscribe,
+    &handleUnsubscribe,
+    &handleSetFraming,
+    &handleSetBaudRate,
+    &handleSetWaterTankFilter,
+    &handleSetWaterTankCalibration,
+    &handleSetWaterTankControl,
+    &handleSetWaterTankPriority
+};
+
+const pb_size_t FIRST_REQUEST_TAG = Request_createWaterSource_tag;
+const pb_size_t TOTAL_REQUEST_HANDLERS = sizeof(requestHandlers) / sizeof(RequestHandler);
+
+static_assert(FIRST_REQUEST_TAG + TOTAL_REQUEST_HANDLERS - 1 == Request_setWaterTankPriority_tag, "Every Request tag must have a handler");
+
+#ifdef TEST
+unsigned int requestDispatchCounts[TOTAL_REQUEST_HANDLERS] = {};
+#endif
+
+RequestHandler getRequestHandler(const RequestHandler* handlers, pb_size_t totalHandlers, pb_size_t firstTag, pb_size_t tag) {
+    if (tag < firstTag || tag - firstTag >= totalHandlers) {
+        return NULL;
+    }
+    return (RequestHandler) pgm_read_ptr(&handlers[tag - firstTag]);
+}
+
+void handleAPIRequest() {
+    RequestHandler handler = getRequestHandler(requestHandlers, TOTAL_REQUEST_HANDLERS, FIRST_REQUEST_TAG, request.which_message);
+    if (handler != NULL) {
         #ifdef TEST
-        IOInterface::source = VIRTUAL;
+        requestDispatchCounts[request.which_message - FIRST_REQUEST_TAG] += 1;
         #endif
+        handler();
+    }
+}
+
+void sendNotifications() {
+    Event event;
+    Notification notification;
+    char* resourceName;
+    //The resync event goes before the changes raised after the overflow
+    if (Notifier::hasOverflowed() && txQueue->canQueue(EVENT_PRIORITY, MAX_EVENT_FRAME_SIZE)) {
+        event = Event_init_zero;
+        event.type = Event_Type_RESYNC;
+        sendMessage(5, Event_fields, &event, EVENT_PRIORITY); //Event message type
+        Notifier::clearOverflow();
+    }
+    //The notifications wait in the Notifier, where they are coalesced, while the TX queue is full
+    while (Notifier::hasNotification() && txQueue->canQueue(EVENT_PRIORITY, MAX_EVENT_FRAME_SIZE)) {
+        notification = Notifier::popNotification();
+        event = Event_init_zero;
+        event.value = notification.value;
+        resourceName = NULL;
+        switch (notification.type)
+        {
+        case WATER_SOURCE_STATE_CHANGED:
+            event.type = Event_Type_WATER_SOURCE_STATE;
+            resourceName = api->getWaterSourceName((WaterSource*) notification.resource);
+            break;
+        case WATER_TANK_ACTIVE_CHANGED:
+            event.type = Event_Type_WATER_TANK_ACTIVE;
+            resourceName = api->getWaterTankName((WaterTank*) notification.resource);
+            break;
+        case WATER_TANK_VOLUME_CHANGED:
+            event.type = Event_Type_WATER_TANK_VOLUME;
+            resourceName = api->getWaterTankName((WaterTank*) notification.resource);
+            break;
+        default:
+            event.type = Event_Type_OPERATION_MODE;
+            break;
+        }
+        if (resourceName != NULL) {
+            strncpy(event.resource, resourceName, MAX_NAME_LENGTH);
+        }
+        sendMessage(5, Event_fields, &event, EVENT_PRIORITY); //Event message type
     }
 }
 
@@ -277,21 +1023,89 @@ void loadAPIDataFromEEPROM() {
     }
 }
 
-#ifdef TEST
-void sendTestResponse() {
-    responseStream = pb_ostream_from_buffer(testResponseBuffer, _TestResponse_size);
+void closeBatch() {
+    batchResponse = false;
+    endFrame();
+}
 
-    if(!pb_encode(&responseStream, _TestResponse_fields, &testResponse)) {
-        //TODO: Handle failed to encode response
+void openBatch(unsigned int totalMessages) {
+    beginFrame(4, REPLY_PRIORITY); //Batch message type
+    frameOutput->write((byte*) &totalMessages, sizeof(unsigned int));
+    batchResponse = true;
+    batchMessagesLeft = totalMessages;
+    if (batchMessagesLeft == 0) {
+        closeBatch();
+    }
+}
+
+void handleBatchMessage() {
+    unsigned int requestLength = 0;
+    if (!messageTruncated) {
+        readRxBytes((byte*) &requestLength, sizeof(unsigned int));
+    }
+
+    requestStream = createRxStream(requestLength);
+    if (messageTruncated) {
+        //Every message must be answered, even the ones that have not arrived
+        sendErrorResponse(0, "Truncated message received");
+    } else if (requestLength > Request_size) {
+        if (framing == SetFraming_Framing_COBS) {
+            skipRxStream(&requestStream);
+        } else {
+            rxBytesToSkip = requestLength;
+        }
+        sendErrorResponse(0, "Invalid message");
+    } else if (!pb_decode(&requestStream, Request_fields, &request)) {
+        skipRxStream(&requestStream);
+        if (messageTruncated) {
+            sendErrorResponse(0, "Truncated message received");
+        } else {
+            sendErrorResponse(0, "Failed to decode the request");
+        }
     } else {
-        apiSerial->write((byte) 2); //Test message type
-        unsigned int responseLength = (long unsigned int) responseStream.bytes_written;
-        apiSerial->write((byte*) &responseLength, sizeof(unsigned int));
-        apiSerial->write(testResponseBuffer, responseLength);
-        apiSerial->flush();
+        confirmBaudRate();
+        handleAPIRequest();
+        if (!Exception::hasException()) {
+            sendOkResponse(request.id);
+        } else {
+            const Exception* exception = Exception::popException();
+            sendErrorResponse(request.id, exception);
+        }
+    }
+
+    request = {};
+    freeResponseBuffer();
+    batchMessagesLeft -= 1;
+    if (batchMessagesLeft == 0) {
+        closeBatch();
     }
 }
 
+void dropTruncatedFrame() {
+    bool frameRejected = rxBytesToSkip > 0;
+    rxBytesToSkip = 0;
+    if (batchMessagesLeft > 0) {
+        //Every message must be answered, even the ones that have not arrived
+        while (batchMessagesLeft > 0) {
+            sendErrorResponse(0, "Truncated message received");
+            freeResponseBuffer();
+            batchMessagesLeft -= 1;
+        }
+        closeBatch();
+    } else if (!frameRejected) {
+        //The rejected frame has already been answered
+        sendErrorResponse(0, "Truncated message received");
+        freeResponseBuffer();
+    }
+    rxBuffer->clear();
+    cobsDecoder->reset();
+}
+
+#ifdef TEST
+void sendTestResponse() {
+    sendMessage(2, _TestResponse_fields, &testResponse, REPLY_PRIORITY); //Test message type
+}
+
 void sendErrorTestResponse(unsigned int requestId, const char* error) {
     testResponse.id = requestId;
     testResponse.error = true;
@@ -314,154 +1128,426 @@ void sendOkTestResponse(unsigned int requestId, int message) {
     sendTestResponse();
 }
 
-void handleTestRequest() {
-    if (testRequest.which_message == _TestRequest_createIO_tag) {
-        IOInterface* io = IOInterface::get(testRequest.message.createIO.pin);
-        if (io == NULL) {
-            IOType type;
-            if (testRequest.message.createIO.type == _TestCreateIO_IOType_DIGITAL) {
-                type = DIGITAL;
-            } else if (testRequest.message.createIO.type == _TestCreateIO_IOType_ANALOGIC) {
-                type = ANALOGIC;
-            }
-            io = new IOInterface(testRequest.message.createIO.pin, READ_WRITE, type);
-            sendOkTestResponse(testRequest.id);
-        } else {
-            sendErrorTestResponse(testRequest.id, "TestIO already set with that pin");
-        }
-    } else if (testRequest.which_message == _TestRequest_setIOValue_tag) {
-        IOInterface* io = IOInterface::get(testRequest.message.setIOValue.pin);
-        if (io == NULL) {
-            sendErrorTestResponse(testRequest.id, "TestIO with that pin does not exist");
-        } else {
-            io->write(testRequest.message.setIOValue.value);
-            sendOkTestResponse(testRequest.id);
+void handleTestCreateIO() {
+    IOInterface* io = IOInterface::get(testRequest.message.createIO.pin);
+    if (io == NULL) {
+        IOType type;
+        if (testRequest.message.createIO.type == _TestCreateIO_IOType_DIGITAL) {
+            type = DIGITAL;
+        } else if (testRequest.message.createIO.type == _TestCreateIO_IOType_ANALOGIC) {
+            type = ANALOGIC;
         }
-    } else if (testRequest.which_message == _TestRequest_getIOValue_tag) {
-        IOInterface* io = IOInterface::get(testRequest.message.getIOValue.pin);
-        if (io == NULL) {
-            sendErrorTestResponse(testRequest.id, "TestIO with that pin does not exist");
-        } else {
-            testResponse.has_message = true;
-            testResponse.message.which_value = _TestResponseValue_intValue_tag;
-            testResponse.message.value.intValue = io->read(); 
-            sendOkTestResponse(testRequest.id);
-        }
-    } else if (testRequest.which_message == _TestRequest_clearIOs_tag) {
-        IOInterface::removeAll();
+        io = new IOInterface(testRequest.message.createIO.pin, READ_WRITE, type);
         sendOkTestResponse(testRequest.id);
-    } else if (testRequest.which_message == _TestRequest_freeMemory_tag) {
-        sendOkTestResponse(testRequest.id, freeMemory());
-    } else if (testRequest.which_message == _TestRequest_setClockOffset_tag) {
-        Clock::setClockOffset(testRequest.message.setClockOffset.value);
+    } else {
+        sendErrorTestResponse(testRequest.id, "TestIO already set with that pin");
+    }
+}
+
+void handleTestSetIOValue() {
+    IOInterface* io = IOInterface::get(testRequest.message.setIOValue.pin);
+    if (io == NULL) {
+        sendErrorTestResponse(testRequest.id, "TestIO with that pin does not exist");
+    } else {
+        io->write(testRequest.message.setIOValue.value);
         sendOkTestResponse(testRequest.id);
-    } else if (testRequest.which_message == _TestRequest_getMillis_tag) {
+    }
+}
+
+void handleTestGetIOValue() {
+    IOInterface* io = IOInterface::get(testRequest.message.getIOValue.pin);
+    if (io == NULL) {
+        sendErrorTestResponse(testRequest.id, "TestIO with that pin does not exist");
+    } else {
         testResponse.has_message = true;
-        testResponse.message.which_value = _TestResponseValue_uintValue_tag;
-        testResponse.message.value.uintValue = Clock::currentMillis(); 
+        testResponse.message.which_value = _TestResponseValue_intValue_tag;
+        testResponse.message.value.intValue = io->read(); 
         sendOkTestResponse(testRequest.id);
-    } else if (testRequest.which_message == _TestRequest_resetClock_tag) {
-        Clock::setClockOffset(0);
+    }
+}
+
+void handleTestClearIOs() {
+    IOInterface::removeAll();
+    sendOkTestResponse(testRequest.id);
+}
+
+void handleTestFreeMemory() {
+    sendOkTestResponse(testRequest.id, freeMemory());
+}
+
+void handleTestSetClockOffset() {
+    Clock::setClockOffset(testRequest.message.setClockOffset.value);
+    sendOkTestResponse(testRequest.id);
+}
+
+void handleTestGetMillis() {
+    testResponse.has_message = true;
+    testResponse.message.which_value = _TestResponseValue_uintValue_tag;
+    testResponse.message.value.uintValue = Clock::currentMillis(); 
+    sendOkTestResponse(testRequest.id);
+}
+
+void handleTestResetClock() {
+    Clock::setClockOffset(0);
+    sendOkTestResponse(testRequest.id);
+}
+
+void handleTestSetIOSource() {
+    if (testRequest.message.setIOSource.source == _TestSetIOSource_IOSource_VIRTUAL) {
+        IOInterface::setSource(VIRTUAL);
+    } else if (testRequest.message.setIOSource.source == _TestSetIOSource_IOSource_PHYSICAL) {
+        IOInterface::setSource(PHYSICAL);
+    }
+    sendOkTestResponse(testRequest.id);
+}
+
+void handleTestLoadAPIFromEEPROM() {
+    loadAPIDataFromEEPROM();
+    if (!Exception::hasException()) {
         sendOkTestResponse(testRequest.id);
-    }  else if (testRequest.which_message == _TestRequest_setIOSource_tag) {
-        if (testRequest.message.setIOSource.source == _TestSetIOSource_IOSource_VIRTUAL) {
-            IOInterface::source = VIRTUAL; 
-        } else if (testRequest.message.setIOSource.source == _TestSetIOSource_IOSource_PHYSICAL) {
-            IOInterface::source = PHYSICAL;
+    } else {
+        sendErrorTestResponse(testRequest.id, Exception::popException()->getMessage());
+    }
+}
+
+template <typename T, byte N>
+unsigned int getPoolCounter(Pool<T, N>* pool, _TestGetCounter_Counter counter) {
+    if (counter == _TestGetCounter_Counter_POOL_USAGE) {
+        return pool->getUsed();
+    } else if (counter == _TestGetCounter_Counter_POOL_MAX_USAGE) {
+        return pool->getMaxUsed();
+    }
+    return pool->getCapacity();
+}
+
+void handleTestGetCounter() {
+    unsigned int index = testRequest.message.getCounter.index;
+    unsigned int value;
+    if (testRequest.message.getCounter.counter == _TestGetCounter_Counter_REQUEST_DISPATCHES) {
+        if (index < FIRST_REQUEST_TAG || index - FIRST_REQUEST_TAG >= TOTAL_REQUEST_HANDLERS) {
+            return sendErrorTestResponse(testRequest.id, "Invalid counter index");
         }
-        sendOkTestResponse(testRequest.id);
-    } else if (testRequest.which_message == _TestRequest_loadAPIFromEEPROM_tag) {
-        loadAPIDataFromEEPROM();
-        if (!Exception::hasException()) {
-            sendOkTestResponse(testRequest.id);
+        value = requestDispatchCounts[index - FIRST_REQUEST_TAG];
+    } else if (testRequest.message.getCounter.counter == _TestGetCounter_Counter_MAX_QUEUED_FRAMES) {
+        value = maxQueuedFrames;
+    } else if (testRequest.message.getCounter.counter == _TestGetCounter_Counter_RX_OVERRUNS) {
+        value = rxOverruns;
+    } else if (testRequest.message.getCounter.counter == _TestGetCounter_Counter_TX_DROPS) {
+        value = txQueue->getDroppedFrames();
+    } else if (testRequest.message.getCounter.counter == _TestGetCounter_Counter_POOL_USAGE ||
+               testRequest.message.getCounter.counter == _TestGetCounter_Counter_POOL_MAX_USAGE ||
+               testRequest.message.getCounter.counter == _TestGetCounter_Counter_POOL_CAPACITY) {
+        if (index == _TestGetCounter_Pool_WATER_TANK_POOL) {
+            value = getPoolCounter(&WaterTank::pool, testRequest.message.getCounter.counter);
+        } else if (index == _TestGetCounter_Pool_WATER_SOURCE_POOL) {
+            value = getPoolCounter(&WaterSource::pool, testRequest.message.getCounter.counter);
+        } else if (index == _TestGetCounter_Pool_IO_INTERFACE_POOL) {
+            value = getPoolCounter(&IOInterface::pool, testRequest.message.getCounter.counter);
         } else {
-            sendErrorTestResponse(testRequest.id, Exception::popException()->getMessage());
+            return sendErrorTestResponse(testRequest.id, "Invalid counter index");
+        }
+    } else if (testRequest.message.getCounter.counter == _TestGetCounter_Counter_NOTIFICATION_DROPS) {
+        value = Notifier::getDroppedNotifications();
+    } else if (testRequest.message.getCounter.counter == _TestGetCounter_Counter_MAX_ADC_READS_PER_LOOP) {
+        //Most sensor reads of a manager loop since the last reading
+        value = IOInterface::popMaxSamplingReads();
+    } else if (testRequest.message.getCounter.counter == _TestGetCounter_Counter_DUTY_CYCLE) {
+        //Per mille of the time the MCU was awake since the last reading
+        unsigned long currentTime = micros();
+        unsigned long elapsedTime = currentTime - dutyCycleStartTime;
+        value = elapsedTime > 0 ? ((elapsedTime - min(idleTime, elapsedTime)) * 1000ULL) / elapsedTime : 0;
+        dutyCycleStartTime = currentTime;
+        idleTime = 0;
+    } else {
+        return sendErrorTestResponse(testRequest.id, "Invalid counter");
+    }
+    testResponse.has_message = true;
+    testResponse.message.which_value = _TestResponseValue_uintValue_tag;
+    testResponse.message.value.uintValue = value;
+    sendOkTestResponse(testRequest.id);
+}
+
+void handleTestBenchmarkLookup() {
+    //Average time in nanoseconds to find a resource by its name and the name by the resource
+    unsigned int totalWaterSources = api->getTotalWaterSources();
+    unsigned int totalWaterTanks = api->getTotalWaterTanks();
+    if (totalWaterSources + totalWaterTanks == 0) {
+        return sendErrorTestResponse(testRequest.id, "There are no resources to look up");
+    }
+    char* waterSourceList[MAX_WATER_SOURCES];
+    char* waterTankList[MAX_WATER_TANKS];
+    api->getWaterSourceList(waterSourceList);
+    api->getWaterTankList(waterTankList);
+    uint32_t iterations = max((uint32_t) 1, testRequest.message.benchmarkLookup.iterations);
+
+    unsigned long startTime = micros();
+    for (uint32_t n = 0; n < iterations; n++) {
+        for (unsigned int i = 0; i < totalWaterSources; i++) {
+            api->getWaterSourceName(api->getWaterSource(waterSourceList[i]));
+        }
+        for (unsigned int i = 0; i < totalWaterTanks; i++) {
+            api->getWaterTankName(api->getWaterTank(waterTankList[i]));
         }
     }
+    unsigned long elapsedTime = micros() - startTime;
+
+    testResponse.has_message = true;
+    testResponse.message.which_value = _TestResponseValue_uintValue_tag;
+    testResponse.message.value.uintValue = (elapsedTime * 1000) / (iterations * (totalWaterSources + totalWaterTanks));
+    sendOkTestResponse(testRequest.id);
+}
+
+void handleTestBenchmarkWaterTankLoop() {
+    //Average CPU cycles of a water tank loop, the pressure sensor is sampled again in every loop
+    unsigned int totalWaterTanks = api->getTotalWaterTanks();
+    if (totalWaterTanks == 0) {
+        return sendErrorTestResponse(testRequest.id, "There are no water tanks to run");
+    }
+    char* waterTankList[MAX_WATER_TANKS];
+    api->getWaterTankList(waterTankList);
+    WaterTank* waterTanks[MAX_WATER_TANKS];
+    for (unsigned int i = 0; i < totalWaterTanks; i++) {
+        waterTanks[i] = api->getWaterTank(waterTankList[i]);
+    }
+    uint32_t iterations = max((uint32_t) 1, testRequest.message.benchmarkWaterTankLoop.iterations);
+    unsigned long currentTime = Clock::currentMillis();
+
+    unsigned long startTime = micros();
+    for (uint32_t n = 0; n < iterations; n++) {
+        IOInterface::startSampling(currentTime);
+        for (unsigned int i = 0; i < totalWaterTanks; i++) {
+            waterTanks[i]->loop(currentTime);
+        }
+    }
+    unsigned long elapsedTime = micros() - startTime;
+    //The water tanks errors are reported by the manager loop
+    Exception::clearException();
+
+    testResponse.has_message = true;
+    testResponse.message.which_value = _TestResponseValue_uintValue_tag;
+    testResponse.message.value.uintValue = (elapsedTime * clockCyclesPerMicrosecond()) / (iterations * totalWaterTanks);
+    sendOkTestResponse(testRequest.id);
+}
+
+constexpr RequestHandler testRequestHandlers[] PROGMEM = {
+    &handleTestCreateIO,
+    &handleTestSetIOValue,
+    &handleTestGetIOValue,
+    &handleTestClearIOs,
+    &handleTestFreeMemory,
+    &handleTestSetClockOffset,
+    &handleTestGetMillis,
+    &handleTestSetIOSource,
+    &handleTestLoadAPIFromEEPROM,
+    &handleTestResetClock,
+    &handleTestGetCounter,
+    &handleTestBenchmarkLookup,
+    &handleTestBenchmarkWaterTankLoop
+};
+
+const pb_size_t FIRST_TEST_REQUEST_TAG = _TestRequest_createIO_tag;
+const pb_size_t TOTAL_TEST_REQUEST_HANDLERS = sizeof(testRequestHandlers) / sizeof(RequestHandler);
+
+static_assert(FIRST_TEST_REQUEST_TAG + TOTAL_TEST_REQUEST_HANDLERS - 1 == _TestRequest_benchmarkWaterTankLoop_tag, "Every _TestRequest tag must have a handler");
+
+void handleTestRequest() {
+    RequestHandler handler = getRequestHandler(testRequestHandlers, TOTAL_TEST_REQUEST_HANDLERS, FIRST_TEST_REQUEST_TAG,
+                                               testRequest.which_message);
+    if (handler != NULL) {
+        handler();
+    }
 }
 #endif
 
 void setup() {
-    apiSerial->begin(9600);
+    baudRate = Persister::getBaudRate();
+    if (!isSupportedBaudRate(baudRate)) {
+        baudRate = DEFAULT_BAUD_RATE;
+    }
+    apiSerial->begin(baudRate);
     apiSerial->setTimeout(READ_TIMEOUT);
     api = new API();
     readerTimer = new Clock();
+    requestsTimer = new Clock();
+    baudRateTimer = new Clock();
+    baudRateConfirmed = baudRate == DEFAULT_BAUD_RATE;
+    baudRateTimer->startTimer();
+    rxBuffer = new RingBuffer(RX_BUFFER_SIZE);
+    txQueue = new TxQueue(apiSerial, TX_REPLY_BUFFER_SIZE, TX_EVENT_BUFFER_SIZE, MAX_TX_FRAMES);
+    frameOutput = txQueue;
+    cobsEncoder = new CobsEncoder(txQueue);
+    cobsDecoder = new CobsDecoder(rxBuffer);
+
+    #ifndef TEST
+    //The test build starts it when the physical IO is selected
+    AnalogSampler::start();
+    #endif
 
     loadAPIDataFromEEPROM();
     
     if (Exception::hasException()) {
-        sendErrorResponse(0, Exception::popException());
-        freeResponseBuffer();
+        sendUnsolicitedError(Exception::popException(), NULL);
         Persister::clearEEPROM();
     }
 }
 
-void loop() {
-    if (apiSerial->available()) {
-        if (messageType == 0) {
-            messageType = apiSerial->read();
-        } else if (messageLengthBufferReadIndex < 2) {
-            messageLengthBuffer[messageLengthBufferReadIndex] = apiSerial->read();
-            messageLengthBufferReadIndex += 1;
-            if (messageLengthBufferReadIndex == 2) {
-                messageLength = *((unsigned int*) &messageLengthBuffer);
-                if (messageLength > MAX_MESSAGE_SIZE) {
-                    sendErrorResponse(0, "Invalid message");
-                    freeRequestBuffer();
-                }
-            }
-        } else if (read < messageLength) {
-            requestBuffer[read] = apiSerial->read();
-            read += 1;
+void handleFrame() {
+    readRxBytes(&messageType, sizeof(byte));
+    readRxBytes((byte*) &messageLength, sizeof(unsigned int));
+
+    if (!isValidFrameHeader(messageType, messageLength)) {
+        if (framing == SetFraming_Framing_LEGACY) {
+            //The payload would be parsed as the next frames. The length of a batch payload is unknown, so its
+            //bytes are dropped until the link is quiet for READ_TIMEOUT
+            rxBytesToSkip = messageType == 4 ? 0xFFFF : messageLength;
         }
-        readerTimer->startTimer();
+        sendErrorResponse(0, "Invalid message");
+        return;
     }
 
-    if (read != 0 && read == messageLength) {
-        requestStream = pb_istream_from_buffer(requestBuffer, messageLength);
-        if (messageType == 1) {
-            if(!pb_decode(&requestStream, Request_fields, &request)) {
+    requestStream = createRxStream(messageLength);
+    if (messageType == 1) {
+        if(!pb_decode(&requestStream, Request_fields, &request)) {
+            skipRxStream(&requestStream);
+            if (messageTruncated) {
+                sendErrorResponse(0, "Truncated message received");
+            } else {
                 sendErrorResponse(0, "Failed to decode the request");
+            }
+        } else {
+            confirmBaudRate();
+            handleAPIRequest();
+            if (!Exception::hasException()) {
+                sendOkResponse(request.id);
             } else {
-                handleAPIRequest();
-                if (!Exception::hasException()) {
-                    sendOkResponse(request.id);
-                } else {
-                    const Exception* exception = Exception::popException();
-                    sendErrorResponse(request.id, exception);
-                }
+                const Exception* exception = Exception::popException();
+                sendErrorResponse(request.id, exception);
             }
         }
-        #ifdef TEST
-        else if (messageType == 2) {
-            if(!pb_decode(&requestStream, _TestRequest_fields, &testRequest)) {
-                sendErrorTestResponse(0, "Failed to decode the request");
+    }
+    else if (messageType == 4) {
+        openBatch(messageLength);
+        if (framing == SetFraming_Framing_COBS) {
+            //The whole COBS frame is queued
+            while (batchMessagesLeft > 0) {
+                handleBatchMessage();
+            }
+        }
+    }
+    #ifdef TEST
+    else if (messageType == 2) {
+        if(!pb_decode(&requestStream, _TestRequest_fields, &testRequest)) {
+            skipRxStream(&requestStream);
+            if (messageTruncated) {
+                sendErrorResponse(0, "Truncated message received");
             } else {
-                handleTestRequest();
+                sendErrorTestResponse(0, "Failed to decode the request");
             }
+        } else {
+            confirmBaudRate();
+            handleTestRequest();
         }
-        #endif
-        else {
+    }
+    #endif
+    else {
+        skipRxStream(&requestStream);
+        if (messageTruncated) {
+            sendErrorResponse(0, "Truncated message received");
+        } else {
             sendErrorResponse(0, "Invalid message type");
         }
+    }
+}
 
+void handleCobsFrame() {
+    if (!cobsDecoder->isFrameValid()) {
+        cobsDecoder->dropFrame();
+        sendErrorResponse(0, "Corrupted message received");
+        return;
+    }
+    cobsDecoder->beginFrame();
+    if (cobsDecoder->getFrameLength() < FRAME_HEADER_SIZE) {
+        sendErrorResponse(0, "Invalid message");
+    } else {
+        handleFrame();
+    }
+    cobsDecoder->dropFrame();
+}
+
+void loop() {
+    receiveSerialBytes();
+    sendSerialBytes();
+    #ifdef TEST
+    updateMaxQueuedFrames();
+    #endif
+
+    requestsTimer->startTimer();
+    dropSkippedRxBytes();
+    while (rxBuffer->available() > 0 && rxBytesToSkip == 0 && requestsTimer->getElapsedTime() < REQUESTS_TIME_BUDGET) {
+        if (!isQueuedFrameReady()) {
+            if (framing == SetFraming_Framing_COBS && rxBuffer->isFull()) {
+                cobsDecoder->dropOversizedFrame();
+                sendErrorResponse(0, "Invalid message");
+                freeResponseBuffer();
+            }
+            break;
+        }
+        if (framing == SetFraming_Framing_COBS) {
+            handleCobsFrame();
+        } else if (batchMessagesLeft > 0) {
+            handleBatchMessage();
+        } else {
+            handleFrame();
+        }
+        //The request may have changed the water tanks, so they are run in this loop instead of at their deadlines
+        api->wakeUp();
         freeRequestBuffer();
         freeResponseBuffer();
-    } else if (messageType != 0 && readerTimer->getElapsedTime() >= READ_TIMEOUT) {
-        sendErrorResponse(0, "Truncated message received");
-        freeRequestBuffer();
-        freeResponseBuffer();
+        //A batch is answered at the current framing and baud rate
+        if (batchMessagesLeft == 0 && requestedFraming != framing) {
+            setFraming(requestedFraming);
+        }
+        if (batchMessagesLeft == 0 && requestedBaudRate != 0) {
+            setBaudRate(requestedBaudRate);
+        }
+        receiveSerialBytes();
+        sendSerialBytes();
+        dropSkippedRxBytes();
+    }
+
+    bool frameWaiting = rxBuffer->available() > 0 || batchMessagesLeft > 0 || rxBytesToSkip > 0;
+    if (frameWaiting && !isQueuedFrameReady() && readerTimer->getElapsedTime() >= READ_TIMEOUT) {
+        dropTruncatedFrame();
     }
   
+    if (!baudRateConfirmed && baudRateTimer->getElapsedTime() >= BAUD_RATE_TIMEOUT) {
+        setBaudRate(DEFAULT_BAUD_RATE);
+    }
+
     api->loop();
 
     if (Exception::hasException()) {
         const Exception* exception = Exception::popException();
         char* exceptionArg = Exception::popExceptionArg();
-        // do not try to send errors when the other side can't receive  
-        if (apiSerial->availableForWrite()) {
-            sendErrorResponse(0, exception, exceptionArg);
-            freeResponseBuffer();
+        if (batchMessagesLeft > 0) {
+            deferredError = exception;
+            strncpy(deferredErrorArg, exceptionArg != NULL ? exceptionArg : "", MAX_ERROR_ARG_LENGTH);
+        } else {
+            sendUnsolicitedError(exception, exceptionArg);
+        }
+    }
+
+    //The TX queue holds a single open frame, so nothing else is queued while a batch reply is open
+    if (batchMessagesLeft == 0) {
+        if (deferredError != NULL) {
+            sendUnsolicitedError(deferredError, deferredErrorArg);
+            deferredError = NULL;
         }
+        sendNotifications();
+    }
+    sendSerialBytes();
+
+    if (rxBuffer->available() == 0 && apiSerial->available() == 0) {
+        sleepUntilInterrupt();
     }
 }
@@ -15,6 +15,7 @@ os.environ['PYTHONUNBUFFERED'] = '1'
 sys.path.append(PROJECT_ROOT)  # Add project to PYTHONPATH
 
 from .lib.api import APIClient
+from .lib.api.models import Framing
 from .lib.api.arduino import ArduinoConnection
 
 
@@ -55,6 +56,13 @@ async def clear_eeprom(api_client: APIClient):
     await api_client.save()
 
 
+@pytest.fixture
+async def cobs_framing(api_client: APIClient):
+    await api_client.set_framing(Framing.COBS)
+    yield
+    await api_client.set_framing(Framing.LEGACY)
+
+
 @pytest.fixture(scope='session')
 def arduino_connection():
     yield ArduinoConnection(port=ARDUINO_PORT)
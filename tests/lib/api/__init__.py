@@ -10,7 +10,7 @@ import collections
 from typing import Dict
 
 try:
-    from protobuf.out.python.api_pb2 import Request, Response
+    from protobuf.out.python.api_pb2 import Request, Response, Event
 except ImportError:
     # This module was done just for testing on Pytest and it cannot be import outside.
     # FIXME: Handling for GUI lib
@@ -21,13 +21,15 @@ except ImportError:
     sys.modules[spec.name] = api_pb2 
     spec.loader.exec_module(api_pb2)
 
-    from api_pb2 import Request, Response
+    from api_pb2 import Request, Response, Event
 
 
-from .models import OperationMode, IOType, IOSource
+from .models import OperationMode, IOType, IOSource, EventType, Counter, Framing, FilterType, ControlMode
+from . import cobs
 from .response import APIResponse, APIErrorResponse
 from .exceptions import APIException
 from .volatile_queue import VolatileQueue
+from .arduino import DEFAULT_BAUDRATE
 
 try:
     from ...test_protobuf.test_pb2 import _TestRequest, _TestResponse
@@ -45,6 +47,8 @@ except ImportError:
 
 
 PACKET_FORMAT = '<BH'
+BATCH_MESSAGE_TYPE = 4
+EVENT_MESSAGE_TYPE = 5
 LOGGER = logging.getLogger(__name__)
 
 
@@ -55,6 +59,7 @@ class APIClient:
     REQUEST_ID_ITERATOR = itertools.cycle(range(1, 65535))
     DEFAULT_REQUEST_TIMEOUT = 7
     FUTURE_ALLOCATE_TIMEOUT = 100
+    BAUD_RATE_CONFIRM_TIMEOUT = 2
     REQUEST_MESSAGE_TYPES = {Request: 1, _TestRequest: 2} 
 
     def __init__(self, arduino_connection, event_loop: asyncio.ProactorEventLoop = None, timeout=DEFAULT_REQUEST_TIMEOUT):
@@ -69,26 +74,30 @@ class APIClient:
         self._timeout_tasks = []
 
         self._unmapped_error_responses = VolatileQueue()
+        self._events = VolatileQueue()
 
         self._clock_offset = 0
 
+        self._framing = Framing.LEGACY
+        self._framing_requests = dict()
+
     def __del__(self):
         self.close()
 
     def create_water_source(self, name: str, pin: int, water_tank_name: str = None, return_exceptions=False):
-        return self.send_request('createWaterSource', name=name, pin=pin, waterTankName=water_tank_name, return_exceptions=return_exceptions)
+        return self.send_request('createWaterSource', name=name, pin=pin, **self._resource_param('waterTank', water_tank_name), return_exceptions=return_exceptions)
 
     def get_water_source(self, name: str, return_exceptions=False) -> dict:
-        return self.send_request('getWaterSource', waterSourceName=name, return_exceptions=return_exceptions)
+        return self.send_request('getWaterSource', **self._resource_param('waterSource', name), return_exceptions=return_exceptions)
 
     def set_water_source_state(self, name: str, enabled: bool, force: bool=False, return_exceptions=False):
-        return self.send_request('setWaterSourceState', waterSourceName=name, state=enabled, force=force, return_exceptions=return_exceptions)
+        return self.send_request('setWaterSourceState', **self._resource_param('waterSource', name), state=enabled, force=force, return_exceptions=return_exceptions)
 
     def set_water_source_active(self, name: str, active: bool, return_exceptions=False):
-        return self.send_request('setWaterSourceActive', waterSourceName=name, active=active, return_exceptions=return_exceptions)
+        return self.send_request('setWaterSourceActive', **self._resource_param('waterSource', name), active=active, return_exceptions=return_exceptions)
 
     def remove_water_source(self, name: str, return_exceptions=False):
-        return self.send_request('removeWaterSource', waterSourceName=name, return_exceptions=return_exceptions)
+        return self.send_request('removeWaterSource', **self._resource_param('waterSource', name), return_exceptions=return_exceptions)
 
     def get_water_source_list(self, return_exceptions=False) -> list:
         return self.send_request('getWaterSourceList', response_type=list, return_exceptions=return_exceptions)
@@ -99,40 +108,60 @@ class APIClient:
         return self.send_request('createWaterTank', name=name, pressureSensorPin=pressure_sensor_pin, volumeFactor=volume_factor,
                                  minimumVolume=min_volume, maxVolume=max_volume, zeroVolumePressure=zero_volume_pressure, 
                                  pressureChangingValue=presure_changing_value, pressureFactor=pressure_factor,
-                                 waterSourceName=water_source_name, return_exceptions=return_exceptions)
+                                 **self._resource_param('waterSource', water_source_name), return_exceptions=return_exceptions)
 
     def remove_water_tank(self, name: str, return_exceptions=False):
-        return self.send_request('removeWaterTank', waterTankName=name, return_exceptions=return_exceptions)
+        return self.send_request('removeWaterTank', **self._resource_param('waterTank', name), return_exceptions=return_exceptions)
     
     def set_water_tank_minimum_volume(self, name: str, value: float, return_exceptions=False):
-        return self.send_request('setWaterTankMinimumVolume', waterTankName=name, value=value, return_exceptions=return_exceptions)
+        return self.send_request('setWaterTankMinimumVolume', **self._resource_param('waterTank', name), value=value, return_exceptions=return_exceptions)
     
     def set_water_tank_max_volume(self, name: str, value: float, return_exceptions=False):
-        return self.send_request('setWaterTankMaxVolume', waterTankName=name, value=value, return_exceptions=return_exceptions)
+        return self.send_request('setWaterTankMaxVolume', **self._resource_param('waterTank', name), value=value, return_exceptions=return_exceptions)
     
     def set_water_tank_zero_volume_pressure(self, name: str, value: float, return_exceptions=False):
-        return self.send_request('setWaterTankZeroVolume', waterTankName=name, value=value, return_exceptions=return_exceptions)
+        return self.send_request('setWaterTankZeroVolume', **self._resource_param('waterTank', name), value=value, return_exceptions=return_exceptions)
 
     def set_water_tank_volume_factor(self, name: str, value: float, return_exceptions=False):
-        return self.send_request('setWaterTankVolumeFactor', waterTankName=name, value=value, return_exceptions=return_exceptions)
+        return self.send_request('setWaterTankVolumeFactor', **self._resource_param('waterTank', name), value=value, return_exceptions=return_exceptions)
     
     def set_water_tank_pressure_factor(self, name: str, value: float, return_exceptions=False):
-        return self.send_request('setWaterTankPressureFactor', waterTankName=name, value=value, return_exceptions=return_exceptions)
+        return self.send_request('setWaterTankPressureFactor', **self._resource_param('waterTank', name), value=value, return_exceptions=return_exceptions)
 
     def set_water_tank_pressure_changing_value(self, name: str, value: float, return_exceptions=False):
-        return self.send_request('setWaterTankPressureChangingValue', waterTankName=name, value=value, return_exceptions=return_exceptions)
+        return self.send_request('setWaterTankPressureChangingValue', **self._resource_param('waterTank', name), value=value, return_exceptions=return_exceptions)
+
+    def set_water_tank_filter(self, name: str, filter_type: FilterType, window: int = 1, oversampling: int = 1,
+                              return_exceptions=False):
+        return self.send_request('setWaterTankFilter', **self._resource_param('waterTank', name), type=filter_type.value,
+                                 window=window, oversampling=oversampling, return_exceptions=return_exceptions)
+
+    def set_water_tank_calibration(self, name: str, points: list, return_exceptions=False):
+        raw_values = [raw_value for raw_value, _ in points]
+        volumes = [volume for _, volume in points]
+        return self.send_request('setWaterTankCalibration', **self._resource_param('waterTank', name), rawValues=raw_values,
+                                 volumes=volumes, return_exceptions=return_exceptions)
+
+    def set_water_tank_control(self, name: str, mode: ControlMode, lower_band: float = 0, upper_band: float = 0,
+                               return_exceptions=False):
+        return self.send_request('setWaterTankControl', **self._resource_param('waterTank', name), mode=mode.value,
+                                 lowerBand=lower_band, upperBand=upper_band, return_exceptions=return_exceptions)
+
+    def set_water_tank_priority(self, name: str, weight: int, return_exceptions=False):
+        return self.send_request('setWaterTankPriority', **self._resource_param('waterTank', name), weight=weight,
+                                 return_exceptions=return_exceptions)
 
     def get_water_tank_list(self, return_exceptions=False) -> list:
         return self.send_request('getWaterTankList', response_type=list, return_exceptions=return_exceptions)
     
     def get_water_tank(self, name: str, return_exceptions=False) -> dict:
-        return self.send_request('getWaterTank', waterTankName=name, return_exceptions=return_exceptions)
+        return self.send_request('getWaterTank', **self._resource_param('waterTank', name), return_exceptions=return_exceptions)
 
     def fill_water_tank(self, name: str, enabled: bool, force: bool=False, return_exceptions=False):
-        return self.send_request('fillWaterTank', waterTankName=name, enabled=enabled, force=force, return_exceptions=return_exceptions)
+        return self.send_request('fillWaterTank', **self._resource_param('waterTank', name), enabled=enabled, force=force, return_exceptions=return_exceptions)
 
     def set_water_tank_active(self, name: str, active: bool, return_exceptions=False):
-        return self.send_request('setWaterTankActive', waterTankName=name, active=active, return_exceptions=return_exceptions)
+        return self.send_request('setWaterTankActive', **self._resource_param('waterTank', name), active=active, return_exceptions=return_exceptions)
 
     def set_operation_mode(self, mode: OperationMode, return_exceptions=False):
         return self.send_request('setMode', mode=mode.value, return_exceptions=return_exceptions)
@@ -142,6 +171,33 @@ class APIClient:
             return OperationMode(value) if value else OperationMode.MANUAL
         return self.send_request('getMode', response_type=_operation_mode_factory, return_exceptions=return_exceptions)
 
+    def get_system_state(self, return_exceptions=False) -> dict:
+        return self.send_request('getSystemState', return_exceptions=return_exceptions)
+
+    def subscribe(self, minimum_interval: int = 1000, volume_deadband: float = 1, return_exceptions=False):
+        return self.send_request('subscribe', minimumInterval=minimum_interval, volumeDeadband=volume_deadband,
+                                 return_exceptions=return_exceptions)
+
+    def unsubscribe(self, return_exceptions=False):
+        return self.send_request('unsubscribe', return_exceptions=return_exceptions)
+
+    def set_framing(self, framing: Framing, return_exceptions=False):
+        # The platform answers with the current framing and switches right after, so the client switches
+        # when that response is read
+        request_id = next(APIClient.REQUEST_ID_ITERATOR)
+        self._framing_requests[request_id] = framing
+        return self.send_request('setFraming', request_id=request_id, framing=framing, return_exceptions=return_exceptions)
+
+    async def set_baud_rate(self, baud_rate: int, persist: bool = False):
+        await self.send_request('setBaudRate', baudRate=baud_rate, persist=persist)
+        await self._arduino_connection.set_baudrate(baud_rate)
+        # The platform goes back to the default baud rate when no valid request arrives at the new one in time
+        try:
+            await asyncio.wait_for(self.get_operation_mode(), timeout=self.BAUD_RATE_CONFIRM_TIMEOUT)
+        except asyncio.TimeoutError:
+            await self._arduino_connection.set_baudrate(DEFAULT_BAUDRATE)
+            raise
+
     def save(self, return_exceptions=False):
         return self.send_request('save', return_exceptions=return_exceptions)
 
@@ -179,6 +235,18 @@ class APIClient:
         self._clock_offset = 0
         return self.send_request('resetClock', request_class=_TestRequest, return_exceptions=return_exceptions)
 
+    def get_counter(self, counter: Counter, index: int = 0, return_exceptions=False) -> int:
+        return self.send_request('getCounter', counter=counter, index=index, request_class=_TestRequest, response_type=int,
+                                 return_exceptions=return_exceptions)
+
+    def benchmark_lookup(self, iterations: int, return_exceptions=False) -> int:
+        return self.send_request('benchmarkLookup', iterations=iterations, request_class=_TestRequest, response_type=int,
+                                 return_exceptions=return_exceptions)
+
+    def benchmark_water_tank_loop(self, iterations: int, return_exceptions=False) -> int:
+        return self.send_request('benchmarkWaterTankLoop', iterations=iterations, request_class=_TestRequest,
+                                 response_type=int, return_exceptions=return_exceptions)
+
     def set_timeout(self, timeout):
         self._timeout = timeout
 
@@ -202,28 +270,47 @@ class APIClient:
         self._unmapped_error_responses.task_done()
         return response
 
+    async def get_event(self) -> dict:
+        event = await self._events.get()
+        self._events.task_done()
+        return event
+
     async def _read_responses_routine(self):
         while True:
             raw_response = await self.read_response()
-            if raw_response:
-                response = APIResponse.parse(raw_response)
-                future_response = self._future_responses.get(response.id)
-                if future_response is not None:
-                    future, response_type = future_response
-                    if not isinstance(response, APIErrorResponse):
-                        message = response.message
-                        if response_type:
-                            message = response_type(message) if message else response_type()
-                        future.set_result(message)
-                    else:
-                        exc = response.exception_type(response.message, response.arg, response)
-                        future.set_exception(exc)
-                elif not isinstance(response, APIErrorResponse):
-                    LOGGER.warning('Got Response without mapped request!')
-                    LOGGER.warning(f'Response message: {response.message}')
-                else:
-                    LOGGER.error(f'{response.message} :: {response.arg}')
-                    await self._unmapped_error_responses.put(response)
+            if isinstance(raw_response, Event):
+                event = {'type': EventType(raw_response.type), 'resource': raw_response.resource, 'value': raw_response.value}
+                await self._events.put(event)
+                continue
+            # a batch frame holds one response for each request in the batch
+            raw_responses = raw_response if isinstance(raw_response, list) else [raw_response]
+            for raw_response in raw_responses:
+                await self._handle_response(raw_response)
+
+    async def _handle_response(self, raw_response):
+        if not raw_response:
+            return
+        response = APIResponse.parse(raw_response)
+        framing = self._framing_requests.pop(response.id, None)
+        if framing is not None and not isinstance(response, APIErrorResponse):
+            self._framing = framing
+        future_response = self._future_responses.get(response.id)
+        if future_response is not None:
+            future, response_type = future_response
+            if not isinstance(response, APIErrorResponse):
+                message = response.message
+                if response_type:
+                    message = response_type(message) if message else response_type()
+                future.set_result(message)
+            else:
+                exc = response.exception_type(response.message, response.arg, response)
+                future.set_exception(exc)
+        elif not isinstance(response, APIErrorResponse):
+            LOGGER.warning('Got Response without mapped request!')
+            LOGGER.warning(f'Response message: {response.message}')
+        else:
+            LOGGER.error(f'{response.message} :: {response.arg}')
+            await self._unmapped_error_responses.put(response)
 
     async def _request_timeout_routine(self, request_id, timeout):
         future, _ = self._future_responses[request_id]
@@ -237,6 +324,12 @@ class APIClient:
         except APIException:
             pass
 
+    async def send_batch(self, requests, return_exceptions=False) -> list:
+        payload = self.build_batch_request_wrapper(requests)
+        futures = await self.send_batch_payload(payload, [request.id for request in requests])
+        gather = asyncio.gather(*futures, return_exceptions=return_exceptions)
+        return await asyncio.wait_for(gather, timeout=self._timeout)
+
     async def send_request(self, command, request_id=None, response_type=None, return_exceptions=False, **params):
         request = self.create_request(command=command, request_id=request_id, **params)
         payload = self.build_request_wrapper(request)
@@ -251,15 +344,37 @@ class APIClient:
             raise
 
     async def send_payload(self, payload, request_id=None, response_type=None) -> asyncio.Future:
+        await self.send_raw(self.build_frame(payload))
+        return self._allocate_future(request_id, response_type)
+
+    async def send_batch_payload(self, payload, request_ids) -> list:
+        await self.send_raw(self.build_frame(payload))
+        return [self._allocate_future(request_id) for request_id in request_ids]
+
+    async def send_raw(self, data: bytes):
         _, writer = await self._open_stream_task
-        writer.write(payload)
+        writer.write(data)
         await writer.drain()
+
+    def build_frame(self, payload) -> bytes:
+        if self._framing == Framing.COBS:
+            return cobs.build_frame(payload)
+        return payload
+
+    def _allocate_future(self, request_id, response_type=None) -> asyncio.Future:
         future = asyncio.Future()
         self._future_responses[request_id] = FutureResponse(future, response_type)
         timeout_routine = self._event_loop.create_task(self._request_timeout_routine(request_id, self.FUTURE_ALLOCATE_TIMEOUT))
         self._timeout_tasks.append(timeout_routine)
         return future
 
+    @staticmethod
+    def _resource_param(resource, name) -> dict:
+        # A resource can be referenced by its name or by the handle returned when it was created
+        if isinstance(name, int):
+            return {f'{resource}Handle': name}
+        return {f'{resource}Name': name}
+
     @staticmethod
     def build_request_wrapper(request) -> bytes:
         message = request
@@ -268,6 +383,14 @@ class APIClient:
         message_type = APIClient.REQUEST_MESSAGE_TYPES.get(request.__class__, 1)
         return struct.pack(PACKET_FORMAT, message_type, len(message)) + message
 
+    @staticmethod
+    def build_batch_request_wrapper(requests) -> bytes:
+        payload = struct.pack(PACKET_FORMAT, BATCH_MESSAGE_TYPE, len(requests))
+        for request in requests:
+            message = request.SerializeToString()
+            payload += struct.pack('<H', len(message)) + message
+        return payload
+
     @staticmethod
     def create_request(command, request_class=Request, request_id=None, **params):
         request = request_class()
@@ -282,6 +405,10 @@ class APIClient:
     
     async def read_response(self):
         reader, _ = await self._open_stream_task
+        if self._framing == Framing.COBS:
+            reader = await APIClient.read_cobs_frame(reader)
+            if reader is None:
+                return
         message_type = struct.unpack('B', await reader.readexactly(1))
         message_type = message_type[0]
 
@@ -291,6 +418,16 @@ class APIClient:
             return
 
         message_length = struct.unpack('<H', await reader.readexactly(2))[0]
+
+        if message_type == BATCH_MESSAGE_TYPE:
+            responses = []
+            for _ in range(message_length):
+                response_length = struct.unpack('<H', await reader.readexactly(2))[0]
+                response = Response()
+                response.ParseFromString(await reader.readexactly(response_length))
+                responses.append(response)
+            return responses
+
         raw = await reader.readexactly(message_length)
 
         response = None
@@ -300,8 +437,26 @@ class APIClient:
         elif message_type == 2:
             response = _TestResponse()
             response.ParseFromString(raw)
+        elif message_type == EVENT_MESSAGE_TYPE:
+            response = Event()
+            response.ParseFromString(raw)
         return response
     
+    @staticmethod
+    async def read_cobs_frame(stream_reader):
+        frame = b''
+        while not frame:
+            frame = (await stream_reader.readuntil(cobs.DELIMITER))[:-1]
+        payload = cobs.parse_frame(frame)
+        if payload is None:
+            LOGGER.error('Dropped a corrupted frame')
+            return None
+        # the frame payload has the legacy format, it is parsed from its own reader
+        frame_reader = asyncio.StreamReader()
+        frame_reader.feed_data(payload)
+        frame_reader.feed_eof()
+        return frame_reader
+
     @staticmethod
     async def stream_read_until(stream_reader, seperator=b'\n'):
         separator_buffer = b'\00' * len(seperator)
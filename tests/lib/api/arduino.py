@@ -8,8 +8,11 @@ class ArduinoNotFound(RuntimeError):
     pass
 
 
+DEFAULT_BAUDRATE = 9600
+
+
 class ArduinoConnection:
-    def __init__(self, port: int = None, baudrate: int = 9600):
+    def __init__(self, port: int = None, baudrate: int = DEFAULT_BAUDRATE):
         try:
             self.port = port or ArduinoConnection.available_comports()[0]
         except IndexError:
@@ -24,6 +27,13 @@ class ArduinoConnection:
         reader, writer = self.transport
         return reader, writer
 
+    async def set_baudrate(self, baudrate: int):
+        self.baudrate = baudrate
+        if self.transport:
+            _, writer = self.transport
+            await writer.drain()
+            writer.transport.serial.baudrate = baudrate
+
     async def close(self):
         if self.transport and not self.transport[1].is_closing():
             self.transport[1].close()
@@ -0,0 +1,66 @@
+CRC16_INIT = 0xFFFF
+DELIMITER = b'\x00'
+MAX_BLOCK_LENGTH = 254
+
+
+class DecodeError(Exception):
+    pass
+
+
+def crc16(data: bytes, crc: int = CRC16_INIT) -> int:
+    # CRC-16/CCITT, the same one computed by the firmware
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def encode(data: bytes) -> bytes:
+    encoded = bytearray()
+    block = bytearray()
+    for byte in data:
+        if byte == 0:
+            encoded.append(len(block) + 1)
+            encoded += block
+            block.clear()
+        else:
+            block.append(byte)
+            if len(block) == MAX_BLOCK_LENGTH:
+                encoded.append(len(block) + 1)
+                encoded += block
+                block.clear()
+    encoded.append(len(block) + 1)
+    encoded += block
+    return bytes(encoded)
+
+
+def decode(data: bytes) -> bytes:
+    decoded = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise DecodeError('Invalid COBS block')
+        decoded += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            decoded.append(0)
+    return bytes(decoded)
+
+
+def build_frame(payload: bytes) -> bytes:
+    # the leading delimiter flushes the bytes left by a broken frame, the firmware skips empty frames
+    return DELIMITER + encode(payload + crc16(payload).to_bytes(2, 'big')) + DELIMITER
+
+
+def parse_frame(frame: bytes) -> bytes:
+    """Returns the payload of a COBS frame without its delimiter, or None when it is corrupted"""
+    try:
+        data = decode(frame)
+    except DecodeError:
+        return None
+    if len(data) <= 2 or crc16(data) != 0:
+        return None
+    return data[:-2]
@@ -11,3 +11,41 @@ class IOType(enum.IntEnum):
 class IOSource(enum.IntEnum):
     VIRTUAL = 0
     PHYSICAL = 1
+
+class EventType(enum.IntEnum):
+    WATER_SOURCE_STATE = 0
+    WATER_TANK_ACTIVE = 1
+    OPERATION_MODE = 2
+    WATER_TANK_VOLUME = 3
+    RESYNC = 4
+
+class FilterType(enum.IntEnum):
+    NO_FILTER = 0
+    MOVING_AVERAGE = 1
+    MEDIAN = 2
+    EMA = 3
+
+class ControlMode(enum.IntEnum):
+    BANG_BANG = 0
+    PREDICTIVE = 1
+
+class Counter(enum.IntEnum):
+    REQUEST_DISPATCHES = 0
+    MAX_QUEUED_FRAMES = 1
+    RX_OVERRUNS = 2
+    TX_DROPS = 3
+    POOL_USAGE = 4
+    POOL_MAX_USAGE = 5
+    POOL_CAPACITY = 6
+    DUTY_CYCLE = 7
+    MAX_ADC_READS_PER_LOOP = 8
+    NOTIFICATION_DROPS = 9
+
+class Pool(enum.IntEnum):
+    WATER_TANK_POOL = 0
+    WATER_SOURCE_POOL = 1
+    IO_INTERFACE_POOL = 2
+
+class Framing(enum.IntEnum):
+    LEGACY = 0
+    COBS = 1
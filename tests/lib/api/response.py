@@ -27,10 +27,12 @@ class WaterSourceStateParser(APIResponseMessageParser):
     @staticmethod
     def parse(raw_field):
         field = APIResponse.parse_dict_field(raw_field)
+        field.setdefault('handle', 0)
         field.setdefault('pin', 0)
         field.setdefault('active', False)
         field.setdefault('turnedOn', False)
         field.setdefault('sourceWaterTank', None)
+        field.setdefault('ownerWaterTank', None)
         return field
 
 
@@ -38,6 +40,7 @@ class WaterTankStateParser(APIResponseMessageParser):
     @staticmethod
     def parse(raw_field):
         field = APIResponse.parse_dict_field(raw_field)
+        field.setdefault('handle', 0)
         field.setdefault('pressureSensorPin', 0)
         field.setdefault('filling', False)
         field.setdefault('active', False)
@@ -47,13 +50,42 @@ class WaterTankStateParser(APIResponseMessageParser):
         field.setdefault('maxVolume', 0)
         field.setdefault('zeroVolumePressure', 0)
         field.setdefault('pressureChangingValue', 0)
+        field.setdefault('filterType', 0)
+        field.setdefault('filterWindow', 0)
+        field.setdefault('oversampling', 0)
+        field['calibrationRawValues'] = list(field.get('calibrationRawValues', []))
+        field['calibrationVolumes'] = list(field.get('calibrationVolumes', []))
         field.setdefault('rawPressureValue', 0)
         field.setdefault('pressure', 0)
         field.setdefault('volume', 0)
+        field.setdefault('flowRate', 0)
+        field.setdefault('expectedFillRate', 0)
+        field.setdefault('controlMode', 0)
+        field.setdefault('lowerBand', 0)
+        field.setdefault('upperBand', 0)
+        field.setdefault('settleLag', 0)
+        field.setdefault('fillCycles', 0)
+        field.setdefault('lastDayFillCycles', 0)
+        field.setdefault('priorityWeight', 0)
+        field.setdefault('timeToMaxVolume', 0)
+        field.setdefault('timeToMinimumVolume', 0)
         field.setdefault('waterSource', None)
         return field
 
 
+class SystemStateParser(APIResponseMessageParser):
+    @staticmethod
+    def parse(raw_field):
+        field = dict()
+        field['waterTanks'] = [WaterTankStateParser.parse(water_tank) for water_tank in raw_field.waterTanks]
+        field['waterSources'] = [WaterSourceStateParser.parse(water_source) for water_source in raw_field.waterSources]
+        field['mode'] = raw_field.mode
+        field['error'] = None
+        if raw_field.HasField('error'):
+            field['error'] = APIResponse.parse_dict_field(raw_field.error)
+        return field
+
+
 class APIResponse:
     GET_FIRST_FIELD_PARSER: APIResponseMessageParser = GetFirstFieldParser()
     MESSAGE_PARSERS: Dict[str, APIResponseMessageParser] = {
@@ -61,7 +93,8 @@ class APIResponse:
         'PrimitiveValue': GET_FIRST_FIELD_PARSER,
         'Value': GET_FIRST_FIELD_PARSER,
         'WaterSourceState': WaterSourceStateParser(),
-        'WaterTankState': WaterTankStateParser()
+        'WaterTankState': WaterTankStateParser(),
+        'SystemState': SystemStateParser()
     }
 
     def __init__(self, id_: int, message: Any):
@@ -29,12 +29,21 @@ API_METHODS = {
     'Set Water Tank Volume Factor': 'set_water_tank_volume_factor',
     'Set Water Tank Pressure Factor': 'set_water_tank_pressure_factor',
     'Set Water Tank Pressure Changing Value': 'set_water_tank_pressure_changing_value',
+    'Set Water Tank Filter': 'set_water_tank_filter',
+    'Set Water Tank Calibration': 'set_water_tank_calibration',
+    'Set Water Tank Control': 'set_water_tank_control',
+    'Set Water Tank Priority': 'set_water_tank_priority',
     'Get Water Tank List': 'get_water_tank_list',
     'Get Water Tank': 'get_water_tank',
     'Fill Water Tank': 'fill_water_tank',
     'Set Water Tank Active': 'set_water_tank_active',
     'Set Operation Mode': 'set_operation_mode',
     'Get Operation Mode': 'get_operation_mode',
+    'Get System State': 'get_system_state',
+    'Subscribe': 'subscribe',
+    'Unsubscribe': 'unsubscribe',
+    'Set Framing': 'set_framing',
+    'Set Baud Rate': 'set_baud_rate',
     'Save': 'save',
     'Reset': 'reset',
     'Create IO': 'create_io',
@@ -45,7 +54,10 @@ API_METHODS = {
     'Set Clock Offset': 'set_clock_offset',
     'Get Millis': 'get_millis',
     'Get Free Memory': 'get_free_memory',
-    'Reset Clock': 'reset_clock'
+    'Reset Clock': 'reset_clock',
+    'Get Counter': 'get_counter',
+    'Benchmark Lookup': 'benchmark_lookup',
+    'Benchmark Water Tank Loop': 'benchmark_water_tank_loop'
 }
 
 
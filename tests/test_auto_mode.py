@@ -1,10 +1,11 @@
+import math
 import asyncio
 
 import pytest
 
 
 from .lib.api import APIClient
-from .lib.api.models import OperationMode
+from .lib.api.models import OperationMode, Counter, ControlMode, FilterType, IOSource
 from .lib.api.exceptions import APIInvalidRequest, APIRuntimeError
 
 
@@ -401,4 +402,374 @@ async def test_auto_stop_when_water_tank_is_not_filling(api_client: APIClient):
     assert not water_tank['active']
     assert not water_tank['filling']
 
-    assert not ((await api_client.get_water_source(water_source_name)))['turnedOn']
\ No newline at end of file
+    assert not ((await api_client.get_water_source(water_source_name)))['turnedOn']
+
+async def test_idle_duty_cycle(api_client: APIClient):
+    """
+    Platform should sleep while no water tank deadline is due and no request is received
+    """
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+    water_source_name, water_source_pin = 'Compesa water source', 15
+
+    await api_client.create_water_source(water_source_name, water_source_pin)
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor, water_source_name)
+
+    await api_client.set_water_tank_minimum_volume(water_tank_name, 10)
+    await api_client.set_water_tank_max_volume(water_tank_name, 20)
+
+    await api_client.set_operation_mode(OperationMode.AUTO)
+
+    await api_client.get_counter(Counter.DUTY_CYCLE)
+    await asyncio.sleep(2)
+    duty_cycle = await api_client.get_counter(Counter.DUTY_CYCLE)  # per mille of the time awake
+
+    # Before the deadlines, the loop ran every water tank on each pass and was always awake (1000)
+    assert duty_cycle < 500
+
+
+async def test_idle_duty_cycle_with_physical_io(api_client: APIClient):
+    """
+    Platform should sleep between the passes of the analog conversions when the pressure sensors are physical
+    """
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+    water_source_name, water_source_pin = 'Compesa water source', 15
+
+    await api_client.set_io_source(IOSource.PHYSICAL)
+    try:
+        await api_client.create_water_source(water_source_name, water_source_pin)
+        await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor, water_source_name)
+
+        await api_client.get_counter(Counter.DUTY_CYCLE)
+        await asyncio.sleep(2)
+        duty_cycle = await api_client.get_counter(Counter.DUTY_CYCLE)  # per mille of the time awake
+
+        # With the conversions running back to back, the ADC interrupt woke the loop every 104 us (1000)
+        assert duty_cycle < 500
+    finally:
+        await api_client.set_io_source(IOSource.VIRTUAL)
+
+
+async def test_sensor_read_once_per_loop(api_client: APIClient):
+    """
+    Platform should read each pressure sensor once per loop, even when it is shared by several water tanks
+    """
+    pressure_sensor, volume_factor, pressure_factor = 1, 1, 1
+
+    for i in range(1, 4):
+        await api_client.create_water_source(f'Water source {i}', 10 + i)
+        await api_client.create_water_tank(f'Water tank {i}', pressure_sensor, volume_factor, pressure_factor, f'Water source {i}')
+        await api_client.set_water_tank_minimum_volume(f'Water tank {i}', 10)
+        await api_client.set_water_tank_max_volume(f'Water tank {i}', 20)
+
+    await api_client.set_io_value(pressure_sensor, 5)
+    await api_client.set_operation_mode(OperationMode.AUTO)
+
+    await api_client.get_counter(Counter.MAX_ADC_READS_PER_LOOP)
+    await api_client.advance_clock(60)
+
+    for i in range(1, 4):
+        assert (await api_client.get_water_tank(f'Water tank {i}'))['filling']
+
+    assert await api_client.get_counter(Counter.MAX_ADC_READS_PER_LOOP) == 1
+
+
+async def test_deactivate_water_tank_under_learned_fill_rate(api_client: APIClient):
+    """
+    Platform should learn the fill rate of a water tank and deactivate it soon after
+    its volume stops rising, instead of waiting the max time not filling
+    """
+    max_time_not_filling = 10 * 60  # 10 minutes
+    flow_sampling_interval, raw_value_step = 10, 30
+
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+    water_source_name, water_source_pin = 'Compesa water source', 15
+
+    await api_client.create_water_source(water_source_name, water_source_pin)
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor, water_source_name)
+
+    await api_client.set_water_tank_minimum_volume(water_tank_name, 100)
+    await api_client.set_water_tank_max_volume(water_tank_name, 1000)
+    await api_client.set_io_value(pressure_sensor, 50)
+
+    await api_client.set_operation_mode(OperationMode.AUTO)
+
+    await api_client.advance_clock(60)
+
+    assert (await api_client.get_water_tank(water_tank_name))['filling']
+
+    # The fill rate is learned in a minute of filling
+    raw_value = 50
+    for _ in range(12):
+        raw_value += raw_value_step
+        await api_client.set_io_value(pressure_sensor, raw_value)
+        await api_client.advance_clock(flow_sampling_interval)
+
+    water_tank = await api_client.get_water_tank(water_tank_name)
+    expected_fill_rate = raw_value_step * 60 / flow_sampling_interval
+    assert math.isclose(water_tank['expectedFillRate'], expected_fill_rate, rel_tol=0.1)
+
+    # The water source stops delivering
+    elapsed_time = 0
+    while (await api_client.get_water_tank(water_tank_name))['active'] and elapsed_time < max_time_not_filling:
+        await api_client.advance_clock(flow_sampling_interval)
+        elapsed_time += flow_sampling_interval
+
+    water_tank = await api_client.get_water_tank(water_tank_name)
+    assert not water_tank['active']
+    assert not water_tank['filling']
+    assert elapsed_time <= 2 * 60
+
+
+async def test_predictive_control_stops_before_overshoot(api_client: APIClient):
+    """
+    Platform should learn the lag between a water source stop and the volume settle, and stop
+    the next fills earlier by the overshoot expected from it
+    """
+    flow_sampling_interval, raw_value_step = 10, 30
+
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+    water_source_name, water_source_pin = 'Compesa water source', 15
+
+    await api_client.create_water_source(water_source_name, water_source_pin)
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor, water_source_name)
+
+    await api_client.set_water_tank_minimum_volume(water_tank_name, 100)
+    await api_client.set_water_tank_max_volume(water_tank_name, 500)
+    await api_client.set_water_tank_control(water_tank_name, ControlMode.PREDICTIVE)
+    await api_client.set_io_value(pressure_sensor, 50)
+
+    await api_client.set_operation_mode(OperationMode.AUTO)
+
+    await api_client.advance_clock(60)
+
+    async def fill(raw_value):
+        while (await api_client.get_water_tank(water_tank_name))['filling']:
+            raw_value += raw_value_step
+            await api_client.set_io_value(pressure_sensor, raw_value)
+            await api_client.advance_clock(flow_sampling_interval)
+        return raw_value
+
+    # Without a learned lag the fill stops at the max volume
+    first_stop_raw_value = await fill(50)
+    assert first_stop_raw_value >= 500
+
+    # The volume keeps rising after the stop, then it settles
+    raw_value = first_stop_raw_value
+    for _ in range(2):
+        raw_value += raw_value_step
+        await api_client.set_io_value(pressure_sensor, raw_value)
+        await api_client.advance_clock(flow_sampling_interval)
+    for _ in range(7):
+        await api_client.advance_clock(flow_sampling_interval)
+
+    assert (await api_client.get_water_tank(water_tank_name))['settleLag'] > 0
+
+    await api_client.set_io_value(pressure_sensor, 50)
+    await api_client.advance_clock(flow_sampling_interval)
+
+    assert (await api_client.get_water_tank(water_tank_name))['filling']
+
+    second_stop_raw_value = await fill(50)
+    assert second_stop_raw_value < 500
+
+    water_tank = await api_client.get_water_tank(water_tank_name)
+    assert water_tank['fillCycles'] == 2
+
+
+async def test_invalid_water_tank_control(api_client: APIClient):
+    """Platform should refuse control settings with negative bands"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor)
+
+    for lower_band, upper_band in ((-1, 0), (0, -1)):
+        with pytest.raises(APIInvalidRequest) as exc_info:
+            await api_client.set_water_tank_control(water_tank_name, ControlMode.PREDICTIVE, lower_band, upper_band)
+        assert exc_info.value.response.message == 'Invalid control settings'
+
+    assert (await api_client.get_water_tank(water_tank_name))['controlMode'] == ControlMode.BANG_BANG
+
+
+async def test_shared_water_source_kept_on_for_sibling_water_tank(api_client: APIClient):
+    """Platform should keep a shared water source on while a dependent water tank is still under its min volume"""
+    water_source_name, water_source_pin = 'Compesa water source', 15
+    first_water_tank_name, first_pressure_sensor = 'Bottom tank', 1
+    second_water_tank_name, second_pressure_sensor = 'Side tank', 2
+    volume_factor, pressure_factor = 1, 1
+
+    await api_client.create_water_source(water_source_name, water_source_pin)
+    for water_tank_name, pressure_sensor in ((first_water_tank_name, first_pressure_sensor),
+                                             (second_water_tank_name, second_pressure_sensor)):
+        await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor, water_source_name)
+        await api_client.set_water_tank_minimum_volume(water_tank_name, 10)
+        await api_client.set_water_tank_max_volume(water_tank_name, 20)
+
+    await api_client.set_water_tank_priority(second_water_tank_name, 2)
+    await api_client.set_operation_mode(OperationMode.AUTO)
+
+    await api_client.advance_clock(60)
+
+    water_source = await api_client.get_water_source(water_source_name)
+    assert water_source['turnedOn']
+    assert water_source['ownerWaterTank'] == second_water_tank_name
+
+    await api_client.set_io_value(second_pressure_sensor, 21)
+    await api_client.advance_clock(60)
+
+    water_source = await api_client.get_water_source(water_source_name)
+    assert water_source['turnedOn']
+    assert water_source['ownerWaterTank'] == first_water_tank_name
+
+    await api_client.set_io_value(first_pressure_sensor, 21)
+    await api_client.advance_clock(60)
+
+    water_source = await api_client.get_water_source(water_source_name)
+    assert not water_source['turnedOn']
+    assert water_source['ownerWaterTank'] is None
+
+
+async def test_shared_water_source_handed_out_again_after_mode_change(api_client: APIClient):
+    """Platform should forget the water source owners when the operation mode changes"""
+    water_source_name, water_source_pin = 'Compesa water source', 15
+    first_water_tank_name, first_pressure_sensor = 'Bottom tank', 1
+    second_water_tank_name, second_pressure_sensor = 'Side tank', 2
+    volume_factor, pressure_factor = 1, 1
+
+    await api_client.create_water_source(water_source_name, water_source_pin)
+    for water_tank_name, pressure_sensor in ((first_water_tank_name, first_pressure_sensor),
+                                             (second_water_tank_name, second_pressure_sensor)):
+        await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor, water_source_name)
+        await api_client.set_water_tank_minimum_volume(water_tank_name, 10)
+        await api_client.set_water_tank_max_volume(water_tank_name, 20)
+
+    await api_client.set_water_tank_priority(second_water_tank_name, 2)
+    await api_client.set_operation_mode(OperationMode.AUTO)
+
+    await api_client.advance_clock(60)
+
+    assert (await api_client.get_water_source(water_source_name))['ownerWaterTank'] == second_water_tank_name
+
+    await api_client.set_operation_mode(OperationMode.MANUAL)
+
+    assert (await api_client.get_water_source(water_source_name))['ownerWaterTank'] is None
+
+    # In manual mode a deactivated water tank turns off its water source, whoever it was filling
+    await api_client.set_water_tank_active(first_water_tank_name, False)
+
+    assert not (await api_client.get_water_source(water_source_name))['turnedOn']
+
+    await api_client.set_water_tank_active(first_water_tank_name, True)
+    await api_client.set_operation_mode(OperationMode.AUTO)
+    await api_client.set_io_value(second_pressure_sensor, 21)
+    await api_client.advance_clock(60)
+
+    water_source = await api_client.get_water_source(water_source_name)
+    assert water_source['turnedOn']
+    assert water_source['ownerWaterTank'] == first_water_tank_name
+
+
+async def test_invalid_water_tank_priority(api_client: APIClient):
+    """Platform should refuse a priority weight out of 1 to 255"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor)
+
+    for weight in (0, 256):
+        with pytest.raises(APIInvalidRequest) as exc_info:
+            await api_client.set_water_tank_priority(water_tank_name, weight)
+        assert exc_info.value.response.message == 'Invalid priority weight'
+
+    assert (await api_client.get_water_tank(water_tank_name))['priorityWeight'] == 1
+
+
+async def test_delayed_fill_is_not_stalled(api_client: APIClient):
+    """
+    Platform should not take the delay before the volume starts rising, as in a long pipe,
+    as a stalled fill once the fill rate is learned
+    """
+    flow_sampling_interval, raw_value_step = 10, 30
+
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+    water_source_name, water_source_pin = 'Compesa water source', 15
+
+    await api_client.create_water_source(water_source_name, water_source_pin)
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor, water_source_name)
+
+    await api_client.set_water_tank_minimum_volume(water_tank_name, 100)
+    await api_client.set_water_tank_max_volume(water_tank_name, 1000)
+    await api_client.set_io_value(pressure_sensor, 50)
+
+    await api_client.set_operation_mode(OperationMode.AUTO)
+
+    await api_client.advance_clock(60)
+
+    raw_value = 50
+    for _ in range(12):
+        raw_value += raw_value_step
+        await api_client.set_io_value(pressure_sensor, raw_value)
+        await api_client.advance_clock(flow_sampling_interval)
+
+    assert (await api_client.get_water_tank(water_tank_name))['expectedFillRate'] > 0
+
+    await api_client.set_io_value(pressure_sensor, 1001)
+    await api_client.advance_clock(61)
+
+    assert not (await api_client.get_water_tank(water_tank_name))['filling']
+
+    await api_client.set_io_value(pressure_sensor, 50)
+    await api_client.advance_clock(61)
+
+    assert (await api_client.get_water_tank(water_tank_name))['filling']
+
+    # The volume only starts rising a minute into the fill
+    for _ in range(6):
+        await api_client.advance_clock(flow_sampling_interval)
+        assert (await api_client.get_water_tank(water_tank_name))['active']
+
+    raw_value = 50
+    for _ in range(6):
+        raw_value += raw_value_step
+        await api_client.set_io_value(pressure_sensor, raw_value)
+        await api_client.advance_clock(flow_sampling_interval)
+
+    water_tank = await api_client.get_water_tank(water_tank_name)
+    assert water_tank['active']
+    assert water_tank['filling']
+
+
+async def test_cascade_water_source_sees_upstream_water_tank_of_same_loop(api_client: APIClient):
+    """
+    Platform should run a water tank feeding the water source of another one first, so the water source
+    is enabled on the volume of the upstream water tank sampled in the same loop
+    """
+    upstream_water_tank_name, upstream_pressure_sensor = 'Upper tank', 1
+    downstream_water_tank_name, downstream_pressure_sensor = 'Bottom tank', 2
+    water_source_name, water_source_pin = 'Upper tank pump', 15
+    volume_factor, pressure_factor = 1, 1
+
+    await api_client.create_water_tank(upstream_water_tank_name, upstream_pressure_sensor, volume_factor, pressure_factor)
+    await api_client.create_water_source(water_source_name, water_source_pin, upstream_water_tank_name)
+    await api_client.create_water_tank(downstream_water_tank_name, downstream_pressure_sensor, volume_factor,
+                                       pressure_factor, water_source_name)
+
+    for water_tank_name in (upstream_water_tank_name, downstream_water_tank_name):
+        await api_client.set_water_tank_minimum_volume(water_tank_name, 10)
+        await api_client.set_water_tank_max_volume(water_tank_name, 20)
+
+    # The volume of the upstream water tank only changes when it is sampled
+    await api_client.set_water_tank_filter(upstream_water_tank_name, FilterType.MEDIAN, window=1)
+    await api_client.set_io_value(upstream_pressure_sensor, 5)
+
+    await api_client.set_operation_mode(OperationMode.AUTO)
+    await api_client.advance_clock(60)
+
+    assert not (await api_client.get_water_source(water_source_name))['turnedOn']
+
+    # Both water tanks are due in the next loop, the upstream one is sampled before the water source is enabled
+    await api_client.set_io_value(upstream_pressure_sensor, 15)
+    await api_client.advance_clock(61)
+
+    water_source = await api_client.get_water_source(water_source_name)
+    assert water_source['turnedOn']
+    assert water_source['ownerWaterTank'] == downstream_water_tank_name
+    assert (await api_client.get_water_tank(downstream_water_tank_name))['filling']
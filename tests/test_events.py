@@ -0,0 +1,119 @@
+import asyncio
+
+import pytest
+
+from .lib.api import APIClient
+from .lib.api.models import OperationMode, EventType, Counter
+
+
+@pytest.fixture
+async def unsubscribe(api_client: APIClient):
+    yield
+    await api_client.unsubscribe()
+
+
+async def test_water_source_state_events(api_client: APIClient, unsubscribe):
+    """Platform should push an event when a water source is turned on/off"""
+    water_source_name, water_source_pin = 'Compesa water source', 15
+
+    await api_client.create_water_source(water_source_name, water_source_pin)
+    await api_client.subscribe()
+
+    await api_client.set_water_source_state(water_source_name, True)
+
+    event = await asyncio.wait_for(api_client.get_event(), timeout=7)
+
+    assert event['type'] == EventType.WATER_SOURCE_STATE
+    assert event['resource'] == water_source_name
+    assert event['value'] == 1
+
+    await api_client.set_water_source_state(water_source_name, False)
+
+    event = await asyncio.wait_for(api_client.get_event(), timeout=7)
+
+    assert event['type'] == EventType.WATER_SOURCE_STATE
+    assert event['resource'] == water_source_name
+    assert event['value'] == 0
+
+
+async def test_water_tank_and_mode_events(api_client: APIClient, unsubscribe):
+    """Platform should push an event when a water tank is (de)activated or the operation mode changes"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor)
+    await api_client.subscribe(volume_deadband=1000)
+
+    # the first event of each water tank reports its current volume
+    event = await asyncio.wait_for(api_client.get_event(), timeout=7)
+    assert event['type'] == EventType.WATER_TANK_VOLUME
+
+    await api_client.set_water_tank_active(water_tank_name, False)
+
+    event = await asyncio.wait_for(api_client.get_event(), timeout=7)
+
+    assert event['type'] == EventType.WATER_TANK_ACTIVE
+    assert event['resource'] == water_tank_name
+    assert event['value'] == 0
+
+    await api_client.set_operation_mode(OperationMode.AUTO)
+
+    event = await asyncio.wait_for(api_client.get_event(), timeout=7)
+
+    assert event['type'] == EventType.OPERATION_MODE
+    assert event['value'] == OperationMode.AUTO
+
+
+async def test_water_tank_volume_deadband(api_client: APIClient, unsubscribe):
+    """Platform should push the water tank volume only when it moves more than the deadband"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor)
+    await api_client.set_io_value(pressure_sensor, 10)
+    await api_client.subscribe(minimum_interval=0, volume_deadband=5)
+
+    event = await asyncio.wait_for(api_client.get_event(), timeout=7)
+
+    assert event['type'] == EventType.WATER_TANK_VOLUME
+    assert event['value'] == 10
+
+    await api_client.set_io_value(pressure_sensor, 12)
+
+    with pytest.raises(asyncio.TimeoutError):
+        await asyncio.wait_for(api_client.get_event(), timeout=2)
+
+    await api_client.set_io_value(pressure_sensor, 16)
+
+    event = await asyncio.wait_for(api_client.get_event(), timeout=7)
+
+    assert event['resource'] == water_tank_name
+    assert event['value'] == 16
+
+
+async def test_resync_event_when_notifications_overflow(api_client: APIClient, unsubscribe):
+    """Platform should push a resync event instead of silently dropping state changes it cannot keep"""
+    water_tank_names = [f'Water tank {pin}' for pin in range(1, 6)]
+    water_source_names = [f'Water source {pin}' for pin in range(15, 19)]
+
+    for pin, water_tank_name in enumerate(water_tank_names, 1):
+        await api_client.create_water_tank(water_tank_name, pin, 1, 1)
+    for pin, water_source_name in enumerate(water_source_names, 15):
+        await api_client.create_water_source(water_source_name, pin)
+    await api_client.subscribe(volume_deadband=1000)
+
+    # the first event of each water tank reports its current volume
+    for _ in water_tank_names:
+        event = await asyncio.wait_for(api_client.get_event(), timeout=7)
+        assert event['type'] == EventType.WATER_TANK_VOLUME
+
+    dropped_notifications = await api_client.get_counter(Counter.NOTIFICATION_DROPS)
+
+    # more changed states in a single loop than the pending notifications
+    requests = [api_client.create_request('setWaterTankActive', waterTankName=name, active=False) for name in water_tank_names]
+    requests += [api_client.create_request('setWaterSourceState', waterSourceName=name, state=True)
+                 for name in water_source_names]
+    await api_client.send_batch(requests)
+
+    event = await asyncio.wait_for(api_client.get_event(), timeout=7)
+
+    assert event['type'] == EventType.RESYNC
+    assert await api_client.get_counter(Counter.NOTIFICATION_DROPS) > dropped_notifications
@@ -4,11 +4,13 @@ import logging
 import pytest
 
 from .lib.api import APIClient
+from .lib.api.models import Counter, Pool, FilterType, ControlMode
 
 LOGGER = logging.getLogger(__name__)
 
 MAX_WATER_TANKS = 5
 MAX_WATER_SOURCES = 5
+MAX_NAME_LENGTH = 20
 
 
 async def test_create_max_items(api_client: APIClient):
@@ -45,6 +47,29 @@ async def test_create_max_items(api_client: APIClient):
     assert water_sources == [name for name, _ in expected_water_sources]
 
 
+async def test_list_max_items_with_longest_names(api_client: APIClient):
+    """
+    Platform should list the max of water sources/water tanks with the longest names,
+    the largest lists are encoded straight to the serial port
+    """
+    volume_factor, pressure_factor = 1.5, 2.5
+    expected_water_sources = [(f'Water source {i}'.ljust(MAX_NAME_LENGTH, '.'), i) for i in range(1, MAX_WATER_SOURCES + 1)]
+    expected_water_tanks = [(f'Water tank {i}'.ljust(MAX_NAME_LENGTH, '.'), i) for i in range(1, MAX_WATER_TANKS + 1)]
+
+    for name, pin in expected_water_sources:
+        await api_client.create_water_source(name, pin)
+
+    for name, pressure_sensor in expected_water_tanks:
+        await api_client.create_water_tank(name, pressure_sensor, volume_factor, pressure_factor)
+
+    requests = [api_client.create_request('getWaterSourceList'), api_client.create_request('getWaterTankList')] * 4
+    responses = await asyncio.wait_for(api_client.send_batch(requests), timeout=10)
+
+    for request, response in zip(requests, responses):
+        expected = expected_water_sources if request.HasField('getWaterSourceList') else expected_water_tanks
+        assert list(response) == [name for name, _ in expected]
+
+
 async def test_create_infinite_ios_by_creating_water_sources_and_tanks(api_client: APIClient):
     """
     Platform should deallocate IOInterface instances when there are no water source
@@ -132,6 +157,33 @@ async def test_memory_leak_by_restting_many_times(api_client: APIClient):
     assert end_free_memory + 100 >= start_free_memory
 
 
+async def test_pools_are_released(api_client: APIClient):
+    """Platform should give the water tanks, water sources and IOs back to their pools when they are removed"""
+    volume_factor, pressure_factor = 1.5, 2.5
+    free_memory = await api_client.get_free_memory()
+
+    for _ in range(3):
+        for i in range(1, MAX_WATER_SOURCES + 1):
+            await api_client.create_water_source(f'Water source {i}', i)
+        for i in range(1, MAX_WATER_TANKS + 1):
+            await api_client.create_water_tank(f'Water tank {i}', MAX_WATER_SOURCES + i, volume_factor, pressure_factor)
+
+        assert await api_client.get_counter(Counter.POOL_USAGE, Pool.WATER_SOURCE_POOL) == MAX_WATER_SOURCES
+        assert await api_client.get_counter(Counter.POOL_USAGE, Pool.WATER_TANK_POOL) == MAX_WATER_TANKS
+        assert await api_client.get_counter(Counter.POOL_USAGE, Pool.IO_INTERFACE_POOL) == MAX_WATER_SOURCES + MAX_WATER_TANKS
+
+        for i in range(1, MAX_WATER_TANKS + 1):
+            await api_client.remove_water_tank(f'Water tank {i}')
+        for i in range(1, MAX_WATER_SOURCES + 1):
+            await api_client.remove_water_source(f'Water source {i}')
+
+    for pool in Pool:
+        assert await api_client.get_counter(Counter.POOL_USAGE, pool) == 0
+        assert await api_client.get_counter(Counter.POOL_MAX_USAGE, pool) <= await api_client.get_counter(Counter.POOL_CAPACITY, pool)
+
+    assert abs(await api_client.get_free_memory() - free_memory) <= 2**4
+
+
 async def test_save_resources(api_client: APIClient, clear_eeprom):
     """
     Platform should be able to save all resources created in 
@@ -162,3 +214,81 @@ async def test_save_resources(api_client: APIClient, clear_eeprom):
     water_sources = await api_client.get_water_source_list()
     
     assert water_sources == [name for name, _ in expected_water_sources]
+
+
+async def test_save_water_tank_filter(api_client: APIClient, clear_eeprom):
+    """
+    Platform should save the pressure filter of the water tanks in the EEPROM
+    """
+    volume_factor, pressure_factor = 1.5, 2.5
+
+    await api_client.create_water_tank('Water tank 1', 1, volume_factor, pressure_factor)
+    await api_client.create_water_tank('Water tank 2', 2, volume_factor, pressure_factor)
+    await api_client.set_water_tank_filter('Water tank 2', FilterType.EMA, window=4, oversampling=8)
+
+    await api_client.save()
+    await api_client.reset()
+    await api_client.load_api_from_eeprom()
+
+    water_tank = await api_client.get_water_tank('Water tank 1')
+    assert water_tank['filterType'] == FilterType.NO_FILTER
+    assert water_tank['oversampling'] == 1
+
+    water_tank = await api_client.get_water_tank('Water tank 2')
+    assert water_tank['filterType'] == FilterType.EMA
+    assert water_tank['filterWindow'] == 4
+    assert water_tank['oversampling'] == 8
+
+
+async def test_save_water_tank_calibration(api_client: APIClient, clear_eeprom):
+    """
+    Platform should save the calibration table of the water tanks in the EEPROM
+    """
+    volume_factor, pressure_factor = 1.5, 2.5
+    points = [(raw_value, raw_value * 1.5) for raw_value in range(0, 1024, 33)]
+
+    await api_client.create_water_tank('Water tank 1', 1, volume_factor, pressure_factor)
+    await api_client.set_water_tank_calibration('Water tank 1', points)
+
+    await api_client.save()
+    await api_client.reset()
+    await api_client.load_api_from_eeprom()
+
+    water_tank = await api_client.get_water_tank('Water tank 1')
+    assert water_tank['calibrationRawValues'] == [raw_value for raw_value, _ in points]
+    assert water_tank['calibrationVolumes'] == [volume for _, volume in points]
+
+
+async def test_save_water_tank_control(api_client: APIClient, clear_eeprom):
+    """
+    Platform should save the control mode and the hysteresis bands of the water tanks in the EEPROM
+    """
+    volume_factor, pressure_factor = 1.5, 2.5
+
+    await api_client.create_water_tank('Water tank 1', 1, volume_factor, pressure_factor)
+    await api_client.set_water_tank_control('Water tank 1', ControlMode.PREDICTIVE, lower_band=5, upper_band=10)
+
+    await api_client.save()
+    await api_client.reset()
+    await api_client.load_api_from_eeprom()
+
+    water_tank = await api_client.get_water_tank('Water tank 1')
+    assert water_tank['controlMode'] == ControlMode.PREDICTIVE
+    assert water_tank['lowerBand'] == 5
+    assert water_tank['upperBand'] == 10
+
+
+async def test_save_water_tank_priority(api_client: APIClient, clear_eeprom):
+    """
+    Platform should save the priority weight of the water tanks in the EEPROM
+    """
+    volume_factor, pressure_factor = 1.5, 2.5
+
+    await api_client.create_water_tank('Water tank 1', 1, volume_factor, pressure_factor)
+    await api_client.set_water_tank_priority('Water tank 1', 3)
+
+    await api_client.save()
+    await api_client.reset()
+    await api_client.load_api_from_eeprom()
+
+    assert (await api_client.get_water_tank('Water tank 1'))['priorityWeight'] == 3
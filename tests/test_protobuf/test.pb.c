@@ -45,6 +45,14 @@ PB_BIND(_TestLoadAPIFromEEPROM, _TestLoadAPIFromEEPROM, AUTO)
 PB_BIND(_TestResetClock, _TestResetClock, AUTO)
 
 
+PB_BIND(_TestGetCounter, _TestGetCounter, AUTO)
+
+
+PB_BIND(_TestBenchmarkLookup, _TestBenchmarkLookup, AUTO)
+
+
+PB_BIND(_TestBenchmarkWaterTankLoop, _TestBenchmarkWaterTankLoop, AUTO)
+
 
 
 
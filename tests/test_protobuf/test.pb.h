@@ -20,6 +20,25 @@ typedef enum __TestSetIOSource_IOSource {
     _TestSetIOSource_IOSource_PHYSICAL = 1 
 } _TestSetIOSource_IOSource;
 
+typedef enum __TestGetCounter_Counter { 
+    _TestGetCounter_Counter_REQUEST_DISPATCHES = 0, 
+    _TestGetCounter_Counter_MAX_QUEUED_FRAMES = 1, 
+    _TestGetCounter_Counter_RX_OVERRUNS = 2, 
+    _TestGetCounter_Counter_TX_DROPS = 3, 
+    _TestGetCounter_Counter_POOL_USAGE = 4, 
+    _TestGetCounter_Counter_POOL_MAX_USAGE = 5, 
+    _TestGetCounter_Counter_POOL_CAPACITY = 6, 
+    _TestGetCounter_Counter_DUTY_CYCLE = 7, 
+    _TestGetCounter_Counter_MAX_ADC_READS_PER_LOOP = 8, 
+    _TestGetCounter_Counter_NOTIFICATION_DROPS = 9 
+} _TestGetCounter_Counter;
+
+typedef enum __TestGetCounter_Pool { 
+    _TestGetCounter_Pool_WATER_TANK_POOL = 0, 
+    _TestGetCounter_Pool_WATER_SOURCE_POOL = 1, 
+    _TestGetCounter_Pool_IO_INTERFACE_POOL = 2 
+} _TestGetCounter_Pool;
+
 /* Struct definitions */
 typedef struct __TestClearIOS { 
     char dummy_field;
@@ -41,11 +60,24 @@ typedef struct __TestResetClock {
     char dummy_field;
 } _TestResetClock;
 
+typedef struct __TestBenchmarkLookup { 
+    uint32_t iterations; 
+} _TestBenchmarkLookup;
+
+typedef struct __TestBenchmarkWaterTankLoop { 
+    uint32_t iterations; 
+} _TestBenchmarkWaterTankLoop;
+
 typedef struct __TestCreateIO { 
     uint32_t pin; 
     _TestCreateIO_IOType type; 
 } _TestCreateIO;
 
+typedef struct __TestGetCounter { 
+    _TestGetCounter_Counter counter; 
+    uint32_t index; 
+} _TestGetCounter;
+
 typedef struct __TestGetIOValue { 
     uint32_t pin; 
 } _TestGetIOValue;
@@ -88,6 +120,9 @@ typedef struct __TestRequest {
         _TestSetIOSource setIOSource;
         _TestLoadAPIFromEEPROM loadAPIFromEEPROM;
         _TestResetClock resetClock;
+        _TestGetCounter getCounter;
+        _TestBenchmarkLookup benchmarkLookup;
+        _TestBenchmarkWaterTankLoop benchmarkWaterTankLoop;
     } message; 
 } _TestRequest;
 
@@ -108,6 +143,14 @@ typedef struct __TestResponse {
 #define __TestSetIOSource_IOSource_MAX _TestSetIOSource_IOSource_PHYSICAL
 #define __TestSetIOSource_IOSource_ARRAYSIZE ((_TestSetIOSource_IOSource)(_TestSetIOSource_IOSource_PHYSICAL+1))
 
+#define __TestGetCounter_Counter_MIN _TestGetCounter_Counter_REQUEST_DISPATCHES
+#define __TestGetCounter_Counter_MAX _TestGetCounter_Counter_NOTIFICATION_DROPS
+#define __TestGetCounter_Counter_ARRAYSIZE ((_TestGetCounter_Counter)(_TestGetCounter_Counter_NOTIFICATION_DROPS+1))
+
+#define __TestGetCounter_Pool_MIN _TestGetCounter_Pool_WATER_TANK_POOL
+#define __TestGetCounter_Pool_MAX _TestGetCounter_Pool_IO_INTERFACE_POOL
+#define __TestGetCounter_Pool_ARRAYSIZE ((_TestGetCounter_Pool)(_TestGetCounter_Pool_IO_INTERFACE_POOL+1))
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -127,6 +170,9 @@ extern "C" {
 #define _TestSetIOSource_init_default            {__TestSetIOSource_IOSource_MIN}
 #define _TestLoadAPIFromEEPROM_init_default      {0}
 #define _TestResetClock_init_default             {0}
+#define _TestGetCounter_init_default             {__TestGetCounter_Counter_MIN, 0}
+#define _TestBenchmarkLookup_init_default        {0}
+#define _TestBenchmarkWaterTankLoop_init_default {0}
 #define _TestRequest_init_zero                   {0, 0, {_TestCreateIO_init_zero}}
 #define _TestResponseValue_init_zero             {0, {0}}
 #define _TestResponse_init_zero                  {0, false, _TestResponseValue_init_zero, 0}
@@ -140,10 +186,17 @@ extern "C" {
 #define _TestSetIOSource_init_zero               {__TestSetIOSource_IOSource_MIN}
 #define _TestLoadAPIFromEEPROM_init_zero         {0}
 #define _TestResetClock_init_zero                {0}
+#define _TestGetCounter_init_zero                {__TestGetCounter_Counter_MIN, 0}
+#define _TestBenchmarkLookup_init_zero           {0}
+#define _TestBenchmarkWaterTankLoop_init_zero    {0}
 
 /* Field tags (for use in manual encoding/decoding) */
+#define _TestBenchmarkLookup_iterations_tag      1
+#define _TestBenchmarkWaterTankLoop_iterations_tag 1
 #define _TestCreateIO_pin_tag                    1
 #define _TestCreateIO_type_tag                   2
+#define _TestGetCounter_counter_tag              1
+#define _TestGetCounter_index_tag                2
 #define _TestGetIOValue_pin_tag                  1
 #define _TestResponseValue_boolValue_tag         2
 #define _TestResponseValue_intValue_tag          3
@@ -165,6 +218,9 @@ extern "C" {
 #define _TestRequest_setIOSource_tag             9
 #define _TestRequest_loadAPIFromEEPROM_tag       10
 #define _TestRequest_resetClock_tag              11
+#define _TestRequest_getCounter_tag              12
+#define _TestRequest_benchmarkLookup_tag         13
+#define _TestRequest_benchmarkWaterTankLoop_tag  14
 #define _TestResponse_id_tag                     1
 #define _TestResponse_message_tag                2
 #define _TestResponse_error_tag                  3
@@ -181,7 +237,10 @@ X(a, STATIC,   ONEOF,    MESSAGE,  (message,setClockOffset,message.setClockOffse
 X(a, STATIC,   ONEOF,    MESSAGE,  (message,getMillis,message.getMillis),   8) \
 X(a, STATIC,   ONEOF,    MESSAGE,  (message,setIOSource,message.setIOSource),   9) \
 X(a, STATIC,   ONEOF,    MESSAGE,  (message,loadAPIFromEEPROM,message.loadAPIFromEEPROM),  10) \
-X(a, STATIC,   ONEOF,    MESSAGE,  (message,resetClock,message.resetClock),  11)
+X(a, STATIC,   ONEOF,    MESSAGE,  (message,resetClock,message.resetClock),  11) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (message,getCounter,message.getCounter),  12) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (message,benchmarkLookup,message.benchmarkLookup),  13) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (message,benchmarkWaterTankLoop,message.benchmarkWaterTankLoop),  14)
 #define _TestRequest_CALLBACK NULL
 #define _TestRequest_DEFAULT NULL
 #define _TestRequest_message_createIO_MSGTYPE _TestCreateIO
@@ -194,6 +253,9 @@ X(a, STATIC,   ONEOF,    MESSAGE,  (message,resetClock,message.resetClock),  11)
 #define _TestRequest_message_setIOSource_MSGTYPE _TestSetIOSource
 #define _TestRequest_message_loadAPIFromEEPROM_MSGTYPE _TestLoadAPIFromEEPROM
 #define _TestRequest_message_resetClock_MSGTYPE _TestResetClock
+#define _TestRequest_message_getCounter_MSGTYPE _TestGetCounter
+#define _TestRequest_message_benchmarkLookup_MSGTYPE _TestBenchmarkLookup
+#define _TestRequest_message_benchmarkWaterTankLoop_MSGTYPE _TestBenchmarkWaterTankLoop
 
 #define _TestResponseValue_FIELDLIST(X, a) \
 X(a, STATIC,   ONEOF,    BOOL,     (value,boolValue,value.boolValue),   2) \
@@ -264,6 +326,22 @@ X(a, STATIC,   SINGULAR, UENUM,    source,            1)
 #define _TestResetClock_CALLBACK NULL
 #define _TestResetClock_DEFAULT NULL
 
+#define _TestGetCounter_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, UENUM,    counter,           1) \
+X(a, STATIC,   SINGULAR, UINT32,   index,             2)
+#define _TestGetCounter_CALLBACK NULL
+#define _TestGetCounter_DEFAULT NULL
+
+#define _TestBenchmarkLookup_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, UINT32,   iterations,        1)
+#define _TestBenchmarkLookup_CALLBACK NULL
+#define _TestBenchmarkLookup_DEFAULT NULL
+
+#define _TestBenchmarkWaterTankLoop_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, UINT32,   iterations,        1)
+#define _TestBenchmarkWaterTankLoop_CALLBACK NULL
+#define _TestBenchmarkWaterTankLoop_DEFAULT NULL
+
 extern const pb_msgdesc_t _TestRequest_msg;
 extern const pb_msgdesc_t _TestResponseValue_msg;
 extern const pb_msgdesc_t _TestResponse_msg;
@@ -277,6 +355,9 @@ extern const pb_msgdesc_t _TestGetMillis_msg;
 extern const pb_msgdesc_t _TestSetIOSource_msg;
 extern const pb_msgdesc_t _TestLoadAPIFromEEPROM_msg;
 extern const pb_msgdesc_t _TestResetClock_msg;
+extern const pb_msgdesc_t _TestGetCounter_msg;
+extern const pb_msgdesc_t _TestBenchmarkLookup_msg;
+extern const pb_msgdesc_t _TestBenchmarkWaterTankLoop_msg;
 
 /* Defines for backwards compatibility with code written before nanopb-0.4.0 */
 #define _TestRequest_fields &_TestRequest_msg
@@ -292,11 +373,17 @@ extern const pb_msgdesc_t _TestResetClock_msg;
 #define _TestSetIOSource_fields &_TestSetIOSource_msg
 #define _TestLoadAPIFromEEPROM_fields &_TestLoadAPIFromEEPROM_msg
 #define _TestResetClock_fields &_TestResetClock_msg
+#define _TestGetCounter_fields &_TestGetCounter_msg
+#define _TestBenchmarkLookup_fields &_TestBenchmarkLookup_msg
+#define _TestBenchmarkWaterTankLoop_fields &_TestBenchmarkWaterTankLoop_msg
 
 /* Maximum encoded size of messages (where known) */
+#define _TestBenchmarkLookup_size                6
+#define _TestBenchmarkWaterTankLoop_size         6
 #define _TestClearIOS_size                       0
 #define _TestCreateIO_size                       8
 #define _TestFreeMemory_size                     0
+#define _TestGetCounter_size                     8
 #define _TestGetIOValue_size                     6
 #define _TestGetMillis_size                      0
 #define _TestLoadAPIFromEEPROM_size              0
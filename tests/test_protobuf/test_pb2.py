@@ -14,7 +14,7 @@ _sym_db = _symbol_database.Default()
 
 
 
-DESCRIPTOR = _descriptor_pool.Default().AddSerializedFile(b'\n\ntest.proto\"\xc3\x03\n\x0c_TestRequest\x12\n\n\x02id\x18\x01 \x01(\r\x12\"\n\x08\x63reateIO\x18\x02 \x01(\x0b\x32\x0e._TestCreateIOH\x00\x12&\n\nsetIOValue\x18\x03 \x01(\x0b\x32\x10._TestSetIOValueH\x00\x12&\n\ngetIOValue\x18\x04 \x01(\x0b\x32\x10._TestGetIOValueH\x00\x12\"\n\x08\x63learIOs\x18\x05 \x01(\x0b\x32\x0e._TestClearIOSH\x00\x12&\n\nfreeMemory\x18\x06 \x01(\x0b\x32\x10._TestFreeMemoryH\x00\x12.\n\x0esetClockOffset\x18\x07 \x01(\x0b\x32\x14._TestSetClockOffsetH\x00\x12$\n\tgetMillis\x18\x08 \x01(\x0b\x32\x0f._TestGetMillisH\x00\x12(\n\x0bsetIOSource\x18\t \x01(\x0b\x32\x11._TestSetIOSourceH\x00\x12\x34\n\x11loadAPIFromEEPROM\x18\n \x01(\x0b\x32\x17._TestLoadAPIFromEEPROMH\x00\x12&\n\nresetClock\x18\x0b \x01(\x0b\x32\x10._TestResetClockH\x00\x42\t\n\x07message\"\x89\x01\n\x12_TestResponseValue\x12\x13\n\tboolValue\x18\x02 \x01(\x08H\x00\x12\x12\n\x08intValue\x18\x03 \x01(\x05H\x00\x12\x13\n\tuintValue\x18\x04 \x01(\rH\x00\x12\x15\n\x0b\x64oubleValue\x18\x05 \x01(\x02H\x00\x12\x15\n\x0bstringValue\x18\x06 \x01(\tH\x00\x42\x07\n\x05value\"P\n\r_TestResponse\x12\n\n\x02id\x18\x01 \x01(\x04\x12$\n\x07message\x18\x02 \x01(\x0b\x32\x13._TestResponseValue\x12\r\n\x05\x65rror\x18\x03 \x01(\x08\"f\n\r_TestCreateIO\x12\x0b\n\x03pin\x18\x01 \x01(\r\x12#\n\x04type\x18\x02 \x01(\x0e\x32\x15._TestCreateIO.IOType\"#\n\x06IOType\x12\x0b\n\x07\x44IGITAL\x10\x00\x12\x0c\n\x08\x41NALOGIC\x10\x01\"-\n\x0f_TestSetIOValue\x12\x0b\n\x03pin\x18\x01 \x01(\r\x12\r\n\x05value\x18\x02 \x01(\r\"\x1e\n\x0f_TestGetIOValue\x12\x0b\n\x03pin\x18\x01 \x01(\r\"\x0f\n\r_TestClearIOS\"\x11\n\x0f_TestFreeMemory\"$\n\x13_TestSetClockOffset\x12\r\n\x05value\x18\x01 \x01(\r\"\x10\n\x0e_TestGetMillis\"e\n\x10_TestSetIOSource\x12*\n\x06source\x18\x01 \x01(\x0e\x32\x1a._TestSetIOSource.IOSource\"%\n\x08IOSource\x12\x0b\n\x07VIRTUAL\x10\x00\x12\x0c\n\x08PHYSICAL\x10\x01\"\x18\n\x16_TestLoadAPIFromEEPROM\"\x11\n\x0f_TestResetClockb\x06proto3')
+DESCRIPTOR = _descriptor_pool.Default().AddSerializedFile(b'\n\ntest.proto\"\xdd\x04\n\x0c_TestRequest\x12\n\n\x02id\x18\x01 \x01(\r\x12\"\n\x08\x63reateIO\x18\x02 \x01(\x0b\x32\x0e._TestCreateIOH\x00\x12&\n\nsetIOValue\x18\x03 \x01(\x0b\x32\x10._TestSetIOValueH\x00\x12&\n\ngetIOValue\x18\x04 \x01(\x0b\x32\x10._TestGetIOValueH\x00\x12\"\n\x08\x63learIOs\x18\x05 \x01(\x0b\x32\x0e._TestClearIOSH\x00\x12&\n\nfreeMemory\x18\x06 \x01(\x0b\x32\x10._TestFreeMemoryH\x00\x12.\n\x0esetClockOffset\x18\x07 \x01(\x0b\x32\x14._TestSetClockOffsetH\x00\x12$\n\tgetMillis\x18\x08 \x01(\x0b\x32\x0f._TestGetMillisH\x00\x12(\n\x0bsetIOSource\x18\t \x01(\x0b\x32\x11._TestSetIOSourceH\x00\x12\x34\n\x11loadAPIFromEEPROM\x18\n \x01(\x0b\x32\x17._TestLoadAPIFromEEPROMH\x00\x12&\n\nresetClock\x18\x0b \x01(\x0b\x32\x10._TestResetClockH\x00\x12&\n\ngetCounter\x18\x0c \x01(\x0b\x32\x10._TestGetCounterH\x00\x12\x30\n\x0f\x62\x65nchmarkLookup\x18\r \x01(\x0b\x32\x15._TestBenchmarkLookupH\x00\x12>\n\x16\x62\x65nchmarkWaterTankLoop\x18\x0e \x01(\x0b\x32\x1c._TestBenchmarkWaterTankLoopH\x00\x42\t\n\x07message\"\x89\x01\n\x12_TestResponseValue\x12\x13\n\tboolValue\x18\x02 \x01(\x08H\x00\x12\x12\n\x08intValue\x18\x03 \x01(\x05H\x00\x12\x13\n\tuintValue\x18\x04 \x01(\rH\x00\x12\x15\n\x0b\x64oubleValue\x18\x05 \x01(\x02H\x00\x12\x15\n\x0bstringValue\x18\x06 \x01(\tH\x00\x42\x07\n\x05value\"P\n\r_TestResponse\x12\n\n\x02id\x18\x01 \x01(\x04\x12$\n\x07message\x18\x02 \x01(\x0b\x32\x13._TestResponseValue\x12\r\n\x05\x65rror\x18\x03 \x01(\x08\"f\n\r_TestCreateIO\x12\x0b\n\x03pin\x18\x01 \x01(\r\x12#\n\x04type\x18\x02 \x01(\x0e\x32\x15._TestCreateIO.IOType\"#\n\x06IOType\x12\x0b\n\x07\x44IGITAL\x10\x00\x12\x0c\n\x08\x41NALOGIC\x10\x01\"-\n\x0f_TestSetIOValue\x12\x0b\n\x03pin\x18\x01 \x01(\r\x12\r\n\x05value\x18\x02 \x01(\r\"\x1e\n\x0f_TestGetIOValue\x12\x0b\n\x03pin\x18\x01 \x01(\r\"\x0f\n\r_TestClearIOS\"\x11\n\x0f_TestFreeMemory\"$\n\x13_TestSetClockOffset\x12\r\n\x05value\x18\x01 \x01(\r\"\x10\n\x0e_TestGetMillis\"e\n\x10_TestSetIOSource\x12*\n\x06source\x18\x01 \x01(\x0e\x32\x1a._TestSetIOSource.IOSource\"%\n\x08IOSource\x12\x0b\n\x07VIRTUAL\x10\x00\x12\x0c\n\x08PHYSICAL\x10\x01\"\x18\n\x16_TestLoadAPIFromEEPROM\"\x11\n\x0f_TestResetClock\"\xeb\x02\n\x0f_TestGetCounter\x12)\n\x07\x63ounter\x18\x01 \x01(\x0e\x32\x18._TestGetCounter.Counter\x12\r\n\x05index\x18\x02 \x01(\r\"\xd2\x01\n\x07\x43ounter\x12\x16\n\x12REQUEST_DISPATCHES\x10\x00\x12\x15\n\x11MAX_QUEUED_FRAMES\x10\x01\x12\x0f\n\x0bRX_OVERRUNS\x10\x02\x12\x0c\n\x08TX_DROPS\x10\x03\x12\x0e\n\nPOOL_USAGE\x10\x04\x12\x12\n\x0ePOOL_MAX_USAGE\x10\x05\x12\x11\n\rPOOL_CAPACITY\x10\x06\x12\x0e\n\nDUTY_CYCLE\x10\x07\x12\x1a\n\x16MAX_ADC_READS_PER_LOOP\x10\x08\x12\x16\n\x12NOTIFICATION_DROPS\x10\t\"I\n\x04Pool\x12\x13\n\x0fWATER_TANK_POOL\x10\x00\x12\x15\n\x11WATER_SOURCE_POOL\x10\x01\x12\x15\n\x11IO_INTERFACE_POOL\x10\x02\"*\n\x14_TestBenchmarkLookup\x12\x12\n\niterations\x18\x01 \x01(\r\"1\n\x1b_TestBenchmarkWaterTankLoop\x12\x12\n\niterations\x18\x01 \x01(\rb\x06proto3')
 
 
 
@@ -31,8 +31,13 @@ __TESTGETMILLIS = DESCRIPTOR.message_types_by_name['_TestGetMillis']
 __TESTSETIOSOURCE = DESCRIPTOR.message_types_by_name['_TestSetIOSource']
 __TESTLOADAPIFROMEEPROM = DESCRIPTOR.message_types_by_name['_TestLoadAPIFromEEPROM']
 __TESTRESETCLOCK = DESCRIPTOR.message_types_by_name['_TestResetClock']
+__TESTGETCOUNTER = DESCRIPTOR.message_types_by_name['_TestGetCounter']
+__TESTBENCHMARKLOOKUP = DESCRIPTOR.message_types_by_name['_TestBenchmarkLookup']
+__TESTBENCHMARKWATERTANKLOOP = DESCRIPTOR.message_types_by_name['_TestBenchmarkWaterTankLoop']
 __TESTCREATEIO_IOTYPE = __TESTCREATEIO.enum_types_by_name['IOType']
 __TESTSETIOSOURCE_IOSOURCE = __TESTSETIOSOURCE.enum_types_by_name['IOSource']
+__TESTGETCOUNTER_COUNTER = __TESTGETCOUNTER.enum_types_by_name['Counter']
+__TESTGETCOUNTER_POOL = __TESTGETCOUNTER.enum_types_by_name['Pool']
 _TestRequest = _reflection.GeneratedProtocolMessageType('_TestRequest', (_message.Message,), {
   'DESCRIPTOR' : __TESTREQUEST,
   '__module__' : 'test_pb2'
@@ -124,37 +129,68 @@ _TestResetClock = _reflection.GeneratedProtocolMessageType('_TestResetClock', (_
   })
 _sym_db.RegisterMessage(_TestResetClock)
 
+_TestGetCounter = _reflection.GeneratedProtocolMessageType('_TestGetCounter', (_message.Message,), {
+  'DESCRIPTOR' : __TESTGETCOUNTER,
+  '__module__' : 'test_pb2'
+  # @@protoc_insertion_point(class_scope:_TestGetCounter)
+  })
+_sym_db.RegisterMessage(_TestGetCounter)
+
+_TestBenchmarkLookup = _reflection.GeneratedProtocolMessageType('_TestBenchmarkLookup', (_message.Message,), {
+  'DESCRIPTOR' : __TESTBENCHMARKLOOKUP,
+  '__module__' : 'test_pb2'
+  # @@protoc_insertion_point(class_scope:_TestBenchmarkLookup)
+  })
+_sym_db.RegisterMessage(_TestBenchmarkLookup)
+
+_TestBenchmarkWaterTankLoop = _reflection.GeneratedProtocolMessageType('_TestBenchmarkWaterTankLoop', (_message.Message,), {
+  'DESCRIPTOR' : __TESTBENCHMARKWATERTANKLOOP,
+  '__module__' : 'test_pb2'
+  # @@protoc_insertion_point(class_scope:_TestBenchmarkWaterTankLoop)
+  })
+_sym_db.RegisterMessage(_TestBenchmarkWaterTankLoop)
+
 if _descriptor._USE_C_DESCRIPTORS == False:
 
   DESCRIPTOR._options = None
   __TESTREQUEST._serialized_start=15
-  __TESTREQUEST._serialized_end=466
-  __TESTRESPONSEVALUE._serialized_start=469
-  __TESTRESPONSEVALUE._serialized_end=606
-  __TESTRESPONSE._serialized_start=608
-  __TESTRESPONSE._serialized_end=688
-  __TESTCREATEIO._serialized_start=690
-  __TESTCREATEIO._serialized_end=792
-  __TESTCREATEIO_IOTYPE._serialized_start=757
-  __TESTCREATEIO_IOTYPE._serialized_end=792
-  __TESTSETIOVALUE._serialized_start=794
-  __TESTSETIOVALUE._serialized_end=839
-  __TESTGETIOVALUE._serialized_start=841
-  __TESTGETIOVALUE._serialized_end=871
-  __TESTCLEARIOS._serialized_start=873
-  __TESTCLEARIOS._serialized_end=888
-  __TESTFREEMEMORY._serialized_start=890
-  __TESTFREEMEMORY._serialized_end=907
-  __TESTSETCLOCKOFFSET._serialized_start=909
-  __TESTSETCLOCKOFFSET._serialized_end=945
-  __TESTGETMILLIS._serialized_start=947
-  __TESTGETMILLIS._serialized_end=963
-  __TESTSETIOSOURCE._serialized_start=965
-  __TESTSETIOSOURCE._serialized_end=1066
-  __TESTSETIOSOURCE_IOSOURCE._serialized_start=1029
-  __TESTSETIOSOURCE_IOSOURCE._serialized_end=1066
-  __TESTLOADAPIFROMEEPROM._serialized_start=1068
-  __TESTLOADAPIFROMEEPROM._serialized_end=1092
-  __TESTRESETCLOCK._serialized_start=1094
-  __TESTRESETCLOCK._serialized_end=1111
+  __TESTREQUEST._serialized_end=620
+  __TESTRESPONSEVALUE._serialized_start=623
+  __TESTRESPONSEVALUE._serialized_end=760
+  __TESTRESPONSE._serialized_start=762
+  __TESTRESPONSE._serialized_end=842
+  __TESTCREATEIO._serialized_start=844
+  __TESTCREATEIO._serialized_end=946
+  __TESTCREATEIO_IOTYPE._serialized_start=911
+  __TESTCREATEIO_IOTYPE._serialized_end=946
+  __TESTSETIOVALUE._serialized_start=948
+  __TESTSETIOVALUE._serialized_end=993
+  __TESTGETIOVALUE._serialized_start=995
+  __TESTGETIOVALUE._serialized_end=1025
+  __TESTCLEARIOS._serialized_start=1027
+  __TESTCLEARIOS._serialized_end=1042
+  __TESTFREEMEMORY._serialized_start=1044
+  __TESTFREEMEMORY._serialized_end=1061
+  __TESTSETCLOCKOFFSET._serialized_start=1063
+  __TESTSETCLOCKOFFSET._serialized_end=1099
+  __TESTGETMILLIS._serialized_start=1101
+  __TESTGETMILLIS._serialized_end=1117
+  __TESTSETIOSOURCE._serialized_start=1119
+  __TESTSETIOSOURCE._serialized_end=1220
+  __TESTSETIOSOURCE_IOSOURCE._serialized_start=1183
+  __TESTSETIOSOURCE_IOSOURCE._serialized_end=1220
+  __TESTLOADAPIFROMEEPROM._serialized_start=1222
+  __TESTLOADAPIFROMEEPROM._serialized_end=1246
+  __TESTRESETCLOCK._serialized_start=1248
+  __TESTRESETCLOCK._serialized_end=1265
+  __TESTGETCOUNTER._serialized_start=1268
+  __TESTGETCOUNTER._serialized_end=1631
+  __TESTGETCOUNTER_COUNTER._serialized_start=1346
+  __TESTGETCOUNTER_COUNTER._serialized_end=1556
+  __TESTGETCOUNTER_POOL._serialized_start=1558
+  __TESTGETCOUNTER_POOL._serialized_end=1631
+  __TESTBENCHMARKLOOKUP._serialized_start=1633
+  __TESTBENCHMARKLOOKUP._serialized_end=1675
+  __TESTBENCHMARKWATERTANKLOOP._serialized_start=1677
+  __TESTBENCHMARKWATERTANKLOOP._serialized_end=1726
 # @@protoc_insertion_point(module_scope)
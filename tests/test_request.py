@@ -8,7 +8,9 @@ import pytest
 from protobuf.out.python.api_pb2 import Request, Response
 
 from .lib.api import APIClient
-from .lib.api.exceptions import APIException
+from .lib.api.models import Counter
+from .lib.api.exceptions import APIException, APIInvalidRequest
+from .lib.api.arduino import DEFAULT_BAUDRATE
 
 LOGGER = logging.getLogger(__name__)
 
@@ -69,6 +71,97 @@ async def test_handle_after_truncated_messages(api_client: APIClient):
 
     assert not water_sources
 
+async def test_handle_after_truncated_request_payload(api_client: APIClient):
+    """
+    Platform should drop a request whose payload stops arriving while it is decoded.
+    Platform should answer "Truncated message received"
+    """
+    request = api_client.create_request('createWaterSource', name=f'Compesa water source', pin=15)
+    payload = api_client.build_request_wrapper(request)
+
+    future = await api_client.send_payload(payload[:len(payload) - 3], request.id)
+
+    response = await asyncio.wait_for(api_client.get_error_response(), timeout=7)
+
+    assert response.id == 0
+    assert response.exception_type is APIException
+    assert response.message == 'Truncated message received'
+
+    water_sources = await api_client.get_water_source_list()
+
+    assert not water_sources
+
+
+async def test_handle_after_truncated_batch(api_client: APIClient):
+    """
+    Platform should answer the messages of a batch that stops arriving, the ones that have not
+    arrived with "Truncated message received", once the read timeout passes.
+    """
+    requests = [api_client.create_request('createWaterSource', name='Compesa water source', pin=15),
+                api_client.create_request('getWaterSourceList')]
+    payload = api_client.build_batch_request_wrapper(requests)
+    second_message_length = len(requests[1].SerializeToString()) + struct.calcsize('<H')
+
+    futures = await api_client.send_batch_payload(payload[:-second_message_length], [requests[0].id])
+
+    response = await asyncio.wait_for(api_client.get_error_response(), timeout=7)
+
+    assert response.id == 0
+    assert response.message == 'Truncated message received'
+    assert futures[0].done() and futures[0].exception() is None
+
+    assert await api_client.get_water_source_list() == ['Compesa water source']
+
+
+async def test_handle_after_oversized_message(api_client: APIClient):
+    """
+    Platform should refuse a message longer than the largest request before decoding it.
+    Platform should answer "Invalid message"
+    """
+    payload = struct.pack('<BH', 1, 0xFFFF)
+
+    future = await api_client.send_payload(payload, next(api_client.REQUEST_ID_ITERATOR))
+
+    response = await asyncio.wait_for(api_client.get_error_response(), timeout=7)
+
+    assert response.id == 0
+    assert response.exception_type is APIException
+    assert response.message == 'Invalid message'
+
+    # the payload that never arrives is waited for until the read timeout
+    await asyncio.sleep(3)
+
+    water_source_name = 'Compesa water source'
+
+    await api_client.create_water_source(water_source_name, 15)
+
+    assert await api_client.get_water_source_list() == [water_source_name]
+
+
+async def test_drop_payload_of_oversized_message(api_client: APIClient):
+    """
+    Platform should drop the payload of a message longer than the largest request, so it is not
+    parsed as the next messages, and answer the following request right away.
+    """
+    oversized_length = 600
+    payload = struct.pack('<BH', 1, oversized_length) + bytes(random.randrange(256) for _ in range(oversized_length))
+
+    await api_client.send_payload(payload, next(api_client.REQUEST_ID_ITERATOR))
+
+    water_source_name = 'Compesa water source'
+
+    await asyncio.wait_for(api_client.create_water_source(water_source_name, 15), timeout=3)
+
+    response = await asyncio.wait_for(api_client.get_error_response(), timeout=1)
+
+    assert response.id == 0
+    assert response.message == 'Invalid message'
+
+    with pytest.raises(asyncio.TimeoutError):
+        await asyncio.wait_for(api_client.get_error_response(), timeout=1)
+
+    assert await api_client.get_water_source_list() == [water_source_name]
+
 @pytest.mark.xfail(reason='APIClient currently does not support large requests')
 async def test_send_large_invalid_request(api_client: APIClient):
     """
@@ -119,3 +212,177 @@ async def test_reset_with_water_tank_and_source_dependency(api_client: APIClient
 
     assert await api_client.get_water_source_list() == []
     assert await api_client.get_water_tank_list() == []
+
+
+async def test_batch_requests(api_client: APIClient):
+    """
+    Platform should be able to handle several requests sent in a single batch message
+    and answer each one of them in the same order.
+    """
+    water_source_name, water_source_pin = 'Compesa water source', 15
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+
+    requests = [
+        api_client.create_request('createWaterSource', name=water_source_name, pin=water_source_pin),
+        api_client.create_request('createWaterTank', name=water_tank_name, pressureSensorPin=pressure_sensor,
+                                  volumeFactor=volume_factor, pressureFactor=pressure_factor, waterSourceName=water_source_name),
+        api_client.create_request('setWaterTankMaxVolume', waterTankName=water_tank_name, value=100),
+        api_client.create_request('setWaterTankActive', waterTankName=water_tank_name, active=False),
+        api_client.create_request('getWaterTankList')
+    ]
+
+    results = await api_client.send_batch(requests)
+
+    assert len(results) == len(requests)
+    assert results[-1] == [water_tank_name]
+
+    water_tank = await api_client.get_water_tank(water_tank_name)
+
+    assert water_tank['maxVolume'] == 100
+    assert water_tank['active'] is False
+    assert water_tank['waterSource'] == water_source_name
+
+
+async def test_batch_requests_with_error(api_client: APIClient):
+    """Platform should answer each request of a batch even when one of them fails"""
+    water_source_name, water_source_pin = 'Compesa water source', 15
+
+    requests = [
+        api_client.create_request('createWaterSource', name=water_source_name, pin=water_source_pin),
+        api_client.create_request('createWaterSource', name=water_source_name, pin=water_source_pin),
+        api_client.create_request('getWaterSourceList')
+    ]
+
+    results = await api_client.send_batch(requests, return_exceptions=True)
+
+    assert not isinstance(results[0], APIException)
+    assert isinstance(results[1], APIException)
+    assert results[1].response.message == 'There is already a water source with that name registered'
+    assert results[2] == [water_source_name]
+
+
+async def test_request_dispatch_counts(api_client: APIClient):
+    """Platform should dispatch each request to the handler of its tag, once per request"""
+    get_mode_tag = Request.DESCRIPTOR.fields_by_name['getMode'].number
+    get_water_tank_list_tag = Request.DESCRIPTOR.fields_by_name['getWaterTankList'].number
+
+    get_mode_count = await api_client.get_counter(Counter.REQUEST_DISPATCHES, get_mode_tag)
+    get_water_tank_list_count = await api_client.get_counter(Counter.REQUEST_DISPATCHES, get_water_tank_list_tag)
+
+    for _ in range(3):
+        await api_client.get_operation_mode()
+    await api_client.get_water_tank_list()
+
+    assert await api_client.get_counter(Counter.REQUEST_DISPATCHES, get_mode_tag) == get_mode_count + 3
+    assert await api_client.get_counter(Counter.REQUEST_DISPATCHES, get_water_tank_list_tag) == get_water_tank_list_count + 1
+
+
+async def test_pipelined_requests(api_client: APIClient):
+    """
+    Platform should queue the frames that arrive together and answer all of them,
+    without dropping bytes of the frames waiting in the queue.
+    """
+    requests = [api_client.create_request('createWaterSource', name=f'Water source {pin}', pin=pin) for pin in range(4)]
+    requests.append(api_client.create_request('getWaterSourceList'))
+    payload = b''.join(api_client.build_request_wrapper(request) for request in requests)
+
+    futures = await api_client.send_batch_payload(payload, [request.id for request in requests])
+    responses = await asyncio.wait_for(asyncio.gather(*futures), timeout=10)
+
+    assert responses[-1] == [f'Water source {pin}' for pin in range(4)]
+
+    assert await api_client.get_counter(Counter.MAX_QUEUED_FRAMES) >= 2
+    assert await api_client.get_counter(Counter.RX_OVERRUNS) == 0
+
+
+async def test_cobs_framing_drops_corrupted_frames(api_client: APIClient, cobs_framing):
+    """
+    Platform should reject a corrupted COBS frame by its CRC and handle the next frame right away,
+    without waiting for the read timeout.
+    """
+    request = api_client.create_request('createWaterSource', name='Corrupted water source', pin=14)
+    frame = bytearray(api_client.build_frame(api_client.build_request_wrapper(request)))
+    frame[5] = frame[5] ^ 0x01 or 0x02
+    lost_byte_frame = frame[:3] + frame[4:]
+
+    for corrupted_frame in (frame, lost_byte_frame):
+        await api_client.send_raw(bytes(corrupted_frame))
+        response = await asyncio.wait_for(api_client.get_error_response(), timeout=1)
+
+        assert response.id == 0
+        assert response.exception_type is APIException
+        assert response.message == 'Corrupted message received'
+
+    await asyncio.wait_for(api_client.create_water_source('Water source', 15), timeout=1)
+
+    assert await api_client.get_water_source_list() == ['Water source']
+
+
+async def test_queued_replies_are_not_dropped(api_client: APIClient):
+    """
+    Platform should queue the replies while the serial port sends them and never drop one,
+    even when they don't fit in the TX queue.
+    """
+    for pin in range(1, 4):
+        await api_client.create_water_tank(f'Water tank {pin}', pin, 1.5, 2)
+
+    requests = [api_client.create_request('getSystemState') for _ in range(6)]
+    payload = b''.join(api_client.build_request_wrapper(request) for request in requests)
+
+    futures = await api_client.send_batch_payload(payload, [request.id for request in requests])
+    responses = await asyncio.wait_for(asyncio.gather(*futures), timeout=10)
+
+    assert all(len(response['waterTanks']) == 3 for response in responses)
+    assert await api_client.get_counter(Counter.TX_DROPS) == 0
+
+
+async def test_set_baud_rate(api_client: APIClient):
+    """
+    Platform should switch to a supported baud rate after answering the request
+    and refuse an unsupported one.
+    """
+    try:
+        await api_client.set_baud_rate(115200)
+
+        await api_client.create_water_source('Water source', 15)
+        assert await api_client.get_water_source_list() == ['Water source']
+    finally:
+        await api_client.set_baud_rate(DEFAULT_BAUDRATE)
+
+    with pytest.raises(APIInvalidRequest) as exc_info:
+        await api_client.set_baud_rate(1234)
+
+    response = exc_info.value.response
+    assert response.message == 'Invalid baud rate'
+
+
+async def test_events_are_not_mixed_with_a_streamed_reply(api_client: APIClient):
+    """
+    Platform should not send a queued event in the middle of a reply streamed while it reads a batch
+    larger than the RX buffer.
+    """
+    water_tank_names = [f'Water tank num {pin:03}' for pin in range(1, 6)]
+    for pin, water_tank_name in enumerate(water_tank_names, 1):
+        await api_client.create_water_tank(water_tank_name, pin, 1, 1)
+
+    await api_client.subscribe(minimum_interval=0, volume_deadband=0.5)
+    try:
+        # the volume events are queued while the batch arrives
+        for pin in range(1, 6):
+            await api_client.set_io_value(pin, 10 * pin)
+
+        requests = [api_client.create_request('getWaterTank', waterTankName=water_tank_names[i % len(water_tank_names)])
+                    for i in range(30)]
+        assert len(api_client.build_batch_request_wrapper(requests)) > 512
+
+        responses = await asyncio.wait_for(api_client.send_batch(requests), timeout=10)
+
+        assert [response['name'] for response in responses] == [request.getWaterTank.waterTankName for request in requests]
+
+        # the events keep being parsed after the reply
+        await api_client.set_io_value(1, 100)
+        event = await asyncio.wait_for(api_client.get_event(), timeout=7)
+        while event['resource'] != water_tank_names[0] or event['value'] != 100:
+            event = await asyncio.wait_for(api_client.get_event(), timeout=7)
+    finally:
+        await api_client.unsubscribe()
@@ -0,0 +1,42 @@
+import pytest
+
+from .lib.api import APIClient
+from .lib.api.models import OperationMode
+
+
+async def test_get_empty_system_state(api_client: APIClient):
+    """Platform should be able to get the system state when there are no resources"""
+    system_state = await api_client.get_system_state()
+
+    assert system_state['waterTanks'] == []
+    assert system_state['waterSources'] == []
+    assert system_state['mode'] == OperationMode.MANUAL
+    assert system_state['error'] is None
+
+
+async def test_get_system_state(api_client: APIClient):
+    """Platform should be able to get all water tanks, water sources and the operation mode in a single request"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1.5, 2
+    water_source_name_1, water_source_pin_1 = 'Compesa water source', 15
+    water_source_name_2, water_source_pin_2 = 'Water pump', 16
+
+    await api_client.create_water_source(water_source_name_1, water_source_pin_1)
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor, water_source_name_1)
+    await api_client.create_water_source(water_source_name_2, water_source_pin_2, water_tank_name)
+
+    await api_client.set_io_value(pressure_sensor, 10)
+    await api_client.set_operation_mode(OperationMode.AUTO)
+
+    system_state = await api_client.get_system_state()
+
+    assert system_state['mode'] == OperationMode.AUTO
+    assert [water_source['name'] for water_source in system_state['waterSources']] == [water_source_name_1, water_source_name_2]
+    assert system_state['waterSources'][1]['sourceWaterTank'] == water_tank_name
+
+    water_tank = system_state['waterTanks'][0]
+
+    assert len(system_state['waterTanks']) == 1
+    assert water_tank == await api_client.get_water_tank(water_tank_name)
+    assert water_tank['rawPressureValue'] == 10
+    assert water_tank['pressure'] == 10 * pressure_factor
+    assert water_tank['volume'] == 10 * pressure_factor * volume_factor
@@ -376,3 +376,39 @@ async def test_create_empty_water_source(api_client: APIClient):
     response = exc_info.value.response
     assert response.exception_type is APIInvalidRequest
     assert response.message == 'Cannot create a resource with an empty name'
+
+
+async def test_water_source_handle(api_client: APIClient):
+    """
+    Platform should return a handle when creating a water source, the handle can be used instead of the name.
+    The handle of a removed water source should be reused by the next water source created
+    """
+    name, pin = 'Compesa water source', 15
+
+    handle = await api_client.create_water_source(name, pin)
+    other_handle = await api_client.create_water_source('Water source 2', 16)
+
+    assert handle == 1
+    assert other_handle == 2
+
+    water_source = await api_client.get_water_source(handle)
+
+    assert water_source['name'] == name
+    assert water_source['handle'] == handle
+
+    await api_client.set_water_source_active(handle, False)
+
+    assert (await api_client.get_water_source(name))['active'] == False
+
+    await api_client.remove_water_source(handle)
+
+    assert await api_client.get_water_source_list() == ['Water source 2']
+    assert (await api_client.get_water_source(other_handle))['name'] == 'Water source 2'
+
+    with pytest.raises(APIInvalidRequest) as exc_info:
+        await api_client.get_water_source(handle)
+
+    response = exc_info.value.response
+    assert response.message == 'Could not find a water source with the name provided'
+
+    assert await api_client.create_water_source(name, pin) == handle
@@ -5,7 +5,7 @@ import logging
 import pytest
 
 from .lib.api import APIClient
-from .lib.api.models import OperationMode
+from .lib.api.models import OperationMode, FilterType
 from .lib.api.exceptions import APIException, APIInvalidRequest
 
 LOGGER = logging.getLogger(__name__)
@@ -524,6 +524,23 @@ async def test_stop_fill_water_tank_in_manual_mode(api_client: APIClient):
     assert not water_tank['filling']
 
 
+async def test_deactivate_water_tank_turns_off_water_source_in_manual_mode(api_client: APIClient):
+    """Platform should turn off the water source of a deactivated water tank in manual mode, even when it was turned on by its state"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1.5, 2.5
+    water_source_name, water_source_pin = 'Compesa water source', 15
+
+    await api_client.create_water_source(water_source_name, water_source_pin)
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor, water_source_name)
+
+    await api_client.set_water_source_state(water_source_name, True)
+
+    assert (await api_client.get_water_tank(water_tank_name))['filling']
+
+    await api_client.set_water_tank_active(water_tank_name, False)
+
+    assert not (await api_client.get_water_source(water_source_name))['turnedOn']
+
+
 async def test_fill_water_tank_with_max_volume(api_client: APIClient):
     """
     Platform should respond with an error when trying to fill water tank 
@@ -674,3 +691,261 @@ async def test_create_empty_water_tank(api_client: APIClient):
     response = exc_info.value.response
     assert response.exception_type is APIInvalidRequest
     assert response.message == 'Cannot create a resource with an empty name'
+
+
+async def test_water_tank_handle(api_client: APIClient):
+    """Platform should return a handle when creating a water tank, the handle can be used instead of the name"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1.5, 2.5
+    water_source_name, water_source_pin = 'Compesa water source', 15
+
+    water_source_handle = await api_client.create_water_source(water_source_name, water_source_pin)
+    handle = await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor,
+                                                pressure_factor, water_source_handle)
+
+    assert handle == 1
+
+    await api_client.set_water_tank_max_volume(handle, 100)
+    await api_client.set_water_tank_minimum_volume(handle, 20)
+
+    water_tank = await api_client.get_water_tank(handle)
+
+    assert water_tank['name'] == water_tank_name
+    assert water_tank['handle'] == handle
+    assert water_tank['maxVolume'] == 100
+    assert water_tank['minimumVolume'] == 20
+    assert water_tank['waterSource'] == water_source_name
+
+    await api_client.fill_water_tank(handle, True, force=True)
+
+    assert (await api_client.get_water_tank(water_tank_name))['filling'] == True
+
+    await api_client.fill_water_tank(handle, False)
+
+    with pytest.raises(APIInvalidRequest) as exc_info:
+        await api_client.remove_water_source(water_source_handle)
+
+    response = exc_info.value.response
+    assert response.message == 'Cannot remove the water source, there is a water tank dependent of it'
+
+    await api_client.remove_water_tank(handle)
+
+    assert await api_client.get_water_tank_list() == []
+
+
+async def test_water_tank_lookup_cost_is_flat(api_client: APIClient):
+    """The time to find a water tank by its name should not grow with the amount of water tanks"""
+    volume_factor, pressure_factor, iterations = 1.5, 2.5, 200
+
+    await api_client.create_water_tank('Water tank 1', 1, volume_factor, pressure_factor)
+    single_lookup_time = await api_client.benchmark_lookup(iterations)
+
+    for i in range(2, MAX_WATER_TANKS + 1):
+        await api_client.create_water_tank(f'Water tank {i}', i, volume_factor, pressure_factor)
+    full_lookup_time = await api_client.benchmark_lookup(iterations)
+
+    LOGGER.debug(f'Lookup time with 1 water tank: {single_lookup_time} ns')
+    LOGGER.debug(f'Lookup time with {MAX_WATER_TANKS} water tanks: {full_lookup_time} ns')
+    assert full_lookup_time <= single_lookup_time * 1.5
+
+
+async def test_water_tank_median_filter(api_client: APIClient):
+    """Platform should reject a pressure spike shorter than half of the median filter window"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor)
+    await api_client.set_io_value(pressure_sensor, 10)
+    await api_client.set_water_tank_filter(water_tank_name, FilterType.MEDIAN, window=3)
+
+    water_tank = await api_client.get_water_tank(water_tank_name)
+    assert water_tank['filterType'] == FilterType.MEDIAN
+    assert water_tank['filterWindow'] == 3
+    assert water_tank['oversampling'] == 1
+
+    # The filter takes a sample per second
+    await api_client.advance_clock(1)
+    await api_client.set_io_value(pressure_sensor, 100)
+    await api_client.advance_clock(1)
+
+    assert (await api_client.get_water_tank(water_tank_name))['rawPressureValue'] == 10
+
+    await api_client.advance_clock(1)
+
+    assert (await api_client.get_water_tank(water_tank_name))['rawPressureValue'] == 100
+
+
+async def test_water_tank_filter_read_between_samples(api_client: APIClient):
+    """Platform should feed the filter once per second of the clock, even when the value is read between the samples"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor)
+    await api_client.advance_clock(3600)
+    await api_client.set_io_value(pressure_sensor, 10)
+    await api_client.set_water_tank_filter(water_tank_name, FilterType.MOVING_AVERAGE, window=2)
+
+    assert (await api_client.get_water_tank(water_tank_name))['rawPressureValue'] == 10
+
+    # The next sample is only taken a second later
+    await api_client.set_io_value(pressure_sensor, 30)
+
+    assert (await api_client.get_water_tank(water_tank_name))['rawPressureValue'] == 10
+
+    await api_client.advance_clock(1)
+
+    assert (await api_client.get_water_tank(water_tank_name))['rawPressureValue'] == 20
+
+
+async def test_water_tank_invalid_filter(api_client: APIClient):
+    """Platform should refuse filter settings out of range"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor)
+
+    # a value over a byte must not wrap around into the range
+    for window, oversampling in ((0, 1), (9, 1), (3, 0), (3, 17), (257, 1), (3, 257)):
+        with pytest.raises(APIInvalidRequest) as exc_info:
+            await api_client.set_water_tank_filter(water_tank_name, FilterType.EMA, window=window, oversampling=oversampling)
+        assert exc_info.value.response.message == 'Invalid filter settings'
+
+    assert (await api_client.get_water_tank(water_tank_name))['filterType'] == FilterType.NO_FILTER
+
+
+async def test_water_tank_loop_cost(api_client: APIClient):
+    """A water tank loop should take well under a millisecond of CPU time"""
+    volume_factor, pressure_factor, iterations = 1.5, 2.5, 200
+
+    await api_client.create_water_tank('Water tank 1', 1, volume_factor, pressure_factor)
+    await api_client.set_io_value(1, 40)
+
+    loop_cycles = await api_client.benchmark_water_tank_loop(iterations)
+
+    LOGGER.debug(f'Water tank loop: {loop_cycles} CPU cycles')
+    assert 0 < loop_cycles < 16000
+
+
+async def test_water_tank_oversampled_pressure(api_client: APIClient):
+    """Platform should average the newest conversions of the pressure sensor without waiting for new ones"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor)
+    await api_client.set_water_tank_filter(water_tank_name, FilterType.NO_FILTER, oversampling=16)
+
+    for value in (37, 1023, 0):
+        await api_client.set_io_value(pressure_sensor, value)
+        assert (await api_client.get_water_tank(water_tank_name))['rawPressureValue'] == value
+
+
+async def test_water_tank_calibration(api_client: APIClient):
+    """Platform should interpolate the volume between the points of the calibration table"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+    points = [(100, 0), (300, 100), (600, 700), (900, 1000)]
+
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor)
+    await api_client.set_water_tank_calibration(water_tank_name, points)
+
+    water_tank = await api_client.get_water_tank(water_tank_name)
+    assert water_tank['calibrationRawValues'] == [raw_value for raw_value, _ in points]
+    assert water_tank['calibrationVolumes'] == [volume for _, volume in points]
+
+    for raw_value, expected_volume in ((50, 0), (200, 50), (300, 100), (450, 400), (750, 850), (1000, 1000)):
+        await api_client.set_io_value(pressure_sensor, raw_value)
+        water_tank = await api_client.get_water_tank(water_tank_name)
+        assert math.isclose(water_tank['volume'], expected_volume, rel_tol=FLOAT_ERROR_TOLERANCE, abs_tol=0.01)
+
+    await api_client.set_water_tank_calibration(water_tank_name, [])
+
+    water_tank = await api_client.get_water_tank(water_tank_name)
+    assert water_tank['calibrationRawValues'] == []
+    assert math.isclose(water_tank['volume'], 1000, rel_tol=FLOAT_ERROR_TOLERANCE)
+
+
+async def test_water_tank_invalid_calibration(api_client: APIClient):
+    """Platform should refuse a calibration table without increasing raw values or out of the points range"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor)
+
+    for points in ([(100, 0)], [(100, 0), (100, 10)], [(300, 0), (100, 10)], [(100, -1), (200, 10)]):
+        with pytest.raises(APIInvalidRequest) as exc_info:
+            await api_client.set_water_tank_calibration(water_tank_name, points)
+        assert exc_info.value.response.message == 'Invalid calibration table'
+
+    assert (await api_client.get_water_tank(water_tank_name))['calibrationRawValues'] == []
+
+
+async def test_water_tank_calibration_tables_capacity(api_client: APIClient):
+    """
+    Platform should have a calibration table for half of the water tanks, rounded up, and refuse
+    another one once they are all in use
+    """
+    max_calibration_tables = (MAX_WATER_TANKS + 1) // 2
+    water_tank_names = [f'Water tank {pin}' for pin in range(1, MAX_WATER_TANKS + 1)]
+    points = [(100, 0), (900, 1000)]
+
+    for pin, water_tank_name in enumerate(water_tank_names, 1):
+        await api_client.create_water_tank(water_tank_name, pin, 1, 1)
+
+    for water_tank_name in water_tank_names[:max_calibration_tables]:
+        await api_client.set_water_tank_calibration(water_tank_name, points)
+
+    with pytest.raises(APIInvalidRequest) as exc_info:
+        await api_client.set_water_tank_calibration(water_tank_names[max_calibration_tables], points)
+    assert exc_info.value.response.message == 'Max of calibration tables reached'
+
+    # a removed calibration gives its table back
+    await api_client.set_water_tank_calibration(water_tank_names[0], [])
+    await api_client.set_water_tank_calibration(water_tank_names[max_calibration_tables], points)
+
+    water_tank = await api_client.get_water_tank(water_tank_names[max_calibration_tables])
+    assert water_tank['calibrationRawValues'] == [raw_value for raw_value, _ in points]
+
+
+async def test_water_tank_flow_rate(api_client: APIClient):
+    """Platform should estimate the flow rate of a water tank and the time to reach its max volume"""
+    water_tank_name, pressure_sensor, volume_factor, pressure_factor = 'Bottom tank', 1, 1, 1
+    flow_window, flow_sampling_interval, raw_value_step = 12, 10, 30
+
+    await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor)
+    await api_client.set_water_tank_minimum_volume(water_tank_name, 100)
+    await api_client.set_water_tank_max_volume(water_tank_name, 1000)
+
+    # The estimator takes a volume per sampling interval
+    for i in range(flow_window + 1):
+        await api_client.set_io_value(pressure_sensor, 100 + raw_value_step * i)
+        await api_client.advance_clock(flow_sampling_interval)
+
+    water_tank = await api_client.get_water_tank(water_tank_name)
+    expected_flow_rate = raw_value_step * 60 / flow_sampling_interval
+    expected_time_to_max_volume = (1000 - water_tank['volume']) * 60 / expected_flow_rate
+    assert math.isclose(water_tank['flowRate'], expected_flow_rate, rel_tol=FLOAT_ERROR_TOLERANCE)
+    assert math.isclose(water_tank['timeToMaxVolume'], expected_time_to_max_volume, rel_tol=FLOAT_ERROR_TOLERANCE)
+    assert water_tank['timeToMinimumVolume'] == 0
+
+    state = await api_client.get_system_state()
+    assert math.isclose(state['waterTanks'][0]['flowRate'], expected_flow_rate, rel_tol=FLOAT_ERROR_TOLERANCE)
+
+
+async def test_remove_oversampled_pressure_sensors(api_client: APIClient):
+    """Platform should keep averaging the conversions of each remaining pressure sensor after others are removed"""
+    volume_factor, pressure_factor = 1, 1
+    pressure_sensors = {f'Water tank {pin}': pin for pin in range(1, 5)}
+
+    for water_tank_name, pressure_sensor in pressure_sensors.items():
+        await api_client.create_water_tank(water_tank_name, pressure_sensor, volume_factor, pressure_factor)
+        await api_client.set_water_tank_filter(water_tank_name, FilterType.NO_FILTER, oversampling=16)
+        await api_client.set_io_value(pressure_sensor, 100 * pressure_sensor)
+
+    for removed_water_tank_name in ('Water tank 1', 'Water tank 3'):
+        await api_client.remove_water_tank(removed_water_tank_name)
+        del pressure_sensors[removed_water_tank_name]
+
+        # a few manager loops add conversions to the shifted rings
+        await api_client.advance_clock(1)
+        for water_tank_name, pressure_sensor in pressure_sensors.items():
+            assert (await api_client.get_water_tank(water_tank_name))['rawPressureValue'] == 100 * pressure_sensor
+
+    await api_client.create_water_tank('Water tank 5', 5, volume_factor, pressure_factor)
+    await api_client.set_io_value(5, 500)
+    pressure_sensors['Water tank 5'] = 5
+
+    for water_tank_name, pressure_sensor in pressure_sensors.items():
+        assert (await api_client.get_water_tank(water_tank_name))['rawPressureValue'] == 100 * pressure_sensor